@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include <loop_adapt.h>
+
+/* Benchmark for the per-iteration overhead of the loop_adapt loop macros.
+ *
+ * Each thread of the team executes the loop on its own (like a loop inside a
+ * parallel region). The time of the slowest thread is used. All results are
+ * printed as CSV (to stdout or appended to the file given with -o):
+ * mode,macro,body,threads,iterations,ns_per_iter,overhead_percent
+ * The overhead is relative to a plain for loop with the same body and
+ * number of threads.
+ *
+ * Modes:
+ * - disabled: compiled without LOOP_ADAPT_ACTIVATE (la_for_bench_disabled)
+ * - noconfig: loop_adapt active but no configuration for the loop
+ * - timer: each measurement cycle gets a new configuration and is measured
+ *          with the TIMER backend (policy MIN_TIME)
+ */
+
+#define BENCH_LOOP "LA_FOR_BENCH"
+#define BENCH_BODY_SIZE 16
+#define BENCH_REPETITIONS 5
+
+/* Thread counts 1, 2, 4, ... and max_threads */
+#define BENCH_NEXT_THREADS(t, max) (((t) < (max) && 2 * (t) > (max)) ? (max) : 2 * (t))
+
+typedef enum {
+    BENCH_BODY_EMPTY = 0,
+    BENCH_BODY_SMALL,
+    BENCH_NUM_BODIES
+} BenchBody;
+
+static char* bench_body_names[BENCH_NUM_BODIES] = {"empty", "small"};
+
+typedef enum {
+    BENCH_MACRO_FOR = 0,
+    BENCH_MACRO_LA_FOR,
+    BENCH_MACRO_LA_FOR_BEGIN,
+    BENCH_NUM_MACROS
+} BenchMacro;
+
+static char* bench_macro_names[BENCH_NUM_MACROS] = {"for", "LA_FOR", "LA_FOR_BEGIN"};
+
+static inline void bench_small_body(double* buf, long j)
+{
+    int k = 0;
+    for (k = 0; k < BENCH_BODY_SIZE; k++)
+    {
+        buf[k] = 0.5 * buf[k] + (double)j;
+    }
+}
+
+#define BENCH_RUN_BODY(body, buf, j) \
+    if ((body) == BENCH_BODY_SMALL) \
+        bench_small_body((buf), (j)); \
+    __asm__ __volatile__("" ::: "memory");
+
+/* Returns the runtime of the calling thread in seconds */
+static double bench_kernel(BenchMacro macro, BenchBody body, long iterations, double* buf)
+{
+    long j = 0;
+    double start = omp_get_wtime();
+    switch (macro)
+    {
+        case BENCH_MACRO_FOR:
+            for (j = 0; j < iterations; j++)
+            {
+                BENCH_RUN_BODY(body, buf, j);
+            }
+            break;
+        case BENCH_MACRO_LA_FOR:
+            LA_FOR(BENCH_LOOP, j = 0, j < iterations, j++)
+            {
+                BENCH_RUN_BODY(body, buf, j);
+            }
+            break;
+        case BENCH_MACRO_LA_FOR_BEGIN:
+            LA_FOR_BEGIN(BENCH_LOOP, j = 0; j < iterations; j++)
+                BENCH_RUN_BODY(body, buf, j);
+            LA_FOR_END(BENCH_LOOP);
+            break;
+        default:
+            break;
+    }
+    return omp_get_wtime() - start;
+}
+
+/* Returns the best (over repetitions) runtime of the slowest thread */
+static double bench_run(BenchMacro macro, BenchBody body, int threads, long iterations)
+{
+    int r = 0;
+    double best = -1.0;
+    for (r = 0; r < BENCH_REPETITIONS; r++)
+    {
+        double slowest = 0.0;
+#pragma omp parallel num_threads(threads) reduction(max:slowest)
+        {
+            double buf[BENCH_BODY_SIZE] = {0};
+#pragma omp barrier
+            slowest = bench_kernel(macro, body, iterations, buf);
+        }
+        if (best < 0 || slowest < best)
+        {
+            best = slowest;
+        }
+    }
+    return best;
+}
+
+#ifdef LOOP_ADAPT_ACTIVATE
+/* Write a configuration file with one line per measurement cycle, so that
+ * each cycle of each thread gets a new configuration */
+static int bench_write_config(char* dir, long num_configs)
+{
+    long i = 0;
+    char fname[1024];
+    snprintf(fname, sizeof(fname), "%s/%s.txt", dir, BENCH_LOOP);
+    FILE* fp = fopen(fname, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "Cannot write configuration file %s\n", fname);
+        return -1;
+    }
+    for (i = 0; i < num_configs; i++)
+    {
+        fprintf(fp, "BENCH_PARAM=ALL:%ld\n", i % 8);
+    }
+    fclose(fp);
+    return 0;
+}
+#endif
+
+static void usage(char* prog)
+{
+    printf("Usage: %s [-m noconfig|timer] [-t maxthreads] [-n iterations] [-c cycle] [-d dir] [-o file] [-H]\n", prog);
+    printf("-m mode: noconfig (default) or timer, ignored if compiled without LOOP_ADAPT_ACTIVATE\n");
+    printf("-t maximal number of threads (default: omp_get_max_threads())\n");
+    printf("-n iterations per run (default: 1000000)\n");
+    printf("-c iterations per measurement cycle (default: 1000)\n");
+    printf("-d directory for configuration input (default: /tmp), output goes to <dir>/la_for_bench_output\n");
+    printf("-o append CSV output to file (default: stdout)\n");
+    printf("-H print CSV header\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int c = 0;
+    int t = 0;
+    int b = 0;
+    int m = 0;
+    int header = 0;
+    int max_threads = omp_get_max_threads();
+    long iterations = 1000000;
+    long cycle = 1000;
+    char* mode = "noconfig";
+#ifdef LOOP_ADAPT_ACTIVATE
+    char* dir = "/tmp";
+#endif
+    FILE* out = stdout;
+
+    while ((c = getopt(argc, argv, "m:t:n:c:d:o:Hh")) != -1)
+    {
+        switch (c)
+        {
+            case 'm':
+                mode = optarg;
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atol(optarg);
+                break;
+            case 'c':
+                cycle = atol(optarg);
+                break;
+            case 'd':
+#ifdef LOOP_ADAPT_ACTIVATE
+                dir = optarg;
+#endif
+                break;
+            case 'o':
+                out = fopen(optarg, "a");
+                if (!out)
+                {
+                    fprintf(stderr, "Cannot open output file %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'H':
+                header = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 0;
+        }
+    }
+    if (max_threads < 1 || iterations < 1 || cycle < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+#ifdef LOOP_ADAPT_ACTIVATE
+    if (strcmp(mode, "noconfig") != 0 && strcmp(mode, "timer") != 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (strcmp(mode, "timer") == 0)
+    {
+        int num_thread_counts = 0;
+        for (t = 1; t <= max_threads; t = BENCH_NEXT_THREADS(t, max_threads))
+            num_thread_counts++;
+        // Each LA_FOR run consumes iterations/cycle configurations per thread
+        long num_configs = (long)num_thread_counts * BENCH_NUM_BODIES * (BENCH_NUM_MACROS - 1) *
+                           BENCH_REPETITIONS * (iterations / cycle + 1) + 1;
+        if (bench_write_config(dir, num_configs) != 0)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        char fname[1024];
+        snprintf(fname, sizeof(fname), "%s/%s.txt", dir, BENCH_LOOP);
+        unlink(fname);
+    }
+    // The output files have the same name as the input files
+    char outdir[1024];
+    snprintf(outdir, sizeof(outdir), "%s/la_for_bench_output", dir);
+    mkdir(outdir, 0755);
+    setenv("LA_CONFIG_TXT_INPUT", dir, 1);
+    setenv("LA_CONFIG_TXT_OUTPUT", outdir, 1);
+    setenv("LA_CONFIG_INPUT_TYPE", "0", 1);
+    setenv("LA_CONFIG_OUTPUT_TYPE", "0", 1);
+#else
+    mode = "disabled";
+#endif
+
+    LA_INIT;
+#pragma omp parallel num_threads(max_threads)
+    {
+        LA_REGISTER_THREAD(omp_get_thread_num());
+    }
+    LA_REGISTER(BENCH_LOOP, cycle);
+    LA_NEW_INT_PARAMETER("BENCH_PARAM", LOOP_ADAPT_SCOPE_SYSTEM, 0);
+    LA_USE_LOOP_PARAMETER(BENCH_LOOP, "BENCH_PARAM");
+    LA_USE_LOOP_POLICY(BENCH_LOOP, "MIN_TIME");
+
+    if (header)
+    {
+        fprintf(out, "mode,macro,body,threads,iterations,ns_per_iter,overhead_percent\n");
+    }
+    for (t = 1; t <= max_threads; t = BENCH_NEXT_THREADS(t, max_threads))
+    {
+        for (b = 0; b < BENCH_NUM_BODIES; b++)
+        {
+            double base = bench_run(BENCH_MACRO_FOR, b, t, iterations);
+            for (m = 0; m < BENCH_NUM_MACROS; m++)
+            {
+                double runtime = (m == BENCH_MACRO_FOR ? base : bench_run(m, b, t, iterations));
+                fprintf(out, "%s,%s,%s,%d,%ld,%.3f,%.1f\n", mode, bench_macro_names[m], bench_body_names[b],
+                       t, iterations, 1E9 * runtime / iterations, 100.0 * (runtime - base) / base);
+            }
+        }
+    }
+
+    LA_FINALIZE;
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
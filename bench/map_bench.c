@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <map.h>
+
+/* Benchmark for the hash maps (Map_t) used by loop_adapt.
+ *
+ * map_bench uses the open addressing implementation (src/map.c),
+ * map_bench_ghash the old implementation based on the ghash copy
+ * (src/map_ghash.c, compiled with LOOP_ADAPT_MAP_GHASH). For each number of
+ * entries (16, 64, 256, ... up to -n), the maps are filled and all keys are
+ * looked up. All results are printed as CSV (to stdout or appended to the
+ * file given with -o):
+ * impl,map,operation,entries,ns_per_op
+ */
+
+#ifdef LOOP_ADAPT_MAP_GHASH
+#define BENCH_IMPL "ghash"
+#else
+#define BENCH_IMPL "openaddr"
+#endif
+
+#define BENCH_KEY_LENGTH 32
+#define BENCH_REPETITIONS 5
+
+static double bench_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1E-9 * (double)ts.tv_nsec;
+}
+
+static void bench_print(FILE* out, char* map, char* op, int entries, double runtime, long ops)
+{
+    fprintf(out, "%s,%s,%s,%d,%.2f\n", BENCH_IMPL, map, op, entries, 1E9 * runtime / ops);
+}
+
+/* Returns 0 if all lookups returned the right values */
+static int bench_smap(FILE* out, char* keys, int entries, int lookups)
+{
+    int i = 0;
+    int r = 0;
+    int err = 0;
+    long sum = 0;
+    double best_add = -1.0;
+    double best_get = -1.0;
+    double best_miss = -1.0;
+    for (r = 0; r < BENCH_REPETITIONS; r++)
+    {
+        Map_t m = NULL;
+        double t = 0;
+        if (init_smap(&m, NULL) != 0)
+        {
+            return -1;
+        }
+        t = bench_time();
+        for (i = 0; i < entries; i++)
+        {
+            add_smap(m, &keys[i * BENCH_KEY_LENGTH], (void*)(intptr_t)(i + 1));
+        }
+        t = bench_time() - t;
+        if (best_add < 0 || t < best_add)
+            best_add = t;
+
+        t = bench_time();
+        for (i = 0; i < lookups; i++)
+        {
+            void* val = NULL;
+            int k = i % entries;
+            get_smap_by_key(m, &keys[k * BENCH_KEY_LENGTH], &val);
+            if ((intptr_t)val != k + 1)
+                err = -1;
+        }
+        t = bench_time() - t;
+        if (best_get < 0 || t < best_get)
+            best_get = t;
+
+        // The second half of the key array is never added to the map
+        t = bench_time();
+        for (i = 0; i < lookups; i++)
+        {
+            int k = entries + (i % entries);
+            sum += get_smap_by_key(m, &keys[k * BENCH_KEY_LENGTH], NULL);
+        }
+        t = bench_time() - t;
+        if (best_miss < 0 || t < best_miss)
+            best_miss = t;
+        destroy_smap(m);
+    }
+    if (sum != -(long)ENOENT * lookups * BENCH_REPETITIONS)
+        err = -1;
+    bench_print(out, "smap", "add", entries, best_add, entries);
+    bench_print(out, "smap", "get", entries, best_get, lookups);
+    bench_print(out, "smap", "miss", entries, best_miss, lookups);
+    return err;
+}
+
+static int bench_imap(FILE* out, int entries, int lookups)
+{
+    int i = 0;
+    int r = 0;
+    int err = 0;
+    double best_add = -1.0;
+    double best_get = -1.0;
+    double best_idx = -1.0;
+    for (r = 0; r < BENCH_REPETITIONS; r++)
+    {
+        Map_t m = NULL;
+        double t = 0;
+        if (init_imap(&m, NULL) != 0)
+        {
+            return -1;
+        }
+        t = bench_time();
+        for (i = 0; i < entries; i++)
+        {
+            add_imap(m, 7 * i, (void*)(intptr_t)(i + 1));
+        }
+        t = bench_time() - t;
+        if (best_add < 0 || t < best_add)
+            best_add = t;
+
+        t = bench_time();
+        for (i = 0; i < lookups; i++)
+        {
+            void* val = NULL;
+            int k = i % entries;
+            get_imap_by_key(m, 7 * k, &val);
+            if ((intptr_t)val != k + 1)
+                err = -1;
+        }
+        t = bench_time() - t;
+        if (best_get < 0 || t < best_get)
+            best_get = t;
+
+        t = bench_time();
+        for (i = 0; i < lookups; i++)
+        {
+            void* val = NULL;
+            int k = i % entries;
+            get_imap_by_idx(m, k, &val);
+            if ((intptr_t)val != k + 1)
+                err = -1;
+        }
+        t = bench_time() - t;
+        if (best_idx < 0 || t < best_idx)
+            best_idx = t;
+        destroy_imap(m);
+    }
+    bench_print(out, "imap", "add", entries, best_add, entries);
+    bench_print(out, "imap", "get", entries, best_get, lookups);
+    bench_print(out, "imap", "get_by_idx", entries, best_idx, lookups);
+    return err;
+}
+
+static void usage(char* prog)
+{
+    printf("Usage: %s [-n entries] [-l lookups] [-o file] [-H]\n", prog);
+    printf("-n maximal number of entries (default: 65536)\n");
+    printf("-l lookups per measurement (default: 1000000)\n");
+    printf("-o append CSV output to file (default: stdout)\n");
+    printf("-H print CSV header\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int c = 0;
+    int i = 0;
+    int err = 0;
+    int header = 0;
+    int max_entries = 65536;
+    int lookups = 1000000;
+    int entries = 0;
+    char* keys = NULL;
+    FILE* out = stdout;
+
+    while ((c = getopt(argc, argv, "n:l:o:Hh")) != -1)
+    {
+        switch (c)
+        {
+            case 'n':
+                max_entries = atoi(optarg);
+                break;
+            case 'l':
+                lookups = atoi(optarg);
+                break;
+            case 'o':
+                out = fopen(optarg, "a");
+                if (!out)
+                {
+                    fprintf(stderr, "Cannot open output file %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'H':
+                header = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 0;
+        }
+    }
+    if (max_entries < 16 || lookups < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    // Keys similar to loop and parameter names, twice as many as the
+    // maximal number of entries for lookups of missing keys
+    keys = malloc(2 * max_entries * BENCH_KEY_LENGTH);
+    if (!keys)
+    {
+        return 1;
+    }
+    for (i = 0; i < 2 * max_entries; i++)
+    {
+        snprintf(&keys[i * BENCH_KEY_LENGTH], BENCH_KEY_LENGTH, "LOOP_ADAPT_KEY_%d", i);
+    }
+
+    if (header)
+    {
+        fprintf(out, "impl,map,operation,entries,ns_per_op\n");
+    }
+    for (entries = 16; entries <= max_entries; entries *= 4)
+    {
+        // Missing keys start at index entries
+        for (i = 0; i < entries; i++)
+        {
+            snprintf(&keys[(entries + i) * BENCH_KEY_LENGTH], BENCH_KEY_LENGTH, "LOOP_ADAPT_MISS_%d", i);
+        }
+        if (bench_smap(out, keys, entries, lookups) != 0 || bench_imap(out, entries, lookups) != 0)
+        {
+            fprintf(stderr, "Wrong lookup results with %d entries\n", entries);
+            err = 1;
+        }
+        for (i = 0; i < entries; i++)
+        {
+            snprintf(&keys[(entries + i) * BENCH_KEY_LENGTH], BENCH_KEY_LENGTH, "LOOP_ADAPT_KEY_%d", entries + i);
+        }
+    }
+
+    free(keys);
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return err;
+}
@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include <loop_adapt.h>
+
+/* Scaling benchmark for thread registration, parameter access and LA_FOR
+ * cycles on a synthetic topology.
+ *
+ * The topology is built from a hwloc synthetic description, so machines with
+ * more hardware threads than the test system can be simulated. The threads
+ * are mapped round-robin onto the synthetic PUs and are not pinned. For each
+ * thread count 1, 2, 4, ... up to the maximal number of threads, all threads
+ * of the team register and afterwards each thread executes:
+ * - set: LA_SET_INT_PARAMETER of a thread-scope parameter
+ * - get: LA_GET_INT_PARAMETER of the same parameter
+ * - la_for: LA_FOR iterations with a short measurement cycle
+ * All results are printed as CSV (to stdout or appended to the file given
+ * with -o):
+ * topology,threads,operation,ops_per_thread,ns_per_op
+ * ns_per_op is the runtime of the slowest thread divided by the number of
+ * operations per thread. For register, it is the time of the slowest thread
+ * for its single LA_REGISTER_THREAD. loop_adapt can only be initialized once,
+ * so the threads of the previous (smaller) team are already registered and
+ * only do the lookup, the new threads of the team register.
+ */
+
+#define BENCH_LOOP "SCALE_BENCH"
+#define BENCH_PARAM "SCALE_PARAM"
+#define BENCH_DEFAULT_TOPOLOGY "pack:8 numa:2 l3:4 core:16 pu:2"
+
+/* Thread counts 1, 2, 4, ... and max_threads */
+#define BENCH_NEXT_THREADS(t, max) (((t) < (max) && 2 * (t) > (max)) ? (max) : 2 * (t))
+
+typedef enum {
+    BENCH_OP_REGISTER = 0,
+    BENCH_OP_SET,
+    BENCH_OP_GET,
+    BENCH_OP_LA_FOR,
+    BENCH_NUM_OPS
+} BenchOp;
+
+static char* bench_op_names[BENCH_NUM_OPS] = {"register", "set", "get", "la_for"};
+
+/* Returns the runtime of the calling thread in seconds */
+static double bench_kernel(BenchOp op, long ops)
+{
+    long j = 0;
+    int value = 0;
+    int sum = 0;
+    double start = omp_get_wtime();
+    switch (op)
+    {
+        case BENCH_OP_REGISTER:
+            LA_REGISTER_THREAD(omp_get_thread_num());
+            break;
+        case BENCH_OP_SET:
+            for (j = 0; j < ops; j++)
+            {
+                LA_SET_INT_PARAMETER(BENCH_PARAM, (int)(j & 0x7));
+            }
+            break;
+        case BENCH_OP_GET:
+            for (j = 0; j < ops; j++)
+            {
+                LA_GET_INT_PARAMETER(BENCH_PARAM, value);
+                sum += value;
+            }
+            break;
+        case BENCH_OP_LA_FOR:
+            LA_FOR(BENCH_LOOP, j = 0, j < ops, j++)
+            {
+                __asm__ __volatile__("" ::: "memory");
+            }
+            break;
+        default:
+            break;
+    }
+    __asm__ __volatile__("" :: "r"(sum) : "memory");
+    return omp_get_wtime() - start;
+}
+
+/* Returns the runtime of the slowest thread */
+static double bench_run(BenchOp op, int threads, long ops)
+{
+    double slowest = 0.0;
+#pragma omp parallel num_threads(threads) reduction(max:slowest)
+    {
+#pragma omp barrier
+        slowest = bench_kernel(op, ops);
+    }
+    return slowest;
+}
+
+static void usage(char* prog)
+{
+    printf("Usage: %s [-s topology] [-t maxthreads] [-n ops] [-c cycle] [-d dir] [-o file] [-H]\n", prog);
+    printf("-s hwloc synthetic topology (default: \"%s\")\n", BENCH_DEFAULT_TOPOLOGY);
+    printf("-t maximal number of threads (default: 2048)\n");
+    printf("-n operations per thread (default: 100000)\n");
+    printf("-c iterations per measurement cycle (default: 100)\n");
+    printf("-d directory for configuration input (default: /tmp), output goes to <dir>/scale_bench_output\n");
+    printf("-o append CSV output to file (default: stdout)\n");
+    printf("-H print CSV header\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int c = 0;
+    int t = 0;
+    int op = 0;
+    int header = 0;
+    int max_threads = 2048;
+    long ops = 100000;
+    long cycle = 100;
+    char* topology = BENCH_DEFAULT_TOPOLOGY;
+    char* dir = "/tmp";
+    FILE* out = stdout;
+
+    while ((c = getopt(argc, argv, "s:t:n:c:d:o:Hh")) != -1)
+    {
+        switch (c)
+        {
+            case 's':
+                topology = optarg;
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            case 'n':
+                ops = atol(optarg);
+                break;
+            case 'c':
+                cycle = atol(optarg);
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'o':
+                out = fopen(optarg, "a");
+                if (!out)
+                {
+                    fprintf(stderr, "Cannot open output file %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'H':
+                header = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 0;
+        }
+    }
+    if (max_threads < 1 || ops < 1 || cycle < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+#ifndef LOOP_ADAPT_ACTIVATE
+    fprintf(stderr, "scale_bench requires LOOP_ADAPT_ACTIVATE\n");
+    return 1;
+#else
+    // No configuration for the loop, every cycle runs with the default values
+    char fname[1024];
+    snprintf(fname, sizeof(fname), "%s/%s.txt", dir, BENCH_LOOP);
+    unlink(fname);
+    char outdir[1024];
+    snprintf(outdir, sizeof(outdir), "%s/scale_bench_output", dir);
+    mkdir(outdir, 0755);
+    setenv("LA_CONFIG_TXT_INPUT", dir, 1);
+    setenv("LA_CONFIG_TXT_OUTPUT", outdir, 1);
+    setenv("LA_CONFIG_INPUT_TYPE", "0", 1);
+    setenv("LA_CONFIG_OUTPUT_TYPE", "0", 1);
+    // The threads are not pinned, more threads than CPUs are expected
+    omp_set_dynamic(0);
+
+    LA_TOPOLOGY_SYNTHETIC(topology);
+    LA_INIT;
+    LA_REGISTER(BENCH_LOOP, cycle);
+    LA_NEW_INT_PARAMETER(BENCH_PARAM, LOOP_ADAPT_SCOPE_THREAD, 0);
+    LA_USE_LOOP_PARAMETER(BENCH_LOOP, BENCH_PARAM);
+    LA_USE_LOOP_POLICY(BENCH_LOOP, "MIN_TIME");
+
+    if (header)
+    {
+        fprintf(out, "topology,threads,operation,ops_per_thread,ns_per_op\n");
+    }
+    for (t = 1; t <= max_threads; t = BENCH_NEXT_THREADS(t, max_threads))
+    {
+        for (op = 0; op < BENCH_NUM_OPS; op++)
+        {
+            long n = (op == BENCH_OP_REGISTER ? 1 : ops);
+            double runtime = bench_run(op, t, n);
+            fprintf(out, "\"%s\",%d,%s,%ld,%.3f\n", topology, t, bench_op_names[op], n, 1E9 * runtime / n);
+        }
+    }
+    LA_FINALIZE;
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+#endif
+}
@@ -11,6 +11,7 @@ extern "C"
 #include <loop_adapt_types.h>
 #include <loop_adapt_scopes.h>
 #include <loop_adapt_parameter_value_types.h>
+#include <loop_adapt_histogram.h>
 #include <hwloc.h>
 
 #ifndef TRUE
@@ -23,21 +24,53 @@ extern "C"
 
 typedef int (*policy_eval_function)(int num_values, ParameterValue *values, double *result);
 
+/*! \brief Per-thread iteration counter of a loop
+
+Used by the inline fast path of the loop macros. As long as the counter is
+inside a measurement cycle, no call into the library is required.
+*/
+typedef struct {
+    int num_iterations; /**< \brief Iterations done in the current cycle */
+    int max_iterations; /**< \brief Iterations per cycle including the warm-up iterations */
+    int warmup; /**< \brief Warm-up iterations at the start of a cycle which are not measured */
+    int next_check; /**< \brief The library is called at the end of this iteration */
+    LoopAdaptHistogram* histogram; /**< \brief Records the duration of each iteration if not NULL */
+    uint64_t iteration_start; /**< \brief Start of the current iteration in ns if histogram is set */
+} LoopAdaptLoopCounter;
+
+/*! \brief Thread-local list of loop counters indexed by the loop handle */
+typedef struct {
+    int epoch; /**< \brief Only valid if it matches loop_adapt_epoch */
+    int num_loops; /**< \brief Number of entries in loops */
+    LoopAdaptLoopCounter* loops; /**< \brief Counters indexed by loop handle */
+} LoopAdaptThreadCounters;
+
 #ifdef LOOP_ADAPT_ACTIVATE
 
 
 extern int loop_adapt_active;
 extern LoopAdaptDebugLevel loop_adapt_verbosity;
+extern int loop_adapt_epoch;
+extern __thread LoopAdaptThreadCounters loop_adapt_thread_counters;
 
 
 int loop_adapt_initialize();
-void loop_adapt_register(char * name, int num_iterations);
+int loop_adapt_topology_cache(char* filename);
+int loop_adapt_topology_synthetic(char* description);
+int loop_adapt_register(char * name, int num_iterations);
+int loop_adapt_register_ex(char * name, int num_iterations, int warmup);
+int loop_adapt_register_adaptive(char * name, int min_iterations, int max_iterations, double confidence);
+int loop_adapt_get_loop_handle(char* name);
 int loop_adapt_register_thread(int threadid);
 int loop_adapt_register_policy(char* name, char* backend, char* config, char* metric, policy_eval_function func );
 int loop_adapt_add_loop_parameter(char* string, char* parameter);
 int loop_adapt_add_loop_policy(char* string, char* policy);
+int loop_adapt_set_loop_sampling(char* string, int interval, int randomized);
+int loop_adapt_set_loop_synchronized(char* string, int enable);
 int loop_adapt_start_loop( char* name, char* file, int linenumber );
 int loop_adapt_end_loop(char* string);
+int loop_adapt_start_loop_handle(int handle, char* file, int linenumber);
+int loop_adapt_end_loop_handle(int handle);
 
 void loop_adapt_finalize();
 void loop_adapt_debug_level(int level);
@@ -45,15 +78,42 @@ int loop_adapt_register_inparallel_function(int (*in_parallel)(void));
 
 
 #define LA_INIT loop_adapt_initialize();
+/* LA_TOPOLOGY_CACHE must be used before LA_INIT. It overrides LA_TOPOLOGY_XML */
+#define LA_TOPOLOGY_CACHE(filename) loop_adapt_topology_cache(((char *)filename));
+/* LA_TOPOLOGY_SYNTHETIC uses a hwloc synthetic topology like "pack:2 core:8 pu:2"
+ * instead of the system topology. Threads are not pinned. Must be used before
+ * LA_INIT, it overrides LA_TOPOLOGY_SYNTHETIC in the environment */
+#define LA_TOPOLOGY_SYNTHETIC(description) loop_adapt_topology_synthetic(((char *)description));
 
 #define LA_FINALIZE loop_adapt_finalize();
 
-#define LA_REGISTER(name, count) loop_adapt_register(((char *)name), (count));
+/* LA_REGISTER returns the loop handle (>= 0) or a negative error code. The
+ * handle stays valid until LA_FINALIZE */
+#define LA_REGISTER(name, count) loop_adapt_register(((char *)name), (count))
+/* LA_REGISTER_EX adds warmup iterations at the start of each cycle. The
+ * parameters of a new configuration are applied before the warm-up, the
+ * measurement covers only the following count iterations */
+#define LA_REGISTER_EX(name, count, warmup) loop_adapt_register_ex(((char *)name), (count), (warmup))
+/* LA_REGISTER_ADAPTIVE measures each configuration for at least min and at
+ * most max iterations. The cycle ends as soon as the 95% confidence interval
+ * of the mean iteration time is within +-confidence (e.g. 0.05) of the mean */
+#define LA_REGISTER_ADAPTIVE(name, min, max, confidence) \
+    loop_adapt_register_adaptive(((char *)name), (min), (max), (confidence))
 #define LA_REGISTER_THREAD(threadid) loop_adapt_register_thread((threadid));
 #define LA_REGISTER_POLICY(name, backend, config, metric, func) loop_adapt_register_policy((name), (backend), (config), (metric), (func));
 #define LA_REGISTER_INPARALLEL_FUNC(func) loop_adapt_register_inparallel_function((func));
 #define LA_USE_LOOP_PARAMETER(name, parameter) loop_adapt_add_loop_parameter(((char *)name), ((char *)parameter));
 #define LA_USE_LOOP_POLICY(name, policy) loop_adapt_add_loop_policy(((char *)name), ((char *)policy));
+/* Monitoring mode: Measure only every interval-th cycle (LA_SAMPLE_LOOP) or
+ * each cycle with probability 1/interval (LA_SAMPLE_LOOP_RANDOM). The other
+ * cycles do not call into the library. Cumulative results (TIMER) are
+ * extrapolated to the represented cycles */
+#define LA_SAMPLE_LOOP(name, interval) loop_adapt_set_loop_sampling(((char *)name), (interval), 0);
+#define LA_SAMPLE_LOOP_RANDOM(name, interval) loop_adapt_set_loop_sampling(((char *)name), (interval), 1);
+/* All registered threads of the loop switch the configuration and start and
+ * stop the measurement at the same iteration. Call it before the loop runs,
+ * all registered threads have to execute the loop */
+#define LA_SYNC_LOOP(name) loop_adapt_set_loop_synchronized(((char *)name), 1);
 
 
 
@@ -104,8 +164,99 @@ int loop_adapt_new_string_parameter(char* string, LoopAdaptScope_t scope, char*
 int loop_adapt_new_loop_start(char* string, char* file, int linenumber);
 int loop_adapt_new_loop_end(char* string);
 
-#define LOOP_BEGIN(name) loop_adapt_start_loop(((char *)name), (char *)__FILE__, __LINE__)
-#define LOOP_END(name) loop_adapt_end_loop(((char *)name))
+/* Resolve the loop name only once per call site and cache the handle in a
+ * static variable. A failed lookup is cached as well, so an unregistered loop
+ * is reported once and not looked up in every iteration. The handle is
+ * resolved again after a new LA_INIT, the epoch is published after the
+ * handle. Before LA_INIT (epoch 0), nothing is looked up. */
+#define LOOP_ADAPT_HANDLE(name) \
+    ({ \
+        static int _loop_adapt_handle = -1; \
+        static int _loop_adapt_handle_epoch = 0; \
+        int _loop_adapt_epoch = loop_adapt_epoch; \
+        if (__atomic_load_n(&_loop_adapt_handle_epoch, __ATOMIC_ACQUIRE) != _loop_adapt_epoch) \
+        { \
+            __atomic_store_n(&_loop_adapt_handle, loop_adapt_get_loop_handle(((char *)name)), __ATOMIC_RELAXED); \
+            __atomic_store_n(&_loop_adapt_handle_epoch, _loop_adapt_epoch, __ATOMIC_RELEASE); \
+        } \
+        __atomic_load_n(&_loop_adapt_handle, __ATOMIC_RELAXED); \
+    })
+
+/* Inline fast path: Inside a measurement cycle, only the thread-local counter
+ * of the loop is checked and incremented. The library is called at the
+ * start and the end of a cycle and after the warm-up iterations. If the measurement of the loop records
+ * per-iteration durations, each iteration is timed here as well. */
+static inline LoopAdaptLoopCounter* _loop_adapt_loop_counter(int handle)
+{
+    LoopAdaptThreadCounters* t = &loop_adapt_thread_counters;
+    if (t->epoch == loop_adapt_epoch && handle >= 0 && handle < t->num_loops)
+    {
+        return &t->loops[handle];
+    }
+    return NULL;
+}
+
+static inline int loop_adapt_start_loop_fast(int handle, char* file, int linenumber)
+{
+    int ret = 1;
+    // Failed registration or lookup, the loop runs without loop_adapt
+    if (handle < 0)
+    {
+        return 1;
+    }
+    LoopAdaptLoopCounter* c = _loop_adapt_loop_counter(handle);
+    if (!c || c->num_iterations == 0 || c->num_iterations == c->warmup)
+    {
+        ret = loop_adapt_start_loop_handle(handle, file, linenumber);
+        // The counters may be moved by the library call
+        c = _loop_adapt_loop_counter(handle);
+    }
+    if (c && c->histogram)
+    {
+        c->iteration_start = loop_adapt_histogram_now();
+    }
+    return ret;
+}
+
+static inline int loop_adapt_end_loop_fast(int handle)
+{
+    if (handle < 0)
+    {
+        return 1;
+    }
+    LoopAdaptLoopCounter* c = _loop_adapt_loop_counter(handle);
+    if (c)
+    {
+        if (c->histogram)
+        {
+            loop_adapt_histogram_record(c->histogram, loop_adapt_histogram_now() - c->iteration_start);
+        }
+        if (c->num_iterations < c->next_check)
+        {
+            c->num_iterations++;
+            return 1;
+        }
+    }
+    return loop_adapt_end_loop_handle(handle);
+}
+
+#define LOOP_BEGIN_H(handle) loop_adapt_start_loop_fast((handle), (char *)__FILE__, __LINE__)
+#define LOOP_END_H(handle) loop_adapt_end_loop_fast((handle))
+
+#define LOOP_BEGIN(name) LOOP_BEGIN_H(LOOP_ADAPT_HANDLE(name))
+#define LOOP_END(name) LOOP_END_H(LOOP_ADAPT_HANDLE(name))
+
+#define LA_FOR_H(handle, start, cond, inc) \
+    for (start; cond && LOOP_BEGIN_H(handle); inc, LOOP_END_H(handle))
+
+#define LA_FOR_BEGIN_H(handle, ...) \
+    for (__VA_ARGS__) \
+    { \
+        LOOP_BEGIN_H(handle);
+
+#define LA_FOR_END_H(handle) \
+        LOOP_END_H(handle); \
+    }
 
 #define LA_FOR(name, start, cond, inc) \
     for (start; cond && LOOP_BEGIN(((char *)name)); inc, LOOP_END(name))
@@ -122,14 +273,27 @@ int loop_adapt_new_loop_end(char* string);
 #else /* !LOOP_ADAPT_ACTIVATE */
 
 #define LA_INIT
+#define LA_TOPOLOGY_CACHE(filename)
+#define LA_TOPOLOGY_SYNTHETIC(description)
 #define LA_FINALIZE
 
-#define LA_REGISTER(name, count)
+/*! \brief Invalid loop handle returned by the register macros if loop_adapt is disabled */
+static inline int _loop_adapt_register_disabled(void)
+{
+    return -1;
+}
+
+#define LA_REGISTER(name, count) _loop_adapt_register_disabled()
+#define LA_REGISTER_EX(name, count, warmup) _loop_adapt_register_disabled()
+#define LA_REGISTER_ADAPTIVE(name, min, max, confidence) _loop_adapt_register_disabled()
 #define LA_REGISTER_THREAD(threadid)
 #define LA_REGISTER_INPARALLEL_FUNC(func)
 #define LA_REGISTER_POLICY(name, backend, config, metric, func)
 #define LA_USE_LOOP_PARAMETER(name, parameter)
 #define LA_USE_LOOP_POLICY(name, policy)
+#define LA_SAMPLE_LOOP(name, interval)
+#define LA_SAMPLE_LOOP_RANDOM(name, interval)
+#define LA_SYNC_LOOP(name)
 
 #define LA_NEW_INT_PARAMETER(name, scope, type)
 #define LA_NEW_INT_PARAMETER_RANGE(name, scope, value, start, end)
@@ -143,13 +307,20 @@ int loop_adapt_new_loop_end(char* string);
 
 #define LOOP_BEGIN(name)
 #define LOOP_END(name)
+#define LOOP_BEGIN_H(handle)
+#define LOOP_END_H(handle)
 
 #define LA_FOR(name, start, cond, inc) \
     for (start; cond; inc)
+#define LA_FOR_H(handle, start, cond, inc) \
+    for (start; cond; inc)
 
 #define LA_FOR_BEGIN(name, ...) \
     for (__VA_ARGS__) {
 #define LA_FOR_END(name) }
+#define LA_FOR_BEGIN_H(handle, ...) \
+    for (__VA_ARGS__) {
+#define LA_FOR_END_H(handle) }
 
 
 #endif /* LOOP_ADAPT_ACTIVATE */
@@ -0,0 +1,95 @@
+#ifndef LOOP_ADAPT_ARENA_H
+#define LOOP_ADAPT_ARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <loop_adapt_padding.h>
+
+/* Per-thread scratch memory for data which lives only for one measurement
+ * cycle (results, output lines). The arena is reset at each cycle boundary.
+ * Requests which do not fit into the arena are served from separate blocks.
+ * At the next reset, these blocks are freed and the arena grows to the
+ * largest cycle seen so far, so once all cycles fit, the arena does not
+ * allocate anymore. A zeroed arena is valid and empty. */
+
+/* Alignment of all allocations in the arena */
+#define LOOP_ADAPT_ARENA_ALIGN 16
+#define LOOP_ADAPT_ARENA_ALIGNED(size) \
+    ((((size) + LOOP_ADAPT_ARENA_ALIGN - 1) / LOOP_ADAPT_ARENA_ALIGN) * LOOP_ADAPT_ARENA_ALIGN)
+
+typedef struct LoopAdaptArenaBlock {
+    struct LoopAdaptArenaBlock* next;
+} LoopAdaptArenaBlock;
+
+typedef struct {
+    char* base; /**< \brief Memory reused in each cycle (cache line aligned) */
+    size_t size; /**< \brief Size of base */
+    size_t used; /**< \brief Used bytes of base in the current cycle */
+    size_t requested; /**< \brief Requested bytes in the current cycle including overflow blocks */
+    LoopAdaptArenaBlock* overflow; /**< \brief Blocks of the current cycle which did not fit into base */
+} LoopAdaptArena;
+
+/*! \brief Allocate size bytes valid until the next reset of the arena */
+static inline void* loop_adapt_arena_alloc(LoopAdaptArena* arena, size_t size)
+{
+    size = LOOP_ADAPT_ARENA_ALIGNED(size);
+    arena->requested += size;
+    if (arena->base && arena->used + size <= arena->size)
+    {
+        void* ptr = arena->base + arena->used;
+        arena->used += size;
+        return ptr;
+    }
+    // The block header is padded to keep the alignment of the data
+    LoopAdaptArenaBlock* block = malloc(LOOP_ADAPT_ARENA_ALIGNED(sizeof(LoopAdaptArenaBlock)) + size);
+    if (!block)
+    {
+        return NULL;
+    }
+    block->next = arena->overflow;
+    arena->overflow = block;
+    return ((char*)block) + LOOP_ADAPT_ARENA_ALIGNED(sizeof(LoopAdaptArenaBlock));
+}
+
+static inline void _loop_adapt_arena_free_overflow(LoopAdaptArena* arena)
+{
+    while (arena->overflow)
+    {
+        LoopAdaptArenaBlock* next = arena->overflow->next;
+        free(arena->overflow);
+        arena->overflow = next;
+    }
+}
+
+/*! \brief Release all allocations of the arena. If the last cycle needed
+ * overflow blocks, the arena grows to hold all requests of that cycle. */
+static inline void loop_adapt_arena_reset(LoopAdaptArena* arena)
+{
+    if (arena->overflow)
+    {
+        _loop_adapt_arena_free_overflow(arena);
+        if (arena->requested > arena->size)
+        {
+            char* base = loop_adapt_padded_alloc(arena->requested);
+            if (base)
+            {
+                free(arena->base);
+                arena->base = base;
+                arena->size = LOOP_ADAPT_PADDED_SIZE(arena->requested);
+            }
+        }
+    }
+    arena->used = 0;
+    arena->requested = 0;
+}
+
+/*! \brief Free all memory of the arena, it can be used again afterwards */
+static inline void loop_adapt_arena_destroy(LoopAdaptArena* arena)
+{
+    _loop_adapt_arena_free_overflow(arena);
+    free(arena->base);
+    memset(arena, 0, sizeof(LoopAdaptArena));
+}
+
+#endif /* LOOP_ADAPT_ARENA_H */
@@ -0,0 +1,98 @@
+#ifndef LOOP_ADAPT_BARRIER_H
+#define LOOP_ADAPT_BARRIER_H
+
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* Sense-reversing barrier for the threads of a loop. Each thread keeps its
+ * own sense and flips it at each barrier, the last arriving thread sets the
+ * global sense to it and releases the others. Waiting threads spin for a
+ * short time and then sleep on the global sense with a futex. The last thread
+ * calls into the kernel only if a thread sleeps. The last thread can also
+ * take a decision for all threads before it releases them. A zeroed barrier
+ * with a count is valid. */
+
+/* Checks of the global sense before a thread sleeps */
+#define LOOP_ADAPT_BARRIER_SPIN 4096
+
+typedef struct {
+    int count; /**< \brief Number of participating threads */
+    int arrived; /**< \brief Threads which arrived in the current round */
+    int sense; /**< \brief Global sense, flipped when all threads arrived */
+    int sleepers; /**< \brief Threads sleeping in the kernel */
+} LoopAdaptBarrier;
+
+static inline void loop_adapt_barrier_init(LoopAdaptBarrier* b, int count)
+{
+    b->count = count;
+    b->arrived = 0;
+    b->sense = 0;
+    b->sleepers = 0;
+}
+
+static inline void _loop_adapt_barrier_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static inline int _loop_adapt_barrier_wait(LoopAdaptBarrier* b, int* local_sense, int (*decide)(void*), void* arg, int* decision)
+{
+    int i = 0;
+    int sense = !(*local_sense);
+    *local_sense = sense;
+    if (__atomic_add_fetch(&b->arrived, 1, __ATOMIC_ACQ_REL) >= __atomic_load_n(&b->count, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&b->arrived, 0, __ATOMIC_RELAXED);
+        if (decide)
+        {
+            // Published with the new sense
+            __atomic_store_n(decision, decide(arg), __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&b->sense, sense, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&b->sleepers, __ATOMIC_SEQ_CST) > 0)
+        {
+            syscall(SYS_futex, &b->sense, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+        }
+        return 1;
+    }
+    for (i = 0; i < LOOP_ADAPT_BARRIER_SPIN; i++)
+    {
+        if (__atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) == sense)
+        {
+            return 0;
+        }
+        _loop_adapt_barrier_relax();
+    }
+    // The last thread either sees the sleeper or the sleeper sees the new
+    // sense. The kernel does not sleep if the sense already changed.
+    __atomic_add_fetch(&b->sleepers, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&b->sense, __ATOMIC_SEQ_CST) != sense)
+    {
+        syscall(SYS_futex, &b->sense, FUTEX_WAIT_PRIVATE, !sense, NULL, NULL, 0);
+    }
+    __atomic_sub_fetch(&b->sleepers, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+/*! \brief Wait until all threads arrived. local_sense is the sense of the
+ * calling thread, initially 0. Returns 1 for the last arriving thread. */
+static inline int loop_adapt_barrier_wait(LoopAdaptBarrier* b, int* local_sense)
+{
+    return _loop_adapt_barrier_wait(b, local_sense, NULL, NULL, NULL);
+}
+
+/*! \brief Wait until all threads arrived. The last arriving thread calls
+ * decide(arg) before it releases the others and stores the result in
+ * *decision. Returns the decision in all threads. It stays valid until the
+ * next decision of the barrier, which needs all threads to arrive again. */
+static inline int loop_adapt_barrier_decide(LoopAdaptBarrier* b, int* local_sense, int (*decide)(void*), void* arg, int* decision)
+{
+    _loop_adapt_barrier_wait(b, local_sense, decide, arg, decision);
+    return __atomic_load_n(decision, __ATOMIC_RELAXED);
+}
+
+#endif /* LOOP_ADAPT_BARRIER_H */
@@ -0,0 +1,96 @@
+#ifndef LOOP_ADAPT_CHUNKED_ARRAY_H
+#define LOOP_ADAPT_CHUNKED_ARRAY_H
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <loop_adapt_padding.h>
+
+/* Dense array of per-instance entries of the measurement backends. The array
+ * is split into chunks of cache line padded entries, so growing it never
+ * moves entries in use by other threads. A chunk is allocated zeroed by the
+ * first thread getting an entry of it with
+ * loop_adapt_chunked_array_get_or_create(). Reading entries does not lock. */
+#define LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE 64
+#define LOOP_ADAPT_CHUNKED_ARRAY_MAX_CHUNKS 1024
+
+typedef struct {
+    char* chunks[LOOP_ADAPT_CHUNKED_ARRAY_MAX_CHUNKS];
+    int num_chunks; /**< \brief Number of chunk slots in use, some may be NULL */
+    size_t elem_size; /**< \brief Size of an entry, a multiple of the cache line size */
+    pthread_mutex_t lock;
+} LoopAdaptChunkedArray;
+
+/*! \brief Static initializer for an array of entries with the given size */
+#define LOOP_ADAPT_CHUNKED_ARRAY_INITIALIZER(size) \
+    { .num_chunks = 0, .elem_size = LOOP_ADAPT_PADDED_SIZE(size), .lock = PTHREAD_MUTEX_INITIALIZER }
+
+/*! \brief Number of instances covered by the allocated chunks (upper bound for walks) */
+static inline int loop_adapt_chunked_array_size(LoopAdaptChunkedArray* a)
+{
+    return __atomic_load_n(&a->num_chunks, __ATOMIC_ACQUIRE) * LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE;
+}
+
+/*! \brief Get the entry of an instance, NULL if its chunk was never allocated */
+static inline void* loop_adapt_chunked_array_get(LoopAdaptChunkedArray* a, int instance)
+{
+    if (instance < 0 || instance >= LOOP_ADAPT_CHUNKED_ARRAY_MAX_CHUNKS * LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE)
+    {
+        return NULL;
+    }
+    char* chunk = __atomic_load_n(&a->chunks[instance / LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE], __ATOMIC_ACQUIRE);
+    if (!chunk)
+    {
+        return NULL;
+    }
+    return chunk + (instance % LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE) * a->elem_size;
+}
+
+/*! \brief Get the entry of an instance and allocate its chunk if needed */
+static inline void* loop_adapt_chunked_array_get_or_create(LoopAdaptChunkedArray* a, int instance)
+{
+    void* e = loop_adapt_chunked_array_get(a, instance);
+    if (e || instance < 0 || instance >= LOOP_ADAPT_CHUNKED_ARRAY_MAX_CHUNKS * LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE)
+    {
+        return e;
+    }
+    int c = instance / LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE;
+    pthread_mutex_lock(&a->lock);
+    if (!a->chunks[c])
+    {
+        char* chunk = loop_adapt_padded_alloc(LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE * a->elem_size);
+        if (chunk)
+        {
+            __atomic_store_n(&a->chunks[c], chunk, __ATOMIC_RELEASE);
+            if (c >= a->num_chunks)
+            {
+                __atomic_store_n(&a->num_chunks, c + 1, __ATOMIC_RELEASE);
+            }
+        }
+    }
+    pthread_mutex_unlock(&a->lock);
+    return loop_adapt_chunked_array_get(a, instance);
+}
+
+/*! \brief Free all chunks. If given, free_entry is called for every entry of the allocated chunks before */
+static inline void loop_adapt_chunked_array_destroy(LoopAdaptChunkedArray* a, void (*free_entry)(void* entry))
+{
+    int i = 0, j = 0;
+    pthread_mutex_lock(&a->lock);
+    for (i = 0; i < a->num_chunks; i++)
+    {
+        if (a->chunks[i])
+        {
+            for (j = 0; free_entry && j < LOOP_ADAPT_CHUNKED_ARRAY_CHUNK_SIZE; j++)
+            {
+                free_entry(a->chunks[i] + j * a->elem_size);
+            }
+            free(a->chunks[i]);
+            a->chunks[i] = NULL;
+        }
+    }
+    a->num_chunks = 0;
+    pthread_mutex_unlock(&a->lock);
+}
+
+#endif /* LOOP_ADAPT_CHUNKED_ARRAY_H */
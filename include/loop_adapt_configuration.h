@@ -11,6 +11,35 @@ int loop_adapt_get_new_configuration(char* string, int config_id, LoopAdaptConfi
 
 int loop_adapt_write_configuration_results(ThreadData_t thread, char* loopname, PolicyDefinition_t policy, LoopAdaptConfiguration_t config, int num_results, ParameterValue* results);
 
+/* Prefetching of configurations by a service thread (LA_CONFIG_PREFETCH=1).
+ * loop_adapt_configuration_prefetch queues a request for config_id, it returns
+ * -ENOTSUP if prefetching is disabled and -ENOMEM if the buffer of the slot
+ * cannot be allocated. If a request of the slot is still in work, config_id
+ * is fetched after it and replaces its result, only the newest request is
+ * kept. loop_adapt_configuration_prefetched takes the result if it is
+ * available for config_id by swapping it with *config. It returns -EAGAIN if
+ * there is no result, the caller has to get the configuration itself. The
+ * buffer of the slot is allocated with the layout of the given configuration
+ * at the first request. */
+int loop_adapt_configuration_prefetch(LoopAdaptConfigurationPrefetch* slot, char* string, int config_id, LoopAdaptConfiguration_t layout);
+int loop_adapt_configuration_prefetched(LoopAdaptConfigurationPrefetch* slot, int config_id, LoopAdaptConfiguration_t *config);
+
+/* Configurations shared by the threads of a loop.
+ * loop_adapt_configuration_shared_get replaces the reference in *config by a
+ * reference to configuration config_id of the loop. Only the first thread
+ * asking for a configuration calls the input backend, the others reuse the
+ * published one. Input backends whose configurations do not belong to the
+ * caller are still called by each thread. The shared configurations are freed
+ * by loop_adapt_configuration_shared_destroy, the references of the threads
+ * become invalid. */
+void loop_adapt_configuration_shared_init(LoopAdaptSharedConfiguration* share);
+int loop_adapt_configuration_shared_get(LoopAdaptSharedConfiguration* share, char* string, int config_id, LoopAdaptConfiguration_t *config);
+void loop_adapt_configuration_shared_destroy(LoopAdaptSharedConfiguration* share);
+
+/* Free a configuration returned by the input backend if it belongs to the
+ * caller. It can also be used after loop_adapt_configuration_finalize. */
+void loop_adapt_configuration_release(LoopAdaptConfiguration_t config);
+
 void loop_adapt_configuration_destroy_config(LoopAdaptConfiguration_t config);
 int loop_adapt_configuration_resize_config(LoopAdaptConfiguration_t *config, int num_parameters);
 
@@ -21,6 +50,12 @@ void loop_adapt_configuration_finalize();
 // int loop_adapt_configuration_announce(LoopAdaptAnnounce_t announe);
 
 
+/* Format the parameter values of config and the policy result as
+ * <param>=<index>:<value>;...|<backend>:<config>(:<match>)=<result>
+ * The string is allocated in the arena of the thread and valid until the
+ * end of the next measurement cycle of the thread. */
+char* loop_adapt_configuration_format_results(ThreadData_t thread, PolicyDefinition_t policy, LoopAdaptConfiguration_t config, int num_results, ParameterValue* results);
+
 /* Helper functions and macros*/
 int loop_adapt_config_parse_default_entry(bstring b, bstring* first, bstring* second, bstring* third);
 #define loop_adapt_config_parse_default_entry_bbb(f, s, t) \
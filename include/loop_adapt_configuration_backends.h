@@ -27,10 +27,14 @@ static LoopAdaptInputConfigurationFunctions loop_adapt_configuration_input_list[
     [LA_CONFIG_IN_TXT] = {.init = loop_adapt_config_txt_input_init,
                           .finalize = loop_adapt_config_txt_input_finalize,
                           .getnew = loop_adapt_get_new_config_txt,
+                          .async = 1,
                          },
     [LA_CONFIG_IN_CC_CLIENT] = {.init = loop_adapt_config_cc_client_init,
                                 .finalize = loop_adapt_config_cc_client_finalize,
                                 .getnew = loop_adapt_get_new_config_cc_client,
+                                // Synchronizes the application threads in getnew,
+                                // so LA_CONFIG_PREFETCH has no effect
+                                .async = 0,
                                }
 };
 
@@ -5,10 +5,12 @@
 #include <loop_adapt_policy_types.h>
 #include <loop_adapt_threads_types.h>
 #include <bstrlib.h>
+#include <pthread.h>
 
 
 typedef struct {
     bstring parameter;
+    int id; /**< \brief Parameter ID or negative if not resolved yet */
     ParameterValueType_t type;
     int num_values;
     ParameterValue* values;
@@ -20,12 +22,15 @@ typedef struct {
     bstring metric;
 } LoopAdaptConfigurationMeasurement;
 
-typedef struct {
+typedef struct LoopAdaptConfiguration {
     int configuration_id;
     int num_parameters;
+    int max_parameters; /**< \brief Allocated entries in parameters, they are kept for the next configurations */
     LoopAdaptConfigurationParameter* parameters;
     // int num_measurements;
     // LoopAdaptConfigurationMeasurement* measurements;
+    int refcount; /**< \brief Shared configurations: References of the threads and the loop */
+    struct LoopAdaptConfiguration* next; /**< \brief Shared configurations: Link in the list of replaced configurations */
 } LoopAdaptConfiguration;
 typedef LoopAdaptConfiguration* LoopAdaptConfiguration_t;
 
@@ -42,8 +47,52 @@ typedef struct {
     int (*init)();
     int (*getnew)(char* string, int config_id, LoopAdaptConfiguration_t* configuration);
     void (*finalize)();
+    int async; /**< \brief getnew can be called by the prefetch service thread and the configurations belong to the caller */
 } LoopAdaptInputConfigurationFunctions;
 
+/*! \brief States of a prefetch slot */
+typedef enum {
+    LOOP_ADAPT_PREFETCH_IDLE = 0, /**< \brief No request pending, owned by the requesting thread */
+    LOOP_ADAPT_PREFETCH_REQUESTED, /**< \brief Queued or in work, owned by the service thread */
+    LOOP_ADAPT_PREFETCH_READY, /**< \brief Result available, owned by the requesting thread */
+} LoopAdaptPrefetchState;
+
+/*! \brief Single-slot hand-over of a prefetched configuration
+
+The requesting thread queues the slot, the service thread calls the input
+backend with the buffer of the slot and publishes the result by setting the
+state. A request arriving while the slot is in work is remembered and served
+by the service thread before it hands the slot back. The requesting thread takes the configuration by swapping the buffer
+with its own one, so no configuration is copied.
+*/
+typedef struct LoopAdaptConfigurationPrefetch {
+    int state; /**< \brief LoopAdaptPrefetchState */
+    int config_id; /**< \brief Requested configuration */
+    int err; /**< \brief Return value of the input backend */
+    int pending; /**< \brief A newer request arrived while the slot was in work, guarded by the prefetch lock */
+    int pending_id; /**< \brief Configuration of the newer request */
+    char* loopname; /**< \brief Loop name, valid as long as the loop */
+    LoopAdaptConfiguration_t config; /**< \brief Buffer filled by the service thread */
+    struct LoopAdaptConfigurationPrefetch* next; /**< \brief Link in the request queue */
+} LoopAdaptConfigurationPrefetch;
+
+/*! \brief Configuration of a loop shared by all threads
+
+The configuration of a cycle is fetched once per loop and published. Threads
+take a reference to the published configuration, which is not modified
+anymore. Replaced configurations are reused when no thread references them.
+At most LOOP_ADAPT_SHARED_CONFIGURATION_RETIRED unreferenced ones are kept.
+*/
+#define LOOP_ADAPT_SHARED_CONFIGURATION_RETIRED 4
+typedef struct {
+    LoopAdaptConfiguration_t published; /**< \brief Latest configuration, read without lock */
+    int readers; /**< \brief Threads between reading published and taking a reference, retired configurations are not freed meanwhile */
+    LoopAdaptConfiguration_t retired; /**< \brief Replaced and unused configurations, possibly still referenced */
+    int num_retired; /**< \brief Length of the retired list */
+    LoopAdaptConfigurationPrefetch prefetch; /**< \brief Next configuration prepared by the service thread */
+    pthread_mutex_t lock; /**< \brief Serializes fetching and publishing */
+} LoopAdaptSharedConfiguration;
+
 typedef struct {
     int (*init)();
     int (*write)(ThreadData_t thread, char* loopname, PolicyDefinition_t policy, LoopAdaptConfiguration_t config, int num_results, ParameterValue* results);
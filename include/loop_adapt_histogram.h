@@ -0,0 +1,163 @@
+#ifndef LOOP_ADAPT_HISTOGRAM_H
+#define LOOP_ADAPT_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Fixed-size histogram of durations in ns with logarithmic buckets (HDR-style).
+ * Values below LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS are counted exactly. Each
+ * larger power of two is split into LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS linear
+ * buckets, so the relative error of a bucket is below
+ * 1/LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS. Recording a value does not lock or
+ * allocate. Count, minimum, maximum and the moments are tracked exactly.
+ * A zeroed histogram is valid and empty. */
+
+#define LOOP_ADAPT_HISTOGRAM_SUB_BITS 5
+#define LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS (1 << LOOP_ADAPT_HISTOGRAM_SUB_BITS)
+/* Largest value with its own bucket is 2^40 ns (~18 minutes), larger values
+ * are counted in the last bucket */
+#define LOOP_ADAPT_HISTOGRAM_MAX_BITS 40
+#define LOOP_ADAPT_HISTOGRAM_BUCKETS \
+    ((LOOP_ADAPT_HISTOGRAM_MAX_BITS - LOOP_ADAPT_HISTOGRAM_SUB_BITS + 1) * LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t count; /**< \brief Number of recorded values */
+    uint64_t min; /**< \brief Smallest recorded value */
+    uint64_t max; /**< \brief Largest recorded value */
+    uint64_t shift; /**< \brief First recorded value, the moments are relative to it */
+    double sum; /**< \brief Sum of (value - shift) */
+    double sumsq; /**< \brief Sum of (value - shift)^2 */
+    uint32_t buckets[LOOP_ADAPT_HISTOGRAM_BUCKETS];
+} LoopAdaptHistogram;
+
+/*! \brief Current time in ns used for per-iteration timing */
+static inline uint64_t loop_adapt_histogram_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static inline int _loop_adapt_histogram_index(uint64_t value)
+{
+    if (value < LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS)
+    {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= LOOP_ADAPT_HISTOGRAM_MAX_BITS)
+    {
+        return LOOP_ADAPT_HISTOGRAM_BUCKETS - 1;
+    }
+    int group = msb - LOOP_ADAPT_HISTOGRAM_SUB_BITS + 1;
+    int sub = (int)(value >> (msb - LOOP_ADAPT_HISTOGRAM_SUB_BITS)) - LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS;
+    return group * LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+/* Smallest value and width of a bucket */
+static inline void _loop_adapt_histogram_bucket(int index, uint64_t* lower, uint64_t* width)
+{
+    int group = index / LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS;
+    int sub = index % LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS;
+    if (group == 0)
+    {
+        *lower = (uint64_t)sub;
+        *width = 1;
+        return;
+    }
+    *lower = ((uint64_t)(LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS + sub)) << (group - 1);
+    *width = 1ULL << (group - 1);
+}
+
+/*! \brief Remove all recorded values */
+static inline void loop_adapt_histogram_reset(LoopAdaptHistogram* h)
+{
+    memset(h, 0, sizeof(LoopAdaptHistogram));
+}
+
+/*! \brief Record a value */
+static inline void loop_adapt_histogram_record(LoopAdaptHistogram* h, uint64_t value)
+{
+    if (h->count == 0)
+    {
+        h->min = value;
+        h->max = value;
+        h->shift = value;
+    }
+    else if (value < h->min)
+    {
+        h->min = value;
+    }
+    else if (value > h->max)
+    {
+        h->max = value;
+    }
+    double d = (double)value - (double)h->shift;
+    h->sum += d;
+    h->sumsq += d * d;
+    h->count++;
+    h->buckets[_loop_adapt_histogram_index(value)]++;
+}
+
+/*! \brief Value below which the fraction q (0 < q <= 1) of the recorded
+ * values lies. Returns the middle of the bucket, limited to the recorded
+ * minimum and maximum. Returns 0 for an empty histogram. */
+static inline double loop_adapt_histogram_percentile(LoopAdaptHistogram* h, double q)
+{
+    int i = 0;
+    uint64_t seen = 0;
+    if (h->count == 0)
+    {
+        return 0;
+    }
+    if (q >= 1.0)
+    {
+        return (double)h->max;
+    }
+    uint64_t rank = (uint64_t)(q * (double)h->count);
+    if ((double)rank < q * (double)h->count || rank == 0)
+    {
+        rank++;
+    }
+    for (i = 0; i < LOOP_ADAPT_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t lower = 0, width = 0;
+            _loop_adapt_histogram_bucket(i, &lower, &width);
+            double value = (double)lower + (double)(width - 1) / 2;
+            if (value < (double)h->min)
+                return (double)h->min;
+            if (value > (double)h->max)
+                return (double)h->max;
+            return value;
+        }
+    }
+    return (double)h->max;
+}
+
+/*! \brief Mean of the recorded values */
+static inline double loop_adapt_histogram_mean(LoopAdaptHistogram* h)
+{
+    if (h->count == 0)
+    {
+        return 0;
+    }
+    return (double)h->shift + h->sum / (double)h->count;
+}
+
+/*! \brief Sample variance of the recorded values */
+static inline double loop_adapt_histogram_variance(LoopAdaptHistogram* h)
+{
+    if (h->count < 2)
+    {
+        return 0;
+    }
+    double n = (double)h->count;
+    double var = (h->sumsq - (h->sum * h->sum) / n) / (n - 1);
+    return (var > 0 ? var : 0);
+}
+
+#endif /* LOOP_ADAPT_HISTOGRAM_H */
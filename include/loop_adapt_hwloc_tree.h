@@ -2,9 +2,66 @@
 #define LOOP_ADAPT_HWLOC_TREE_H
 
 #include <hwloc.h>
+#include <loop_adapt_scopes.h>
 
-int loop_adapt_copy_hwloc_tree(hwloc_topology_t* copy);
-void loop_adapt_copydestroy_hwloc_tree(hwloc_topology_t tree);
+/*! \brief Storage of a subsystem with one slot per topology object
+
+The topology is loaded once and shared read-only by all subsystems. Instead of
+attaching data to the userdata of the objects of a private copy of the
+topology, each subsystem keeps one slot per object, indexed by the offset of
+the scope in LoopAdaptScopeList and the logical index of the object.
+*/
+typedef struct {
+    int num_slots[LOOP_ADAPT_NUM_SCOPES]; /**< \brief Number of objects per scope */
+    void** slots[LOOP_ADAPT_NUM_SCOPES]; /**< \brief Slots per scope indexed by the logical index */
+} LoopAdaptTopologySlots;
+
+/*! \brief Use a hwloc XML file as topology cache. Must be called before the
+ *  topology is loaded. Each host uses its own file: a %h in the filename is
+ *  replaced by the hostname, otherwise the hostname is appended. If the file
+ *  does not exist or was written on another host, the topology is discovered
+ *  and the file is written */
+int loop_adapt_hwloc_tree_set_xml(char* filename);
+/*! \brief Use a hwloc synthetic description like "pack:2 core:8 pu:2" instead of
+ *  the topology of the system. Must be called before the topology is loaded.
+ *  It has precedence over the XML cache */
+int loop_adapt_hwloc_tree_set_synthetic(char* description);
+/*! \brief Check whether the loaded topology is synthetic. Threads are not
+ *  pinned on a synthetic topology */
+int loop_adapt_hwloc_tree_is_synthetic();
+int loop_adapt_hwloc_tree_initialize();
+/*! \brief Get the shared topology tree. It must not be modified */
+hwloc_topology_t loop_adapt_hwloc_tree_get();
+/*! \brief Get the number of objects of a scope in the shared topology tree */
+int loop_adapt_hwloc_tree_count(int scope);
 void loop_adapt_hwloc_tree_finalize();
 
+/*! \brief Allocate empty slots for all objects of the shared topology tree */
+int loop_adapt_hwloc_tree_slots_init(LoopAdaptTopologySlots* slots);
+/*! \brief Free the slots. The data stored in the slots is not freed */
+void loop_adapt_hwloc_tree_slots_destroy(LoopAdaptTopologySlots* slots);
+
+/*! \brief Get the slot at the logical index idx of the scope at offset s in LoopAdaptScopeList */
+static inline void** loop_adapt_hwloc_tree_slot_at(LoopAdaptTopologySlots* slots, int s, int idx)
+{
+    if (s >= 0 && s < LOOP_ADAPT_NUM_SCOPES && idx >= 0 && idx < slots->num_slots[s])
+    {
+        return &slots->slots[s][idx];
+    }
+    return NULL;
+}
+
+/*! \brief Get the slot at the logical index idx of a scope */
+static inline void** loop_adapt_hwloc_tree_slot(LoopAdaptTopologySlots* slots, int scope, int idx)
+{
+    return loop_adapt_hwloc_tree_slot_at(slots, loop_adapt_scope_offset(scope), idx);
+}
+
+/*! \brief Get the logical index of the PU with the OS CPU index cpu */
+int loop_adapt_hwloc_tree_cpu_to_pu(int cpu);
+/*! \brief Get the logical indices of the objects containing CPU cpu for all
+ *  scopes (LOOP_ADAPT_NUM_SCOPES entries in LoopAdaptScopeList order, -1 if
+ *  the scope has no object for the CPU) */
+int loop_adapt_hwloc_tree_scope_offsets(int cpu, int* offsets);
+
 #endif /* LOOP_ADAPT_HWLOC_TREE_H */
@@ -1,9 +1,18 @@
 #ifndef LOOP_ADAPT_INTERNAL_H
 #define LOOP_ADAPT_INTERNAL_H
 
+#include <time.h>
 #include <loop_adapt_types.h>
 
+/*! \brief Monotonic timestamp in seconds, used for debug output of setup times */
+static inline double loop_adapt_timestamp()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1E-9 * (double)ts.tv_nsec;
+}
+
 int loop_adapt_get_loop_parameter(char* string, struct bstrList* parameters);
 int loop_adapt_get_loopdata(char* string, LoopData_t *loopdata);
 
-#endif
\ No newline at end of file
+#endif /* LOOP_ADAPT_INTERNAL_H */
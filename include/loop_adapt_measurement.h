@@ -4,6 +4,7 @@
 #include <loop_adapt_parameter_value_types.h>
 #include <loop_adapt_configuration_types.h>
 #include <loop_adapt_threads.h>
+#include <loop_adapt_histogram.h>
 #include <bstrlib.h>
 
 int loop_adapt_measurement_initialize();
@@ -15,6 +16,24 @@ int loop_adapt_measurement_stop(ThreadData_t thread, char* measurement);
 int loop_adapt_measurement_stop_all();
 int loop_adapt_measurement_result(ThreadData_t thread, char* measurement, int num_values, ParameterValue* value);
 
+/* Measurement names are interned at initialization. The ID is the index in
+ * the list of active measurement backends and is used to index the
+ * measurement lists in the measurement tree. The functions with string
+ * arguments are wrappers. */
+int loop_adapt_measurement_id(char* measurement);
+/* Backends are initialized when they are first referenced by a policy or a
+ * configuration. Returns 0 if the backend is usable */
+int loop_adapt_measurement_init_id(int id);
+int loop_adapt_measurement_setup_id(ThreadData_t thread, int id, bstring configuration, bstring metrics);
+int loop_adapt_measurement_start_id(ThreadData_t thread, int id);
+int loop_adapt_measurement_stop_id(ThreadData_t thread, int id);
+int loop_adapt_measurement_result_id(ThreadData_t thread, int id, int num_values, ParameterValue* value);
+/* Histogram for the per-iteration durations of a running measurement of the
+ * thread. NULL if the backend does not record iterations */
+LoopAdaptHistogram* loop_adapt_measurement_histogram_id(ThreadData_t thread, int id);
+/* Whether the results of the backend are sums over the measured iterations */
+int loop_adapt_measurement_cumulative_id(int id);
+
 int loop_adapt_measurement_available(char* measurement);
 int loop_adapt_measurement_num_metrics(ThreadData_t thread);
 
@@ -0,0 +1,18 @@
+#ifndef LOOP_ADAPT_MEASUREMENT_ITERTIME_H
+#define LOOP_ADAPT_MEASUREMENT_ITERTIME_H
+
+#include <loop_adapt_histogram.h>
+
+int loop_adapt_measurement_itertime_init();
+
+int loop_adapt_measurement_itertime_setup(int instance, bstring configuration, bstring metrics);
+void loop_adapt_measurement_itertime_start(int instance);
+void loop_adapt_measurement_itertime_startall();
+void loop_adapt_measurement_itertime_stop(int instance);
+void loop_adapt_measurement_itertime_stopall();
+int loop_adapt_measurement_itertime_result(int instance, int num_values, ParameterValue* values);
+int loop_adapt_measurement_itertime_configs(struct bstrList* configs);
+LoopAdaptHistogram* loop_adapt_measurement_itertime_histogram(int instance);
+void loop_adapt_measurement_itertime_finalize();
+
+#endif /* LOOP_ADAPT_MEASUREMENT_ITERTIME_H */
@@ -3,12 +3,13 @@
 
 #include <loop_adapt_measurement_likwid.h>
 #include <loop_adapt_measurement_timer.h>
+#include <loop_adapt_measurement_itertime.h>
 
 #ifdef LIKWID_NVMON
 #include <loop_adapt_measurement_likwid_nvmon.h>
-#define NUM_LOOP_ADAPT_MEASUREMENTS 3
+#define NUM_LOOP_ADAPT_MEASUREMENTS 4
 #else
-#define NUM_LOOP_ADAPT_MEASUREMENTS 2
+#define NUM_LOOP_ADAPT_MEASUREMENTS 3
 #endif
 
 int loop_adapt_measurement_list_count = NUM_LOOP_ADAPT_MEASUREMENTS;
@@ -36,7 +37,21 @@ MeasurementDefinition loop_adapt_measurement_list[NUM_LOOP_ADAPT_MEASUREMENTS] =
      .stopall = loop_adapt_measurement_timer_stopall,
      .result = loop_adapt_measurement_timer_result,
      .configs = loop_adapt_measurement_timer_configs,
-     .finalize = loop_adapt_measurement_timer_finalize
+     .finalize = loop_adapt_measurement_timer_finalize,
+     .cumulative = 1
+    },
+    {.name = "ITERTIME",
+     .scope = LOOP_ADAPT_MEASUREMENT_SCOPE_THREAD,
+     .init = loop_adapt_measurement_itertime_init,
+     .setup = loop_adapt_measurement_itertime_setup,
+     .start = loop_adapt_measurement_itertime_start,
+     .startall = loop_adapt_measurement_itertime_startall,
+     .stop = loop_adapt_measurement_itertime_stop,
+     .stopall = loop_adapt_measurement_itertime_stopall,
+     .result = loop_adapt_measurement_itertime_result,
+     .configs = loop_adapt_measurement_itertime_configs,
+     .finalize = loop_adapt_measurement_itertime_finalize,
+     .histogram = loop_adapt_measurement_itertime_histogram
     },
 #ifdef LIKWID_NVMON
     {.name = "LIKWID_NVMON",
@@ -5,6 +5,7 @@
 #include <bstrlib.h>
 #include <loop_adapt_parameter_types.h>
 #include <loop_adapt_scopes.h>
+#include <loop_adapt_histogram.h>
 
 #define LOOP_ADAPT_MEASUREMENT_SCOPE_MIN HWLOC_OBJ_TYPE_MIN
 typedef enum {
@@ -42,6 +43,13 @@ typedef struct {
 } Measurement;
 typedef Measurement* Measurement_t;
 
+/*! \brief Measurements at an object of the measurement tree, indexed by measurement ID */
+typedef struct {
+    int count; /**< \brief Number of measurements at the object */
+    int size; /**< \brief Size of the measurements array */
+    Measurement_t* measurements;
+} MeasurementList;
+
 
 typedef int (*measurement_init_function)();
 typedef int (*measurement_setup_function)(int instance, bstring configuration, bstring metrics);
@@ -52,6 +60,7 @@ typedef void (*measurement_stopall_function)();
 typedef int (*measurement_result_function)(int instance, int num_values, ParameterValue* values);
 typedef int (*measurement_configs_function)(struct bstrList* configs);
 typedef void (*measurement_finalize_function)();
+typedef LoopAdaptHistogram* (*measurement_histogram_function)(int instance);
 
 typedef struct {
     char* name;
@@ -65,6 +74,9 @@ typedef struct {
     measurement_result_function result;
     measurement_configs_function configs;
     measurement_finalize_function finalize;
+    measurement_histogram_function histogram; /**< \brief Histogram filled with the duration of each loop iteration or NULL */
+    int cumulative; /**< \brief Results are sums over all iterations (normalized for adaptive cycles) */
+    int initialized; /**< \brief Backend state: 0 not initialized, 1 initialized, < 0 init failed */
 } MeasurementDefinition;
 
 #endif /* LOOP_ADAPT_MEASUREMENT_TYPES_H */
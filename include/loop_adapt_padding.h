@@ -0,0 +1,33 @@
+#ifndef LOOP_ADAPT_PADDING_H
+#define LOOP_ADAPT_PADDING_H
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Per-thread data is aligned and padded to this size. On systems where the
+ * adjacent cache line prefetcher fetches cache lines in pairs, build with
+ * -DLOOP_ADAPT_CACHELINE_SIZE=128 to keep the threads apart. */
+#ifndef LOOP_ADAPT_CACHELINE_SIZE
+#define LOOP_ADAPT_CACHELINE_SIZE 64
+#endif
+
+/* Round size up to full cache lines */
+#define LOOP_ADAPT_PADDED_SIZE(size) \
+    ((((size) + LOOP_ADAPT_CACHELINE_SIZE - 1) / LOOP_ADAPT_CACHELINE_SIZE) * LOOP_ADAPT_CACHELINE_SIZE)
+
+/* Allocate zeroed memory aligned and padded to full cache lines. If called by
+ * the thread owning the data, the memory is first touched by this thread and
+ * placed on its NUMA node. */
+static inline void* loop_adapt_padded_alloc(size_t size)
+{
+    void* ptr = NULL;
+    size_t padded = LOOP_ADAPT_PADDED_SIZE(size);
+    if (posix_memalign(&ptr, LOOP_ADAPT_CACHELINE_SIZE, padded) != 0)
+    {
+        return NULL;
+    }
+    memset(ptr, 0, padded);
+    return ptr;
+}
+
+#endif /* LOOP_ADAPT_PADDING_H */
@@ -23,10 +23,25 @@ int loop_adapt_parameter_get(ThreadData_t thread, char* parameter, ParameterValu
 int loop_adapt_parameter_getcurrent(ThreadData_t thread, char* parameter, ParameterValue* value);
 int loop_adapt_parameter_configs(struct bstrList* configs);
 
+/* Parameter names are interned at registration. The ID is the index in the
+ * list of active parameters and is used to index the parameter lists in the
+ * parameter tree. The functions with string arguments are wrappers. */
+int loop_adapt_parameter_id(char* name);
+/* The init function of a parameter is called when the parameter is first
+ * referenced by a loop, a configuration or a get/set. Returns 0 if the
+ * parameter is usable */
+int loop_adapt_parameter_init_id(int id);
+char* loop_adapt_parameter_name(int id);
+int loop_adapt_parameter_set_id(ThreadData_t thread, int id, ParameterValue value);
+int loop_adapt_parameter_get_id(ThreadData_t thread, int id, ParameterValue* value);
+int loop_adapt_parameter_getcurrent_id(ThreadData_t thread, int id, ParameterValue* value);
 
 ParameterValueType_t loop_adapt_parameter_type(char* name);
 LoopAdaptScope_t loop_adapt_parameter_scope(char* name);
 int loop_adapt_parameter_scope_count(char* name);
+ParameterValueType_t loop_adapt_parameter_type_id(int id);
+LoopAdaptScope_t loop_adapt_parameter_scope_id(int id);
+int loop_adapt_parameter_scope_count_id(int id);
 
 int loop_adapt_parameter_loop_start(ThreadData_t thread);
 int loop_adapt_parameter_loop_end(ThreadData_t thread, struct bstrList* loopparams);
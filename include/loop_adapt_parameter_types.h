@@ -45,6 +45,13 @@ typedef struct {
 } Parameter;
 typedef Parameter* Parameter_t;
 
+/*! \brief Parameters at an object of the parameter tree, indexed by parameter ID */
+typedef struct {
+    int count; /**< \brief Number of parameters at the object */
+    int size; /**< \brief Size of the parameters array */
+    Parameter_t* parameters;
+} ParameterList;
+
 typedef int (*parameter_init_function)(void);
 typedef int (*parameter_set_function)(int instance, ParameterValue value);
 typedef int (*parameter_get_function)(int instance, ParameterValue* value);
@@ -63,6 +70,7 @@ typedef struct {
     parameter_available_function avail;
     parameter_finalize_function finalize;
     int user;
+    int initialized; /**< \brief Backend state: 0 not initialized, 1 initialized, < 0 init failed */
 } ParameterDefinition;
 
 
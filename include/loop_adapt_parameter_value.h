@@ -1,6 +1,7 @@
 #ifndef LOOP_ADAPT_PARAMETER_VALUE_H
 #define LOOP_ADAPT_PARAMETER_VALUE_H
 
+#include <stddef.h>
 #include <loop_adapt_parameter_value_types.h>
 
 ParameterValue loop_adapt_new_param_value(ParameterValueType_t type);
@@ -16,6 +17,9 @@ int loop_adapt_mult_param_value(ParameterValue a, ParameterValue b, ParameterVal
 void loop_adapt_print_param_value(ParameterValue v);
 char* loop_adapt_print_param_valuetype(ParameterValueType_t t);
 char* loop_adapt_param_value_str(ParameterValue v);
+/* Format the value into s without allocation. Returns the length of the
+ * formatted value like snprintf */
+int loop_adapt_param_value_snprintf(char* s, size_t len, ParameterValue v);
 
 int loop_adapt_parse_param_value(char* string, ParameterValueType_t type, ParameterValue* value);
 
@@ -4,7 +4,7 @@
 #include <loop_adapt_policy_types.h>
 #include <loop_adapt_policy_functions.h>
 
-#define NUM_LOOP_ADAPT_POLICIES 9
+#define NUM_LOOP_ADAPT_POLICIES 14
 
 int loop_adapt_policy_list_count = NUM_LOOP_ADAPT_POLICIES;
 
@@ -60,6 +60,36 @@ _PolicyDefinition loop_adapt_policy_list[NUM_LOOP_ADAPT_POLICIES] = {
      .config = "L2",
      .match = "L2 data volume",
      .eval = loop_adapt_policy_function_sum,
+    },
+    {.name = "P50_TIME",
+     .backend = "ITERTIME",
+     .config = "P50",
+     .description = "Median iteration time of the slowest thread",
+     .eval = loop_adapt_policy_function_max,
+    },
+    {.name = "P90_TIME",
+     .backend = "ITERTIME",
+     .config = "P90",
+     .description = "90th percentile of the iteration time of the slowest thread",
+     .eval = loop_adapt_policy_function_max,
+    },
+    {.name = "P99_TIME",
+     .backend = "ITERTIME",
+     .config = "P99",
+     .description = "99th percentile of the iteration time of the slowest thread",
+     .eval = loop_adapt_policy_function_max,
+    },
+    {.name = "MAX_ITER_TIME",
+     .backend = "ITERTIME",
+     .config = "MAX",
+     .description = "Longest iteration of all threads",
+     .eval = loop_adapt_policy_function_max,
+    },
+    {.name = "VAR_TIME",
+     .backend = "ITERTIME",
+     .config = "VARIANCE",
+     .description = "Largest variance of the iteration time of the threads",
+     .eval = loop_adapt_policy_function_max,
     }
 
 
@@ -18,6 +18,7 @@ typedef struct {
 typedef struct {
     bstring name;
     bstring backend;
+    int backend_id; /**< \brief Measurement ID of the backend or negative if unknown */
     bstring description;
     bstring config;
     bstring match;
@@ -38,6 +38,28 @@ static const int LoopAdaptScopeList[LOOP_ADAPT_NUM_SCOPES] = {
     [LOOP_ADAPT_SCOPE_GPU_OFFSET] = LOOP_ADAPT_SCOPE_GPU
 };
 
+/*! \brief Get the offset of a scope in LoopAdaptScopeList (-1 for invalid scopes) */
+static inline int loop_adapt_scope_offset(int scope)
+{
+    switch (scope)
+    {
+        case LOOP_ADAPT_SCOPE_THREAD:
+            return LOOP_ADAPT_SCOPE_THREAD_OFFSET;
+        case LOOP_ADAPT_SCOPE_CORE:
+            return LOOP_ADAPT_SCOPE_CORE_OFFSET;
+        case LOOP_ADAPT_SCOPE_LLCACHE:
+            return LOOP_ADAPT_SCOPE_LLCACHE_OFFSET;
+        case LOOP_ADAPT_SCOPE_NUMANODE:
+            return LOOP_ADAPT_SCOPE_NUMANODE_OFFSET;
+        case LOOP_ADAPT_SCOPE_SOCKET:
+            return LOOP_ADAPT_SCOPE_SOCKET_OFFSET;
+        case LOOP_ADAPT_SCOPE_SYSTEM:
+            return LOOP_ADAPT_SCOPE_SYSTEM_OFFSET;
+        case LOOP_ADAPT_SCOPE_GPU:
+            return LOOP_ADAPT_SCOPE_GPU_OFFSET;
+    }
+    return -1;
+}
 
 #define LOOP_ADAPT_VALID_SCOPE(scope) \
     ((scope) == LOOP_ADAPT_SCOPE_THREAD || \\
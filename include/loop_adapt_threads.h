@@ -20,4 +20,6 @@ int loop_adapt_threads_register_inparallel_func(int(*pf)(void));
 int loop_adapt_threads_in_parallel();
 int loop_adapt_threads_get_count();
 
+void* loop_adapt_threads_runtime_alloc(ThreadData_t thread, size_t size);
+
 #endif /* LOOP_ADAPT_THREADS_H */
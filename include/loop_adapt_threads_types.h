@@ -4,10 +4,20 @@
 #include <sys/types.h>
 #include <pthread.h>
 #include <loop_adapt_scopes.h>
+#include <loop_adapt_padding.h>
+#include <loop_adapt_arena.h>
 
 
 
+/*! \brief Chunk of the per-thread runtime block, the data follows the header */
+typedef struct LoopAdaptRuntimeChunk {
+    struct LoopAdaptRuntimeChunk* next;
+    size_t size; /**< \brief Usable bytes after the header */
+    size_t used; /**< \brief Used bytes after the header */
+} LoopAdaptRuntimeChunk;
+
 typedef struct {
+    int index; /**< \brief Registration index of the thread (0 .. number of threads - 1) */
     int objidx;
     int cpu;
     int thread;
@@ -18,7 +28,10 @@ typedef struct {
     pthread_t pthread;
     pthread_mutex_t lock;
     int scopeOffsets[LOOP_ADAPT_NUM_SCOPES];
-} ThreadData;
+    void* loop_counters; /**< \brief Per-loop iteration counters of the thread (cache line padded, first touched by the thread), freed with the thread data */
+    LoopAdaptArena arena; /**< \brief Scratch memory of the thread for the current measurement cycle */
+    LoopAdaptRuntimeChunk* runtime; /**< \brief Runtime block with the per-loop data of the thread, freed with the thread data */
+} __attribute__((aligned(LOOP_ADAPT_CACHELINE_SIZE))) ThreadData;
 typedef ThreadData* ThreadData_t;
 
 
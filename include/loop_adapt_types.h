@@ -4,6 +4,9 @@
 #include <pthread.h>
 #include <bstrlib.h>
 #include <map.h>
+#include <loop_adapt_padding.h>
+#include <loop_adapt_histogram.h>
+#include <loop_adapt_barrier.h>
 
 #include <loop_adapt.h>
 #include <loop_adapt_configuration_types.h>
@@ -18,44 +21,70 @@ typedef enum {
     LOOP_ADAPT_THREAD_RUN, /**< \brief Thread is running */
 } LoopThreadState;
 
+/*! \brief Status of a loop */
+typedef enum {
+    LOOP_STARTED = 0, /**< \brief Loop is running */
+    LOOP_STOPPED = 1, /**< \brief Loop is stopped */
+} LoopRunStatus;
+
 /*! \brief Base structure describing a thread
 
 This structure contains information about the registered threads. At
 registration it determines some values like system PID, current CPU, ...
+Each loop has an array of pointers to these structures indexed by the
+registration index of the thread. Each entry is allocated separately and padded
+to full cache lines, so it does not move when the array is extended.
 */
 typedef struct {
     pthread_t pthread; /**< \brief PThreads data structure */
     int thread; /**< \brief Thread ID given by loop_adapt */
     int num_iterations;
-    LoopAdaptConfiguration_t config;
+    LoopAdaptConfiguration_t config; /**< \brief Reference to the configuration of the current cycle */
     int current_config_id; 
     cpu_set_t cpuset; /**< \brief Current CPUset */
     LoopThreadState state; /**< \brief Status of the thread */
-} LoopThreadData;
+    LoopRunStatus status; /**< \brief The thread runs the current cycle of the loop with a configuration */
+    LoopAdaptHistogram* histogram; /**< \brief Per-iteration histogram of the current measurement or NULL */
+    LoopAdaptHistogram* cycle_histogram; /**< \brief Iteration times for adaptive cycles if the backend has no histogram */
+    int sampled; /**< \brief The current cycle is measured */
+    int skip_cycles; /**< \brief Cycles without measurement before the next measured cycle */
+    unsigned int sample_seed; /**< \brief State of the random generator for randomized sampling */
+    int evaluated; /**< \brief The thread evaluated all configurations */
+    int tuned; /**< \brief All configurations evaluated and the best one is applied */
+    int barrier_sense; /**< \brief Sense of the thread for the barrier of the loop */
+} __attribute__((aligned(LOOP_ADAPT_CACHELINE_SIZE))) LoopThreadData;
 /*! \brief Pointer to a ThreadData structure */
 typedef LoopThreadData* LoopThreadData_t;
 
 
 
-/*! \brief Status of a loop */
-typedef enum {
-    LOOP_STARTED = 0, /**< \brief Loop is running */
-    LOOP_STOPPED = 1, /**< \brief Loop is stopped */
-} LoopRunStatus;
+/*! \brief Number of configurations whose evaluations are combined at the same time */
+#define LOOP_ADAPT_EVAL_SLOTS 8
+
+/*! \brief Policy evaluation of a configuration combined over the threads of a loop */
+typedef struct {
+    int config_id; /**< \brief Configuration or -1 if unused */
+    int count; /**< \brief Threads which reported their evaluation, negative if the evaluation is complete */
+    double value; /**< \brief Evaluations of the threads combined by the evaluation function of the policy */
+} LoopAdaptEvaluation;
 
-/*! \brief Base loop structure associated with a topology tree
+/*! \brief Base loop structure
 
 This structure is used as base information about a loop and stored in the
-loop's topology tree. This way we just need to resolve the loop name to the
-topology tree and have all required data about the loop.
+global hash table and the list of loop handles. This way we just need to
+resolve the loop name or handle to have all required data about the loop.
 */
 typedef struct {
     char* filename; /**< \brief Filename where the loop is defined */
     int linenumber; /**< \brief Line number in filename where the loop is defined */
     int num_iterations;
-    int max_iterations;
+    int max_iterations; /**< \brief Measured iterations per cycle */
+    int warmup; /**< \brief Iterations per cycle before the measurement starts */
+    int min_iterations; /**< \brief Adaptive loops: Minimal measured iterations per cycle, max_iterations is the maximum */
+    double confidence; /**< \brief Adaptive loops: Relative half-width of the confidence interval, 0 for fixed cycles */
+    int sample_interval; /**< \brief Only 1 in sample_interval cycles is measured */
+    int sample_random; /**< \brief The measured cycles are selected randomly */
 //    int num_policies; /**< \brief Number of registered policies */
-    LoopRunStatus status; /**< \brief State of the loop */
 //   int cur_policy_id; /**< \brief ID of currently active policy */
 //    Policy_t cur_policy; /**< \brief Pointer to the currently active policy */
 //    Policy_t *policies; /**< \brief List of all policies */
@@ -64,11 +93,24 @@ typedef struct {
     struct bstrList* parameters;
     bstring loopname;
     int policy;
-    Map_t currentThreadConfig;
-    pthread_barrier_t barrier;
+    LoopThreadData_t* threads; /**< \brief Per-thread loop data indexed by the registration index of the thread (read without lock) */
+    int num_threads; /**< \brief Number of entries in threads, published after the entries */
+    LoopAdaptBarrier barrier; /**< \brief Barrier of the threads for synchronized loops */
+    int synchronized; /**< \brief All threads switch the configuration at the same iteration */
+    int vote_measuring; /**< \brief Synchronized adaptive loops: Threads measuring the cycle at the current check */
+    int vote_unconverged; /**< \brief Synchronized adaptive loops: Measuring threads which need more iterations */
+    int vote_decision; /**< \brief Synchronized adaptive loops: The cycle ends at the current check, set by the last thread at the barrier */
+    LoopAdaptSharedConfiguration configuration; /**< \brief Configuration of the current cycle shared by the threads */
+    LoopAdaptEvaluation evals[LOOP_ADAPT_EVAL_SLOTS]; /**< \brief Evaluations in progress indexed by the configuration modulo LOOP_ADAPT_EVAL_SLOTS (locked) */
+    int eval_threads; /**< \brief Threads with loop data, all of them evaluate the configurations */
+    int done_threads; /**< \brief Threads which evaluated all configurations (locked) */
+    int evaluated; /**< \brief All threads evaluated all configurations, the best configuration is fixed (locked) */
+    int best_config_id; /**< \brief Configuration with the best combined evaluation or -1 (locked) */
+    double best_value; /**< \brief Combined evaluation of the best configuration, lower is better (locked) */
 
     int current_config_id;
     int announced;
+    int handle; /**< \brief Index in the list of registered loops */
 } LoopData;
 /*! \brief Pointer to a Treedata structure */
 typedef LoopData* LoopData_t;
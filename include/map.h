@@ -31,6 +31,7 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stdint.h>
 #include <ghash.h>
 #include <ghash_add.h>
 
@@ -45,6 +46,8 @@ typedef enum {
     MAX_MAP_KEY_TYPE
 } MapKeyType;
 
+#ifdef LOOP_ADAPT_MAP_GHASH
+/* Old implementation (src/map_ghash.c) using the ghash copy as backend */
 typedef struct {
     mpointer key;
     mpointer value;
@@ -61,6 +64,42 @@ typedef struct {
     MapValue *values;
     map_value_destroy_func value_func;
 } Map;
+#else
+/* Open addressing hash table (src/map.c). The buckets contain the
+ * precomputed hash and the index of the entry in the values array. String
+ * keys are copied into a single key buffer, so there are no allocations
+ * per entry. The key buffer is compacted when it is full and contains keys
+ * of deleted entries. MAP_KEY_TYPE_BSTR maps behave like MAP_KEY_TYPE_STR maps. */
+typedef struct {
+    int64_t key; /**< \brief Integer key, offset of the string key in the key buffer or index of the next free slot if unused */
+    mpointer value;
+    uint32_t hash;
+    int used;
+} MapValue;
+
+typedef struct {
+    uint32_t hash;
+    int idx; /**< \brief Index in the values array or -1 if empty */
+} MapBucket;
+
+typedef struct {
+    int num_values; /**< \brief Number of entries */
+    int size; /**< \brief Number of used slots in the values array */
+    int max_size;
+    int id;
+    MapKeyType key_type;
+    MapValue *values;
+    int capacity; /**< \brief Number of allocated slots in the values array */
+    int free_head; /**< \brief First unused slot below size or -1 */
+    MapBucket *buckets;
+    uint32_t bucket_mask; /**< \brief Number of buckets - 1 (power of two) */
+    char *keys;
+    size_t keys_len;
+    size_t keys_size;
+    size_t keys_dead; /**< \brief Bytes of deleted keys in the key buffer */
+    map_value_destroy_func value_func;
+} Map;
+#endif
 
 typedef Map* Map_t;
 
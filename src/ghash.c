@@ -349,9 +349,6 @@ g_hash_table_remove_all_nodes (GHashTable *hash_table,
   gpointer key;
   gpointer value;
 
-  hash_table->nnodes = 0;
-  hash_table->noccupied = 0;
-
   if (!notify ||
       (hash_table->key_destroy_func == NULL &&
        hash_table->value_destroy_func == NULL))
@@ -359,6 +356,8 @@ g_hash_table_remove_all_nodes (GHashTable *hash_table,
       memset (hash_table->hashes, 0, hash_table->size * sizeof (guint));
       memset (hash_table->keys, 0, hash_table->size * sizeof (gpointer));
       memset (hash_table->values, 0, hash_table->size * sizeof (gpointer));
+      hash_table->nnodes = 0;
+      hash_table->noccupied = 0;
 
       return;
     }
@@ -368,6 +367,7 @@ g_hash_table_remove_all_nodes (GHashTable *hash_table,
       if (HASH_IS_REAL (hash_table->hashes[i]))
       {
         g_hash_table_remove_node(hash_table, i);
+        hash_table->hashes[i] = UNUSED_HASH_VALUE;
       }
 /*        {*/
 /*          key = hash_table->keys[i];*/
@@ -388,6 +388,8 @@ g_hash_table_remove_all_nodes (GHashTable *hash_table,
           hash_table->hashes[i] = UNUSED_HASH_VALUE;
         }
     }
+  hash_table->nnodes = 0;
+  hash_table->noccupied = 0;
 }
 
 static void
@@ -38,6 +38,8 @@
 #include <dlfcn.h>
 #include <sched.h>
 #include <signal.h>
+#include <limits.h>
+#include <math.h>
 
 #include <hwloc.h>
 #include <likwid.h>
@@ -55,21 +57,55 @@
 #include <loop_adapt_policy.h>
 #include <loop_adapt_configuration.h>
 
-/*! \brief  This is the base hwloc topology tree used later to create copies for each registered loop */
-/*static hwloc_topology_t topotree = NULL;*/
+/*! \brief  z-value of the two-sided 95% confidence interval used for adaptive cycles */
+#define LOOP_ADAPT_CONFIDENCE_Z 1.96
+/*! \brief  An adaptive cycle which is not yet precise enough is checked again
+ *  after 1/LOOP_ADAPT_CHECK_DIVISOR more measured iterations */
+#define LOOP_ADAPT_CHECK_DIVISOR 8
+/*! \brief  Tuned loops call the library only when the iteration counter of
+ *  the inline fast path reaches this value */
+#define LOOP_ADAPT_TUNED_CHECK (INT_MAX - 1)
 
-/*! \brief  This is the global hash table, the main entry point to the loop_adapt data */
+
+/*! \brief  This is the global hash table, the main entry point to the loop_adapt data.
+ *  It maps the loop names to the loop data and is read without lock. It is
+ *  never modified after publication, registration publishes a copy with the
+ *  new loop and retires the old table */
 static Map_t loop_adapt_global_hash = NULL;
 /*! \brief  This is the lock for the global hash table */
 static pthread_mutex_t loop_adapt_global_hash_lock = PTHREAD_MUTEX_INITIALIZER;
 /*! \brief Basic lock securing the loop_adapt data structures */
 static pthread_mutex_t loop_adapt_lock = PTHREAD_MUTEX_INITIALIZER;
+/*! \brief  List of registered loops. The index in this list is the loop handle.
+ *  It is read without lock, registration appends under
+ *  loop_adapt_global_hash_lock and publishes the loop by incrementing
+ *  loop_adapt_num_loops. A full list is replaced by a larger copy. */
+static LoopData_t* loop_adapt_loops = NULL;
+/*! \brief  Number of registered loops */
+static int loop_adapt_num_loops = 0;
+/*! \brief  Size of the list of registered loops */
+static int loop_adapt_loops_size = 0;
+/*! \brief  Replaced arrays and hash tables which may still be used by
+ *  readers. They are freed at finalization */
+typedef struct {
+    void* ptr;
+    void (*destroy)(void* ptr);
+} LoopAdaptRetired;
+static LoopAdaptRetired* loop_adapt_retired = NULL;
+static int loop_adapt_num_retired = 0;
 
 
 
 
 int loop_adapt_active = 1;
 LoopAdaptDebugLevel loop_adapt_verbosity = LOOP_ADAPT_DEBUGLEVEL_ONLYERROR;
+/*! \brief  Epoch of the loop counters. It is zero if loop_adapt is not
+ *  initialized and changes with each initialization, so thread-local counters
+ *  of a previous run are not used anymore */
+int loop_adapt_epoch = 0;
+static int loop_adapt_epoch_count = 0;
+/*! \brief  Thread-local loop counters used by the inline fast path in loop_adapt.h */
+__thread LoopAdaptThreadCounters loop_adapt_thread_counters = {0, 0, NULL};
 
 
 
@@ -78,33 +114,151 @@ LoopAdaptDebugLevel loop_adapt_verbosity = LOOP_ADAPT_DEBUGLEVEL_ONLYERROR;
 # Helper functions for allocation and deallocation of loop objects
 ###############################################################################
 */
-static LoopThreadData_t _loop_adapt_new_loopdata_thread()
+/* Keep an object replaced by a copy until finalization, because readers may
+ * still use it. The caller has to hold loop_adapt_global_hash_lock */
+static void _loop_adapt_retire_with(void* ptr, void (*destroy)(void* ptr))
 {
-    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, New loop data thread);
-    LoopThreadData_t ldata = malloc(sizeof(LoopThreadData));
-    if (!ldata)
+    LoopAdaptRetired* retired = realloc(loop_adapt_retired, (loop_adapt_num_retired+1)*sizeof(LoopAdaptRetired));
+    if (!retired)
+    {
+        ERROR_PRINT(Cannot retire object %p, ptr);
+        return;
+    }
+    loop_adapt_retired = retired;
+    loop_adapt_retired[loop_adapt_num_retired].ptr = ptr;
+    loop_adapt_retired[loop_adapt_num_retired].destroy = destroy;
+    loop_adapt_num_retired++;
+}
+
+static void _loop_adapt_retire(void* ptr)
+{
+    _loop_adapt_retire_with(ptr, free);
+}
+
+static void _loop_adapt_destroy_index(void* ptr)
+{
+    destroy_smap((Map_t)ptr);
+}
+
+static void _loop_adapt_free_retired()
+{
+    int i = 0;
+    for (i = 0; i < loop_adapt_num_retired; i++)
+    {
+        loop_adapt_retired[i].destroy(loop_adapt_retired[i].ptr);
+    }
+    free(loop_adapt_retired);
+    loop_adapt_retired = NULL;
+    loop_adapt_num_retired = 0;
+}
+
+/* Seed for randomized sampling of a loop (murmur3 finalizer), must not be
+ * zero. All threads of a loop start with the same seed, so they measure the
+ * same cycles. */
+static unsigned int _loop_adapt_sample_seed(int handle)
+{
+    unsigned int seed = (unsigned int)(handle + 1) * 0x9E3779B9U;
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6BU;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35U;
+    seed ^= seed >> 16;
+    return (seed != 0 ? seed : 0x9E3779B9U);
+}
+
+/* Allocate the loop data of a thread in the runtime block of the thread. It
+ * is called at the first use of the loop data, usually by the thread itself,
+ * so the entry is first touched by the owning thread. The caller has to hold
+ * loop_adapt_global_hash_lock */
+static LoopThreadData_t _loop_adapt_new_loopdata_thread(LoopData_t ldata, int index)
+{
+    ThreadData_t t = loop_adapt_threads_getthread(index);
+    if (!t)
     {
-        ERROR_PRINT(Cannot allocate new loop data thread);
         return NULL;
     }
-    memset(ldata, 0, sizeof(LoopThreadData));
-    ldata->config = NULL;
-    CPU_ZERO(&ldata->cpuset);
-    return ldata;
+    LoopThreadData_t lt = loop_adapt_threads_runtime_alloc(t, sizeof(LoopThreadData));
+    if (!lt)
+    {
+        ERROR_PRINT(Cannot allocate loop data for thread %d, index);
+        return NULL;
+    }
+    lt->config = NULL;
+    lt->current_config_id = 0;
+    lt->num_iterations = 0;
+    lt->state = LOOP_ADAPT_THREAD_PAUSE;
+    lt->status = LOOP_STOPPED;
+    lt->histogram = NULL;
+    lt->cycle_histogram = NULL;
+    lt->sampled = 0;
+    lt->skip_cycles = 0;
+    lt->evaluated = 0;
+    lt->tuned = 0;
+    lt->barrier_sense = 0;
+    lt->sample_seed = _loop_adapt_sample_seed(ldata->handle);
+    CPU_ZERO(&lt->cpuset);
+    lt->pthread = t->pthread;
+    lt->thread = t->thread;
+    return lt;
 }
 
-/* This is a callback function that we hand over to the hash map at initialization
- * so that it cleans the values itself at finalization */
-static void _loop_adapt_free_loopdata_thread(void* t)
+/* Extend the per-thread loop data of a loop to num_threads entries. Only the
+ * pointer array is extended, the entries are allocated at their first use in
+ * the runtime block of the thread and never move. The pointer array is
+ * replaced by a larger copy and published before the new number of threads,
+ * so readers do not need a lock. The caller has to hold
+ * loop_adapt_global_hash_lock */
+static int _loop_adapt_resize_loopdata_threads(LoopData_t ldata, int num_threads)
 {
-    if (t)
+    LoopThreadData_t* threads = NULL;
+    LoopThreadData_t* old = ldata->threads;
+    if (num_threads <= ldata->num_threads)
+    {
+        return 0;
+    }
+    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Resize loop data threads from %d to %d, ldata->num_threads, num_threads);
+    threads = calloc(num_threads, sizeof(LoopThreadData_t));
+    if (!threads)
     {
-        LoopThreadData_t ldata = (LoopThreadData_t)t;
-        if (ldata->config)
-            loop_adapt_configuration_destroy_config(ldata->config);
+        ERROR_PRINT(Cannot allocate loop data for %d threads, num_threads);
+        return -ENOMEM;
+    }
+    if (old)
+    {
+        memcpy(threads, old, ldata->num_threads * sizeof(LoopThreadData_t));
+    }
+    __atomic_store_n(&ldata->threads, threads, __ATOMIC_RELEASE);
+    __atomic_store_n(&ldata->num_threads, num_threads, __ATOMIC_RELEASE);
+    if (ldata->synchronized)
+    {
+        // Threads registered after LA_SYNC_LOOP join the barrier
+        __atomic_store_n(&ldata->barrier.count, num_threads, __ATOMIC_RELEASE);
+    }
+    if (old)
+    {
+        _loop_adapt_retire(old);
+    }
+    return 0;
+}
 
-        memset(ldata, 0, sizeof(LoopThreadData));
-        free(t);
+/* The configurations referenced by the per-thread loop data are shared by the
+ * threads of the loop and freed with the loop data */
+static void _loop_adapt_free_loopdata_threads(LoopData_t ldata)
+{
+    int i = 0;
+    if (ldata->threads)
+    {
+        // The entries are freed with the runtime blocks of the threads
+        for (i = 0; i < ldata->num_threads; i++)
+        {
+            if (ldata->threads[i])
+            {
+                free(ldata->threads[i]->cycle_histogram);
+            }
+        }
+        free(ldata->threads);
+        ldata->threads = NULL;
+        ldata->num_threads = 0;
     }
 }
 
@@ -119,12 +273,17 @@ static LoopData_t _loop_adapt_new_loopdata()
     }
     /* Initialize data struct representing a single loop */
     memset(ldata, 0, sizeof(LoopData));
-    ldata->status = LOOP_STOPPED;
     ldata->filename = NULL;
     ldata->linenumber = -1;
     ldata->parameters = NULL;
     ldata->policy = -1;
-    ldata->currentThreadConfig = NULL;
+    ldata->threads = NULL;
+    ldata->num_threads = 0;
+    for (int i = 0; i < LOOP_ADAPT_EVAL_SLOTS; i++)
+    {
+        ldata->evals[i].config_id = -1;
+    }
+    ldata->best_config_id = -1;
 
     //ldata->threads = g_hash_table_new(g_direct_hash, g_direct_equal);
     //init_map(&ldata->threads, MAP_KEY_TYPE_INT, -1, _loop_adapt_free_loopdata_thread);
@@ -132,6 +291,7 @@ static LoopData_t _loop_adapt_new_loopdata()
     /* Create the hash map for the loops used in this loop execution. Register value deletion callback */
 /*    init_imap(&ldata->threads, _loop_adapt_free_loopdata_thread);*/
     pthread_mutex_init(&ldata->lock, NULL);
+    loop_adapt_configuration_shared_init(&ldata->configuration);
     return ldata;
 }
 
@@ -149,14 +309,69 @@ static void _loop_adapt_destroy_loopdata(gpointer val)
 
         // bstrListPrint(loopdata->parameters);
         // bstrListDestroy(loopdata->parameters);
-        if (loopdata->currentThreadConfig)
-            destroy_imap(loopdata->currentThreadConfig);
+        _loop_adapt_free_loopdata_threads(loopdata);
+        loop_adapt_configuration_shared_destroy(&loopdata->configuration);
         loopdata->policy = -1;
         memset(loopdata, 0, sizeof(LoopData));
         free(loopdata);
     }
 }
 
+/* This function is called when the loop starts and at the beginning of each
+ * loop iteration. The number of loops is published after the list entry, so
+ * no lock is required */
+static inline LoopData_t _loop_adapt_get_loop_by_handle(int handle)
+{
+    if (handle >= 0 && handle < __atomic_load_n(&loop_adapt_num_loops, __ATOMIC_ACQUIRE))
+    {
+        LoopData_t* loops = __atomic_load_n(&loop_adapt_loops, __ATOMIC_ACQUIRE);
+        return loops[handle];
+    }
+    return NULL;
+}
+
+/* Get the data of a loop by its name. The published global hash table is
+ * not modified anymore, so no lock is required */
+static int _loop_adapt_get_loop(char* string, LoopData_t* ldata)
+{
+    Map_t index = __atomic_load_n(&loop_adapt_global_hash, __ATOMIC_ACQUIRE);
+    if (index && get_smap_by_key(index, string, (void**)ldata) == 0)
+    {
+        return 0;
+    }
+    return -ENOENT;
+}
+
+/* Build a copy of the global hash table with an additional loop. The caller
+ * has to hold loop_adapt_global_hash_lock */
+static int _loop_adapt_extend_index(char* string, LoopData_t ldata, Map_t* index)
+{
+    int i = 0;
+    Map_t m = NULL;
+    int err = init_smap(&m, NULL);
+    if (err != 0)
+    {
+        return -ENOMEM;
+    }
+    for (i = 0; i < loop_adapt_num_loops; i++)
+    {
+        err = add_smap(m, bdata(loop_adapt_loops[i]->loopname), loop_adapt_loops[i]);
+        if (err < 0)
+        {
+            destroy_smap(m);
+            return err;
+        }
+    }
+    err = add_smap(m, string, ldata);
+    if (err < 0)
+    {
+        destroy_smap(m);
+        return err;
+    }
+    *index = m;
+    return 0;
+}
+
 /*
 ###############################################################################
 # Internal functions
@@ -177,6 +392,16 @@ void loop_adapt_signal_handle(int sig)
 ###############################################################################
 */
 
+int loop_adapt_topology_cache(char* filename)
+{
+    return loop_adapt_hwloc_tree_set_xml(filename);
+}
+
+int loop_adapt_topology_synthetic(char* description)
+{
+    return loop_adapt_hwloc_tree_set_synthetic(description);
+}
+
 void loop_adapt_debug_level(int level)
 {
     if (level >= LOOP_ADAPT_DEBUGLEVEL_MIN && level <= LOOP_ADAPT_DEBUGLEVEL_MAX)
@@ -199,6 +424,8 @@ void _loop_adapt_disable()
 
 void loop_adapt_finalize()
 {
+    // Invalidate the thread-local loop counters
+    loop_adapt_epoch = 0;
     // Finalize configuration system
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize configuration system);
     loop_adapt_configuration_finalize();
@@ -211,6 +438,34 @@ void loop_adapt_finalize()
     // Finalize parameter tree
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize parameter tree);
     loop_adapt_parameter_finalize();
+    // The per-thread loop data lives in the runtime blocks of the threads,
+    // so the loops are destroyed before the thread storage
+    pthread_mutex_lock(&loop_adapt_global_hash_lock);
+    if (loop_adapt_global_hash)
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Finalize global hash);
+        // The loop data in the hash table is freed with the list of loop handles
+        destroy_smap(loop_adapt_global_hash);
+        __atomic_store_n(&loop_adapt_global_hash, NULL, __ATOMIC_RELEASE);
+    }
+    if (loop_adapt_loops)
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Finalize loop handles);
+        int i = 0;
+        __atomic_store_n(&loop_adapt_num_loops, 0, __ATOMIC_RELEASE);
+        for (i = 0; i < loop_adapt_loops_size; i++)
+        {
+            if (loop_adapt_loops[i])
+            {
+                _loop_adapt_destroy_loopdata(loop_adapt_loops[i]);
+            }
+        }
+        free(loop_adapt_loops);
+        loop_adapt_loops = NULL;
+        loop_adapt_loops_size = 0;
+    }
+    _loop_adapt_free_retired();
+    pthread_mutex_unlock(&loop_adapt_global_hash_lock);
     // Finalize thread storage
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize thread storage);
     loop_adapt_threads_finalize();
@@ -222,26 +477,6 @@ void loop_adapt_finalize()
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Finalize central hwloc tree);
     loop_adapt_hwloc_tree_finalize();
 
-    if (loop_adapt_global_hash)
-    {
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Finalize global hash);
-        int i = 0;
-        for (i = 0; i <  get_smap_size(loop_adapt_global_hash); i++)
-        {
-            LoopData_t loopdata = NULL;
-            get_smap_by_idx(loop_adapt_global_hash, i, (void**)&loopdata);
-            if (loopdata)
-            {
-                pthread_mutex_destroy(&loopdata->lock);
-                loopdata->policy = -1;
-
-                memset(loopdata, 0, sizeof(LoopData));
-                free(loopdata);
-            }
-        }
-        destroy_smap(loop_adapt_global_hash);
-        loop_adapt_global_hash = NULL;
-    }
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, loop_adapt finalize);
     loop_adapt_active = 0;
 }
@@ -253,23 +488,25 @@ int loop_adapt_initialize()
     /* Do the initialization only once if loop_adapt is active.
      * We check whether the loop hash map and the hwloc topology tree exists
      */
-    if (loop_adapt_active && (!loop_adapt_global_hash))
+    if (loop_adapt_active && (!__atomic_load_n(&loop_adapt_global_hash, __ATOMIC_ACQUIRE)))
     {
         /* Initialize the hash map for the loopname -> string relation */
+        pthread_mutex_lock(&loop_adapt_global_hash_lock);
         if (!loop_adapt_global_hash)
         {
+            Map_t index = NULL;
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Initialize global hash);
-            pthread_mutex_lock(&loop_adapt_global_hash_lock);
-            err = init_smap(&loop_adapt_global_hash, NULL);
-            pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+            err = init_smap(&index, NULL);
             if (err != 0)
             {
+                pthread_mutex_unlock(&loop_adapt_global_hash_lock);
                 ERROR_PRINT(Failed to initialize global hash table);
-                loop_adapt_global_hash = NULL;
                 _loop_adapt_disable();
                 return 1;
             }
+            __atomic_store_n(&loop_adapt_global_hash, index, __ATOMIC_RELEASE);
         }
+        pthread_mutex_unlock(&loop_adapt_global_hash_lock);
 
 
         /* Not sure why we get it twice but there was a reason for storing a second version of the cpuset */
@@ -300,6 +537,7 @@ int loop_adapt_initialize()
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize thread storage);
         loop_adapt_threads_initialize();
         loop_adapt_threads_register(0);
+        loop_adapt_epoch = ++loop_adapt_epoch_count;
         // Initialize parameter tree
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize parameter tree);
         loop_adapt_parameter_initialize();
@@ -317,64 +555,217 @@ int loop_adapt_initialize()
     return 0;
 }
 
-void loop_adapt_register(char* string, int num_iterations)
+/* Register a loop. Fixed cycles have num_iterations measured iterations
+ * (confidence = 0), adaptive cycles between min_iterations and
+ * num_iterations */
+static int _loop_adapt_register(char* string, int num_iterations, int warmup, int min_iterations, double confidence)
 {
-    int err = 0;
-    hwloc_topology_t dup_tree = NULL;
+    LoopData_t existing = NULL;
     if (loop_adapt_active)
     {
+        if (num_iterations < 1 || warmup < 0)
+        {
+            ERROR_PRINT(Invalid iteration count %d or warmup %d for loop %s, num_iterations, warmup, string);
+            return -EINVAL;
+        }
+        if (confidence < 0 || min_iterations < 1 || min_iterations > num_iterations)
+        {
+            ERROR_PRINT(Invalid adaptive cycle %d to %d iterations with confidence %f for loop %s, min_iterations, num_iterations, confidence, string);
+            return -EINVAL;
+        }
         loop_adapt_initialize();
-        // Check whether there is already an element in the loopname -> loopdata
-        // hash map
-        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&dup_tree) == 0)
+        // Check whether the loop is already registered. It is checked again
+        // under the lock before inserting it
+        if (_loop_adapt_get_loop(string, &existing) == 0)
         {
             ERROR_PRINT(Loop string %s already registered, string);
-            return;
+            return -EEXIST;
         }
-        // Create a copy of the main hwloc topology tree used to represent the loop
-        err = loop_adapt_copy_hwloc_tree(&dup_tree);
-        if (err)
+        LoopData_t ldata = _loop_adapt_new_loopdata();
+        if (!ldata)
         {
-            ERROR_PRINT(Cannot duplicate topology tree %s: error %d, string, err);
-            return;
+            return -ENOMEM;
         }
-        LoopData_t ldata = _loop_adapt_new_loopdata();
         ldata->max_iterations = num_iterations;
+        ldata->warmup = warmup;
+        ldata->min_iterations = (confidence > 0 ? min_iterations : num_iterations);
+        ldata->confidence = confidence;
+        ldata->sample_interval = 1;
+        ldata->sample_random = 0;
         ldata->num_iterations = 0;
-        ldata->status = LOOP_STOPPED;
         ldata->loopname = bfromcstr(string);
         ldata->parameters = bstrListCreate();
-        init_imap(&ldata->currentThreadConfig, _loop_adapt_free_loopdata_thread);
-
-        // Safe the global data struct in the topology tree. We can store an
-        // object at the root of the tree. It does not work for tree elements later.
-        hwloc_topology_set_userdata(dup_tree, ldata);
 
-        // insert the loop-specific tree into the hash table using the string as key
+        // insert the loop data into the hash table using the string as key
+        // and add the loop data to the handle list
         pthread_mutex_lock(&loop_adapt_global_hash_lock);
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Registering loop '%s' with %d iterations per profile %d, string, ldata->max_iterations, ldata->status);
-        add_smap(loop_adapt_global_hash, string, (void*) dup_tree);
+        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&existing) == 0)
+        {
+            pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+            ERROR_PRINT(Loop string %s already registered, string);
+            _loop_adapt_destroy_loopdata(ldata);
+            return -EEXIST;
+        }
+        if (loop_adapt_num_loops == loop_adapt_loops_size)
+        {
+            // Readers may still use the old list, so it is replaced by a
+            // larger copy and not reallocated
+            int size = (loop_adapt_loops_size > 0 ? 2 * loop_adapt_loops_size : 16);
+            LoopData_t* loops = calloc(size, sizeof(LoopData_t));
+            if (!loops)
+            {
+                pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+                ERROR_PRINT(Cannot extend list of loop handles for loop %s, string);
+                _loop_adapt_destroy_loopdata(ldata);
+                return -ENOMEM;
+            }
+            if (loop_adapt_loops)
+            {
+                memcpy(loops, loop_adapt_loops, loop_adapt_num_loops*sizeof(LoopData_t));
+                _loop_adapt_retire(loop_adapt_loops);
+            }
+            __atomic_store_n(&loop_adapt_loops, loops, __ATOMIC_RELEASE);
+            loop_adapt_loops_size = size;
+        }
+        int err = _loop_adapt_resize_loopdata_threads(ldata, loop_adapt_threads_get_count());
+        if (err < 0)
+        {
+            pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+            _loop_adapt_destroy_loopdata(ldata);
+            return err;
+        }
+        Map_t index = NULL;
+        err = _loop_adapt_extend_index(string, ldata, &index);
+        if (err < 0)
+        {
+            pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+            ERROR_PRINT(Cannot extend global hash table for loop %s, string);
+            _loop_adapt_destroy_loopdata(ldata);
+            return err;
+        }
+        ldata->handle = loop_adapt_num_loops;
+        loop_adapt_loops[ldata->handle] = ldata;
+        // Publish the loop for the readers
+        __atomic_store_n(&loop_adapt_num_loops, loop_adapt_num_loops + 1, __ATOMIC_RELEASE);
+        _loop_adapt_retire_with(loop_adapt_global_hash, _loop_adapt_destroy_index);
+        __atomic_store_n(&loop_adapt_global_hash, index, __ATOMIC_RELEASE);
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Registering loop '%s' with %d iterations per profile and %d warmup iterations (handle %d), string, ldata->max_iterations, ldata->warmup, ldata->handle);
         pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+        return ldata->handle;
+    }
+    return -ENODEV;
+}
+
+int loop_adapt_register(char* string, int num_iterations)
+{
+    return _loop_adapt_register(string, num_iterations, 0, num_iterations, 0);
+}
+
+int loop_adapt_register_ex(char* string, int num_iterations, int warmup)
+{
+    return _loop_adapt_register(string, num_iterations, warmup, num_iterations, 0);
+}
+
+int loop_adapt_register_adaptive(char* string, int min_iterations, int max_iterations, double confidence)
+{
+    if (confidence <= 0)
+    {
+        ERROR_PRINT(Confidence for adaptive loop %s must be positive, string);
+        return -EINVAL;
     }
+    return _loop_adapt_register(string, max_iterations, 0, min_iterations, confidence);
+}
+
+int loop_adapt_get_loop_handle(char* string)
+{
+    if (loop_adapt_active)
+    {
+        LoopData_t ldata = NULL;
+        if (_loop_adapt_get_loop(string, &ldata) == 0)
+        {
+            return ldata->handle;
+        }
+        ERROR_PRINT(Loop string %s not registered, string);
+        return -ENOENT;
+    }
+    return -ENODEV;
 }
 
 /* This function is called when the application registers a new loop thread */
 int loop_adapt_register_thread(int threadid)
 {
+    int i = 0;
+    int err = 0;
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Registering loop thread %d, threadid);
-    return loop_adapt_threads_register(threadid);
+    err = loop_adapt_threads_register(threadid);
+    if (err == 0)
+    {
+        // Extend the per-thread loop data of all registered loops
+        pthread_mutex_lock(&loop_adapt_global_hash_lock);
+        // If it fails, the loop data is extended again at the first use
+        int num_threads = loop_adapt_threads_get_count();
+        for (i = 0; i < loop_adapt_num_loops; i++)
+        {
+            int ret = _loop_adapt_resize_loopdata_threads(loop_adapt_loops[i], num_threads);
+            if (ret < 0)
+            {
+                err = ret;
+            }
+        }
+        pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+    }
+    return err;
+}
+
+/* Get the loop data of a thread without lock. Usually the array was already
+ * extended at thread registration, otherwise it is extended here. The entry
+ * itself is allocated at the first use. Entries are only stored under the
+ * lock into the current array, so a concurrent resize does not lose them */
+static LoopThreadData_t _loop_adapt_get_loopdata_thread(LoopData_t ldata, ThreadData_t thread)
+{
+    LoopThreadData_t lt = NULL;
+    if (thread->index < 0)
+    {
+        return NULL;
+    }
+    if (thread->index < __atomic_load_n(&ldata->num_threads, __ATOMIC_ACQUIRE))
+    {
+        lt = __atomic_load_n(&__atomic_load_n(&ldata->threads, __ATOMIC_ACQUIRE)[thread->index], __ATOMIC_ACQUIRE);
+        if (lt)
+        {
+            return lt;
+        }
+    }
+    pthread_mutex_lock(&loop_adapt_global_hash_lock);
+    if (thread->index >= ldata->num_threads)
+    {
+        _loop_adapt_resize_loopdata_threads(ldata, loop_adapt_threads_get_count());
+    }
+    if (thread->index < ldata->num_threads)
+    {
+        lt = ldata->threads[thread->index];
+        if (!lt)
+        {
+            lt = _loop_adapt_new_loopdata_thread(ldata, thread->index);
+            if (lt)
+            {
+                __atomic_add_fetch(&ldata->eval_threads, 1, __ATOMIC_RELEASE);
+            }
+            __atomic_store_n(&ldata->threads[thread->index], lt, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+    return lt;
 }
 
 int loop_adapt_add_loop_parameter(char* string, char* parameter)
 {
     if (loop_adapt_active)
     {
-        hwloc_topology_t tree = NULL;
-        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&tree) == 0)
+        LoopData_t ldata = NULL;
+        if (_loop_adapt_get_loop(string, &ldata) == 0)
         {
-            LoopData_t ldata = NULL;
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Found tree for loop %s, string);
-            ldata = (LoopData_t)hwloc_topology_get_userdata(tree);
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Found loop data for loop %s, string);
             if (ldata)
             {
                 int i = 0;
@@ -394,12 +785,14 @@ int loop_adapt_add_loop_parameter(char* string, char* parameter)
                 {
                     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Adding parameter %s to loop %s, parameter, string);
                     bstrListAdd(ldata->parameters, bparam);
+                    // First reference of the parameter initializes its backend
+                    loop_adapt_parameter_init_id(loop_adapt_parameter_id(parameter));
                 }
                 bdestroy(bparam);
             }
             else
             {
-                ERROR_PRINT(No tree defined for loop %s, string);
+                ERROR_PRINT(No loop data for loop %s, string);
             }
         }
         else
@@ -414,12 +807,9 @@ int loop_adapt_add_loop_policy(char* string, char* policy)
 {
     if (loop_adapt_active)
     {
-        hwloc_topology_t tree = NULL;
-        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&tree) == 0)
+        LoopData_t ldata = NULL;
+        if (_loop_adapt_get_loop(string, &ldata) == 0)
         {
-            LoopData_t ldata = NULL;
-
-            ldata = (LoopData_t)hwloc_topology_get_userdata(tree);
             if (ldata)
             {
                 if (ldata->policy >= 0)
@@ -431,7 +821,13 @@ int loop_adapt_add_loop_policy(char* string, char* policy)
                 int p = loop_adapt_policy_available(policy);
                 if (p >= 0)
                 {
+                    PolicyDefinition_t pol = loop_adapt_policy_get(p);
                     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Adding policy %s to loop %s, policy, string);
+                    // First reference of the measurement backend initializes it
+                    if (pol)
+                    {
+                        loop_adapt_measurement_init_id(pol->backend_id);
+                    }
                     ldata->policy = p;
                 }
             }
@@ -440,18 +836,73 @@ int loop_adapt_add_loop_policy(char* string, char* policy)
     return 0;
 }
 
+int loop_adapt_set_loop_sampling(char* string, int interval, int randomized)
+{
+    if (loop_adapt_active)
+    {
+        LoopData_t ldata = NULL;
+        if (interval < 1)
+        {
+            ERROR_PRINT(Invalid sampling interval %d for loop %s, interval, string);
+            return -EINVAL;
+        }
+        if (_loop_adapt_get_loop(string, &ldata) == 0 && ldata)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Measure %s 1 in %d cycles of loop %s, (randomized ? "random" : "every"), interval, string);
+            ldata->sample_random = randomized;
+            __atomic_store_n(&ldata->sample_interval, interval, __ATOMIC_RELEASE);
+            return 0;
+        }
+        ERROR_PRINT(Loop string %s not registered, string);
+        return -ENODEV;
+    }
+    return 0;
+}
+
+int loop_adapt_set_loop_synchronized(char* string, int enable)
+{
+    int i = 0;
+    if (loop_adapt_active)
+    {
+        LoopData_t ldata = NULL;
+        if (_loop_adapt_get_loop(string, &ldata) == 0 && ldata)
+        {
+            // Same lock as the thread registration, which extends the barrier
+            pthread_mutex_lock(&loop_adapt_global_hash_lock);
+            int count = loop_adapt_threads_get_count();
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Synchronize %d threads of loop %s: %d, count, string, enable);
+            loop_adapt_barrier_init(&ldata->barrier, count);
+            ldata->vote_measuring = 0;
+            ldata->vote_unconverged = 0;
+            for (i = 0; i < ldata->num_threads; i++)
+            {
+                LoopThreadData_t lt = ldata->threads[i];
+                if (lt)
+                {
+                    lt->barrier_sense = 0;
+                    // Randomized sampling has to select the same cycles in
+                    // all threads, otherwise they wait in different cycles
+                    lt->sample_seed = _loop_adapt_sample_seed(ldata->handle);
+                }
+            }
+            __atomic_store_n(&ldata->synchronized, (enable ? 1 : 0), __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&loop_adapt_global_hash_lock);
+            return 0;
+        }
+        ERROR_PRINT(Loop string %s not registered, string);
+        return -ENODEV;
+    }
+    return 0;
+}
 
 // internal use only
 int loop_adapt_get_loop_parameter(char* string, struct bstrList* parameters)
 {
     if (loop_adapt_active)
     {
-        hwloc_topology_t tree = NULL;
-        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&tree) == 0)
+        LoopData_t ldata = NULL;
+        if (_loop_adapt_get_loop(string, &ldata) == 0)
         {
-            LoopData_t ldata = NULL;
-
-            ldata = (LoopData_t)hwloc_topology_get_userdata(tree);
             if (ldata)
             {
                 int i = 0;
@@ -472,12 +923,9 @@ int loop_adapt_get_loopdata(char* string, LoopData_t *loopdata)
 {
     if (loop_adapt_active)
     {
-        hwloc_topology_t tree = NULL;
-        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&tree) == 0)
+        LoopData_t ldata = NULL;
+        if (_loop_adapt_get_loop(string, &ldata) == 0)
         {
-            LoopData_t ldata = NULL;
-
-            ldata = (LoopData_t)hwloc_topology_get_userdata(tree);
             if (ldata)
             {
                 *loopdata = ldata;
@@ -489,13 +937,134 @@ int loop_adapt_get_loopdata(char* string, LoopData_t *loopdata)
     return 0;
 }
 
-static int loop_adapt_handle_thread_stop(LoopData_t loop, ThreadData_t thread)
+/* Set the parameter values of a configuration for a thread */
+static void _loop_adapt_apply_configuration(ThreadData_t thread, LoopAdaptConfiguration_t config)
+{
+    int i = 0;
+    for (i = 0; i < config->num_parameters; i++)
+    {
+        LoopAdaptConfigurationParameter* cp = &config->parameters[i];
+        // The configuration may be shared with other threads, so it is not
+        // modified here
+        int id = (cp->id >= 0 ? cp->id : loop_adapt_parameter_id(bdata(cp->parameter)));
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, ConfigParam %d %s %d %d, i, bdata(cp->parameter), cp->num_values, thread->thread < cp->num_values);
+        if (cp->num_values > 1 && thread->thread < cp->num_values)
+        {
+            loop_adapt_parameter_set_id(thread, id, cp->values[thread->thread]);
+        }
+        else if (cp->num_values == 1)
+        {
+            loop_adapt_parameter_set_id(thread, id, cp->values[0]);
+        }
+        else
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Values %d, cp->num_values);
+        }
+    }
+}
+
+/* A completely reported evaluation competes for the best configuration of the
+ * loop. The caller has to hold the loop lock. */
+static void _loop_adapt_fold_evaluation(LoopData_t loop, LoopAdaptEvaluation* e)
+{
+    if (e->count > 0 && (loop->best_config_id < 0 || e->value < loop->best_value))
+    {
+        loop->best_config_id = e->config_id;
+        loop->best_value = e->value;
+    }
+    e->count = -1;
+}
+
+/* Combine the evaluation of a configuration by one thread with the ones of
+ * the other threads. The evaluation function of the policy is used for
+ * combining, so the MIN, MAX and SUM policies refer to all threads of the
+ * loop. Evaluations of threads lagging behind by more than
+ * LOOP_ADAPT_EVAL_SLOTS configurations are dropped. */
+static void _loop_adapt_add_evaluation(LoopData_t loop, PolicyDefinition_t pol, int config_id, double value)
+{
+    LoopAdaptEvaluation* e = &loop->evals[config_id % LOOP_ADAPT_EVAL_SLOTS];
+    pthread_mutex_lock(&loop->lock);
+    if (!loop->evaluated && e->config_id <= config_id)
+    {
+        if (e->config_id < config_id)
+        {
+            _loop_adapt_fold_evaluation(loop, e);
+            e->config_id = config_id;
+            e->count = 0;
+        }
+        if (e->count == 0)
+        {
+            e->value = value;
+            e->count = 1;
+        }
+        else if (e->count > 0)
+        {
+            ParameterValue v[2];
+            double r = 0;
+            v[0].type = LOOP_ADAPT_PARAMETER_TYPE_DOUBLE;
+            v[0].value.dval = e->value;
+            v[1].type = LOOP_ADAPT_PARAMETER_TYPE_DOUBLE;
+            v[1].value.dval = value;
+            if (pol->eval(2, v, &r) == 0)
+            {
+                e->value = r;
+            }
+            e->count++;
+        }
+        if (e->count >= __atomic_load_n(&loop->eval_threads, __ATOMIC_ACQUIRE))
+        {
+            _loop_adapt_fold_evaluation(loop, e);
+        }
+    }
+    pthread_mutex_unlock(&loop->lock);
+}
+
+/* The thread evaluated all configurations of the loop */
+static void _loop_adapt_evaluation_done(LoopData_t loop, ThreadData_t thread)
+{
+    LoopThreadData_t loopthread = _loop_adapt_get_loopdata_thread(loop, thread);
+    if (loopthread && !loopthread->evaluated)
+    {
+        loopthread->evaluated = 1;
+        pthread_mutex_lock(&loop->lock);
+        loop->done_threads++;
+        pthread_mutex_unlock(&loop->lock);
+    }
+}
+
+/* Returns 1 if all threads of the loop evaluated all configurations. The
+ * remaining evaluations are folded once, afterwards the best configuration
+ * does not change anymore. */
+static int _loop_adapt_evaluation_complete(LoopData_t loop)
+{
+    int i = 0;
+    int complete = 0;
+    pthread_mutex_lock(&loop->lock);
+    if (!loop->evaluated && loop->done_threads >= __atomic_load_n(&loop->eval_threads, __ATOMIC_ACQUIRE))
+    {
+        for (i = 0; i < LOOP_ADAPT_EVAL_SLOTS; i++)
+        {
+            _loop_adapt_fold_evaluation(loop, &loop->evals[i]);
+        }
+        loop->evaluated = 1;
+    }
+    complete = loop->evaluated;
+    pthread_mutex_unlock(&loop->lock);
+    return complete;
+}
+
+/* End the cycle for a thread. iterations is the number of measured
+ * iterations, weight the number of cycles represented by this cycle */
+static int loop_adapt_handle_thread_stop(LoopData_t loop, ThreadData_t thread, int iterations, int weight)
 {
     int err = 0;
     LoopThreadData_t loopthread = NULL;
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Stopping loop %s for thread %d, bdata(loop->loopname), thread->thread);
-    if (get_imap_by_key(loop->currentThreadConfig, thread->thread, (void**)&loopthread) == 0)
+    loopthread = _loop_adapt_get_loopdata_thread(loop, thread);
+    if (loopthread)
     {
+        // End of the cycle, release all scratch memory of the last cycle
+        loop_adapt_arena_reset(&thread->arena);
         PolicyDefinition_t pol = loop_adapt_policy_get(loop->policy);
         if (!pol)
         {
@@ -505,18 +1074,47 @@ static int loop_adapt_handle_thread_stop(LoopData_t loop, ThreadData_t thread)
         if (loopthread->config && blength(pol->backend) > 0)
         {
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Stopping measurement %s for thread %d, bdata(pol->backend), thread->thread);
-            err = loop_adapt_measurement_stop(thread, bdata(pol->backend));
+            err = loop_adapt_measurement_stop_id(thread, pol->backend_id);
             if (err == 0)
             {
 
                 int nmetrics = loop_adapt_measurement_num_metrics(thread);
-                ParameterValue* v = malloc(nmetrics * sizeof(ParameterValue));
+                ParameterValue* v = loop_adapt_arena_alloc(&thread->arena, nmetrics * sizeof(ParameterValue));
                 if (v)
                 {
-                    loop_adapt_measurement_result(thread, bdata(pol->backend), nmetrics, v);
+                    int nresults = loop_adapt_measurement_result_id(thread, pol->backend_id, nmetrics, v);
+                    double scale = 1.0;
+                    if (loop_adapt_measurement_cumulative_id(pol->backend_id))
+                    {
+                        if (loop->confidence > 0 && iterations > 0)
+                        {
+                            // Adaptive cycles differ in length, so sums are
+                            // compared per iteration
+                            scale = 1.0 / iterations;
+                        }
+                        else if (weight > 1)
+                        {
+                            // Sampled cycles are extrapolated to all cycles
+                            // they represent
+                            scale = weight;
+                        }
+                    }
+                    for (int j = 0; scale != 1.0 && j < nresults && j < nmetrics; j++)
+                    {
+                        if (v[j].type == LOOP_ADAPT_PARAMETER_TYPE_DOUBLE)
+                        {
+                            v[j].value.dval *= scale;
+                        }
+                    }
+                    // The configuration with the lowest evaluation of all
+                    // threads is applied when all configurations are evaluated
+                    double r = 0;
+                    if (pol->eval && nresults > 0 && pol->eval(nresults, v, &r) == 0)
+                    {
+                        _loop_adapt_add_evaluation(loop, pol, loopthread->current_config_id, r);
+                    }
                     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Write %d metrics for config with measurement %s, nmetrics, bdata(pol->backend));
                     loop_adapt_write_configuration_results(thread, bdata(loop->loopname), pol, loopthread->config, nmetrics, v);
-                    free(v);
                 }
                 else
                 {
@@ -531,28 +1129,20 @@ static int loop_adapt_handle_thread_stop(LoopData_t loop, ThreadData_t thread)
             loop_adapt_parameter_loop_end(thread, loop->parameters);
         }
     }
+    return err;
 }
 
 static int loop_adapt_handle_thread_start(LoopData_t loop, ThreadData_t thread)
 {
-    int i = 0;
     int err = 0;
     int first_iteration = 0;
     LoopThreadData_t loopthread = NULL;
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Starting loop %s for thread %d, bdata(loop->loopname), thread->thread);
-    if (get_imap_by_key(loop->currentThreadConfig, thread->thread, (void**)&loopthread) < 0)
+    loopthread = _loop_adapt_get_loopdata_thread(loop, thread);
+    if (!loopthread)
     {
-        loopthread = _loop_adapt_new_loopdata_thread();
-        if (loopthread)
-        {
-            loopthread->num_iterations = 0;
-            loopthread->current_config_id = 0;
-            loopthread->config = NULL;
-            loopthread->pthread = thread->pthread;
-            loopthread->thread = thread->thread;
-            loopthread->state = LOOP_ADAPT_THREAD_PAUSE;
-            add_imap(loop->currentThreadConfig, thread->thread, (void*)loopthread);
-        }
+        ERROR_PRINT(No loop data for thread %d, thread->thread);
+        return -ENODEV;
     }
     PolicyDefinition_t pol = loop_adapt_policy_get(loop->policy);
     if (!pol)
@@ -560,6 +1150,7 @@ static int loop_adapt_handle_thread_start(LoopData_t loop, ThreadData_t thread)
         ERROR_PRINT(No policy registered for loop %s, loop->loopname);
         return -ENODEV;
     }
+    loopthread->histogram = NULL;
     // if (loopthread->config)
     // {
     //     if (blength(pol->backend) > 0)
@@ -597,193 +1188,562 @@ static int loop_adapt_handle_thread_start(LoopData_t loop, ThreadData_t thread)
         loop_adapt_parameter_loop_start(thread);
         first_iteration = 1;
     }
-    err = loop_adapt_get_new_configuration(bdata(loop->loopname), loopthread->current_config_id, &loopthread->config);
+    err = loop_adapt_configuration_shared_get(&loop->configuration, bdata(loop->loopname), loopthread->current_config_id, &loopthread->config);
     if (err == 0)
     {
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, New configuration %d for thread %d (%p) %d params, loopthread->current_config_id, thread->thread, loopthread->config, loopthread->config->num_parameters);
-        for (i = 0; i < loopthread->config->num_parameters; i++)
+        _loop_adapt_apply_configuration(thread, loopthread->config);
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Setup measurement %s for thread %d, bdata(pol->backend), thread->thread);
+
+        err = loop_adapt_measurement_setup_id(thread, pol->backend_id, pol->config, pol->match);
+    }
+    else
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, No config for loop %s and thread %d, bdata(loop->loopname), thread->thread);
+    }
+    return err;
+}
+
+/* Start the measurement set up by loop_adapt_handle_thread_start. It is
+ * called after the warm-up iterations of the cycle */
+static int loop_adapt_handle_thread_measure(LoopData_t loop, ThreadData_t thread)
+{
+    int err = 0;
+    LoopThreadData_t loopthread = _loop_adapt_get_loopdata_thread(loop, thread);
+    if (!loopthread || !loopthread->config)
+    {
+        return -ENODEV;
+    }
+    PolicyDefinition_t pol = loop_adapt_policy_get(loop->policy);
+    if (!pol)
+    {
+        ERROR_PRINT(No policy registered for loop %s, loop->loopname);
+        return -ENODEV;
+    }
+    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Start measurement %s for thread %d, bdata(pol->backend), thread->thread);
+    err = loop_adapt_measurement_start_id(thread, pol->backend_id);
+    if (err == 0)
+    {
+        // Backends like ITERTIME need the duration of each iteration
+        loopthread->histogram = loop_adapt_measurement_histogram_id(thread, pol->backend_id);
+        if (!loopthread->histogram && loop->confidence > 0)
         {
-            LoopAdaptConfigurationParameter* cp = &loopthread->config->parameters[i];
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, ConfigParam %d %s %d %d, i, bdata(cp->parameter), cp->num_values, thread->thread < cp->num_values);
-            if (cp->num_values > 1 && thread->thread < cp->num_values)
+            // Adaptive cycles need the iteration times for the confidence
+            // interval. The histogram is allocated once per loop and thread
+            if (!loopthread->cycle_histogram)
             {
-                loop_adapt_parameter_set(thread, bdata(cp->parameter), cp->values[thread->thread]);
+                loopthread->cycle_histogram = loop_adapt_padded_alloc(sizeof(LoopAdaptHistogram));
             }
-            else if (cp->num_values == 1)
+            if (loopthread->cycle_histogram)
             {
-                loop_adapt_parameter_set(thread, bdata(cp->parameter), cp->values[0]);
-            }
-            else
-            {
-                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Values %d, cp->num_values);
+                loop_adapt_histogram_reset(loopthread->cycle_histogram);
             }
+            loopthread->histogram = loopthread->cycle_histogram;
         }
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Setup measurement %s for thread %d, bdata(pol->backend), thread->thread);
+    }
+    return err;
+}
 
-        err = loop_adapt_measurement_setup(thread, bdata(pol->backend), pol->config, pol->match);
-        if (err == 0)
+
+
+/* All threads evaluated all configurations of the loop. The configuration
+ * with the best combined evaluation is applied by all threads for the rest of
+ * the run. Without any evaluated configuration the parameters keep their
+ * initial values. */
+static int loop_adapt_handle_thread_tuned(LoopData_t loop, ThreadData_t thread)
+{
+    int err = 0;
+    int best_config_id = -1;
+    double best_value = 0;
+    LoopThreadData_t loopthread = _loop_adapt_get_loopdata_thread(loop, thread);
+    if (!loopthread)
+    {
+        return -ENODEV;
+    }
+    if (loopthread->tuned)
+    {
+        return 0;
+    }
+    pthread_mutex_lock(&loop->lock);
+    best_config_id = loop->best_config_id;
+    best_value = loop->best_value;
+    pthread_mutex_unlock(&loop->lock);
+    if (best_config_id >= 0)
+    {
+        err = loop_adapt_configuration_shared_get(&loop->configuration, bdata(loop->loopname), best_config_id, &loopthread->config);
+        if (err == 0 && loopthread->config)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Loop %s tuned for thread %d: Best configuration %d (%f), bdata(loop->loopname), thread->thread, best_config_id, best_value);
+            _loop_adapt_apply_configuration(thread, loopthread->config);
+        }
+        else
+        {
+            ERROR_PRINT(Cannot get best configuration %d for loop %s, best_config_id, bdata(loop->loopname));
+        }
+    }
+    loopthread->histogram = NULL;
+    loopthread->tuned = 1;
+    return err;
+}
+
+/* Tuned loops run without configuration and measurement. The inline fast path
+ * only counts the iterations and calls the library when the counter would
+ * overflow. */
+static inline void _loop_adapt_tuned_counter(LoopAdaptLoopCounter* counter)
+{
+    counter->num_iterations = 0;
+    counter->warmup = 0;
+    counter->next_check = LOOP_ADAPT_TUNED_CHECK;
+    counter->histogram = NULL;
+}
+
+/* Synchronized loops: Wait until all threads of the loop reached the cycle
+ * boundary. Outside of parallel regions, the calling thread handles all
+ * threads anyway. */
+static inline void _loop_adapt_sync_threads(LoopData_t ldata, LoopThreadData_t loopthread)
+{
+    if (__atomic_load_n(&ldata->synchronized, __ATOMIC_ACQUIRE) && loop_adapt_threads_in_parallel() != 0)
+    {
+        loop_adapt_barrier_wait(&ldata->barrier, &loopthread->barrier_sense);
+    }
+}
+
+/* Iteration of a cycle at which the library is called first. For fixed
+ * cycles it is the last one, adaptive cycles are checked after the minimal
+ * number of measured iterations */
+static inline int _loop_adapt_first_check(LoopData_t ldata)
+{
+    return ldata->warmup + ldata->min_iterations - 1;
+}
+
+/* Adaptive cycles: The measurement of a configuration is precise enough if
+ * the confidence interval of the mean iteration time is within +-confidence
+ * of the mean: z * s / sqrt(n) <= confidence * mean, compared squared */
+static int _loop_adapt_cycle_converged(LoopData_t ldata, LoopAdaptLoopCounter* counter)
+{
+    LoopAdaptHistogram* h = counter->histogram;
+    if (ldata->confidence <= 0 || !h || h->count < 2)
+    {
+        return 0;
+    }
+    double mean = loop_adapt_histogram_mean(h);
+    double var = loop_adapt_histogram_variance(h);
+    double limit = ldata->confidence * mean;
+    return (mean > 0 && LOOP_ADAPT_CONFIDENCE_Z * LOOP_ADAPT_CONFIDENCE_Z * var / (double)h->count <= limit * limit);
+}
+
+/* Counts the votes of the threads of a synchronized loop, called by the last
+ * thread arriving at the barrier */
+static int _loop_adapt_cycle_vote(void* arg)
+{
+    LoopData_t ldata = (LoopData_t)arg;
+    int measuring = __atomic_exchange_n(&ldata->vote_measuring, 0, __ATOMIC_ACQ_REL);
+    int unconverged = __atomic_exchange_n(&ldata->vote_unconverged, 0, __ATOMIC_ACQ_REL);
+    return (measuring > 0 && unconverged == 0);
+}
+
+/* Adaptive cycles of synchronized loops have to end at the same iteration in
+ * all threads. All threads reach the checks at the same iterations, they vote
+ * and the cycle ends when all measuring threads converged. */
+static int _loop_adapt_cycle_done(LoopData_t ldata, LoopThreadData_t loopthread, LoopAdaptLoopCounter* counter)
+{
+    int converged = _loop_adapt_cycle_converged(ldata, counter);
+    if (!__atomic_load_n(&ldata->synchronized, __ATOMIC_ACQUIRE) || loop_adapt_threads_in_parallel() == 0)
+    {
+        return converged;
+    }
+    if (counter->histogram)
+    {
+        __atomic_add_fetch(&ldata->vote_measuring, 1, __ATOMIC_RELAXED);
+        if (!converged)
         {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Setup measurement %s for thread %d, bdata(pol->backend), thread->thread);
-            err = loop_adapt_measurement_start(thread, bdata(pol->backend));
+            __atomic_add_fetch(&ldata->vote_unconverged, 1, __ATOMIC_RELAXED);
         }
     }
+    return loop_adapt_barrier_decide(&ldata->barrier, &loopthread->barrier_sense, _loop_adapt_cycle_vote, ldata, &ldata->vote_decision);
+}
+
+static inline unsigned int _loop_adapt_xorshift(unsigned int* state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Number of cycles without measurement after a measured cycle. With random
+ * sampling, each cycle is measured with probability p = 1/interval, so the gap
+ * is geometrically distributed. It is drawn by inversion of the distribution
+ * function: floor(log(u) / log(1 - p)) with u uniform in (0,1]. The gap is
+ * limited so that the unmeasured cycles fit into the iteration counter. */
+static int _loop_adapt_sample_gap(LoopData_t ldata, LoopThreadData_t loopthread, int cycle_length)
+{
+    int gap = 0;
+    int interval = __atomic_load_n(&ldata->sample_interval, __ATOMIC_ACQUIRE);
+    int max_gap = INT_MAX / (cycle_length > 0 ? cycle_length : 1);
+    if (interval <= 1)
+    {
+        return 0;
+    }
+    if (!ldata->sample_random)
+    {
+        gap = interval - 1;
+    }
     else
     {
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, No config for loop %s and thread %d, bdata(loop->loopname), thread->thread);
+        double u = ((double)_loop_adapt_xorshift(&loopthread->sample_seed) + 1.0) / 4294967296.0;
+        double g = floor(log(u) / log(1.0 - 1.0 / interval));
+        gap = (g < (double)max_gap ? (int)g : max_gap);
     }
-    return err;
+    return (gap < max_gap ? gap : max_gap - 1);
 }
 
+/* Get the loop counter of the calling thread. The thread-local counter list is
+ * allocated and extended by the owning thread and freed with its ThreadData. */
+static LoopAdaptLoopCounter* _loop_adapt_get_loop_counter(ThreadData_t thread, LoopData_t ldata)
+{
+    int i = 0;
+    LoopAdaptThreadCounters* t = &loop_adapt_thread_counters;
+    if (t->epoch != loop_adapt_epoch)
+    {
+        t->epoch = loop_adapt_epoch;
+        t->num_loops = 0;
+        t->loops = NULL;
+    }
+    if (ldata->handle >= t->num_loops)
+    {
+        int num_loops = __atomic_load_n(&loop_adapt_num_loops, __ATOMIC_ACQUIRE);
+        LoopData_t* ldatas = __atomic_load_n(&loop_adapt_loops, __ATOMIC_ACQUIRE);
+        LoopAdaptLoopCounter* loops = t->loops;
+        // The counter block is padded to full cache lines, so it is only
+        // reallocated if the loops do not fit into the padding anymore
+        size_t capacity = LOOP_ADAPT_PADDED_SIZE(t->num_loops * sizeof(LoopAdaptLoopCounter));
+        if (!loops || num_loops * sizeof(LoopAdaptLoopCounter) > capacity)
+        {
+            // Allocated and zeroed by the owning thread (first touch)
+            loops = loop_adapt_padded_alloc(num_loops * sizeof(LoopAdaptLoopCounter));
+            if (!loops)
+            {
+                ERROR_PRINT(Cannot allocate loop counters for thread %d, thread->thread);
+                return NULL;
+            }
+            if (t->loops)
+            {
+                memcpy(loops, t->loops, t->num_loops * sizeof(LoopAdaptLoopCounter));
+                free(t->loops);
+            }
+        }
+        for (i = t->num_loops; i < num_loops; i++)
+        {
+            loops[i].num_iterations = 0;
+            loops[i].max_iterations = ldatas[i]->warmup + ldatas[i]->max_iterations;
+            loops[i].warmup = ldatas[i]->warmup;
+            loops[i].next_check = _loop_adapt_first_check(ldatas[i]);
+            loops[i].histogram = NULL;
+        }
+        thread->loop_counters = loops;
+        t->loops = loops;
+        t->num_loops = num_loops;
+    }
+    return &t->loops[ldata->handle];
+}
 
-/* This function is called when the loop starts and at the beginning of each loop iteration */
-int loop_adapt_start_loop( char* string, char* file, int linenumber )
+int loop_adapt_start_loop_handle(int handle, char* file, int linenumber)
 {
     int i = 0;
-    int j = 0;
     int err = 0;
-    hwloc_topology_t tree = NULL;
     LoopData_t ldata = NULL;
     ThreadData_t thread = NULL;
     LoopThreadData_t loopthread = NULL;
-    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO,--- Starting loop %s, string);
+    LoopAdaptLoopCounter* counter = NULL;
     if (loop_adapt_active)
     {
-        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&tree) < 0)
+        ldata = _loop_adapt_get_loop_by_handle(handle);
+        if (!ldata)
         {
-            fprintf(stderr, "ERROR: Loop string %s not registered\n", string);
+            ERROR_PRINT(Loop handle %d not registered, handle);
             return 1;
         }
-        ldata = (LoopData_t)hwloc_topology_get_userdata(tree);
-        if (ldata)
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO,--- Starting loop %s, bdata(ldata->loopname));
+        // Get the topology data for the current thread
+        thread = loop_adapt_threads_get();
+        if (!thread)
+        {
+            return 1;
+        }
+        counter = _loop_adapt_get_loop_counter(thread, ldata);
+        if (!counter)
+        {
+            return 1;
+        }
+        loopthread = _loop_adapt_get_loopdata_thread(ldata, thread);
+        if (!loopthread)
+        {
+            return 1;
+        }
+        if (loopthread->tuned)
         {
-            // Get the topology data for the current thread
-            thread = loop_adapt_threads_get();
-            if (get_imap_by_key(ldata->currentThreadConfig, thread->thread, (void**)&loopthread) < 0)
+            _loop_adapt_tuned_counter(counter);
+            return 1;
+        }
+        loopthread->status = LOOP_STARTED;
+
+        // Unmeasured cycles of sampling loops run as one stretch without
+        // configuration and measurement
+        if (counter->num_iterations == 0 && loopthread->skip_cycles > 0)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Skip %d cycles of loop %s, loopthread->skip_cycles, bdata(ldata->loopname));
+            counter->next_check = loopthread->skip_cycles * counter->max_iterations - 1;
+            counter->histogram = NULL;
+            loopthread->sampled = 0;
+            loopthread->skip_cycles = 0;
+            loopthread->state = LOOP_ADAPT_THREAD_RUN;
+            return 1;
+        }
+        // At the beginning of each cycle, check for a new configuration
+        if (counter->num_iterations == 0)
+        {
+            loopthread->sampled = 1;
+            if (loopthread->evaluated)
+            {
+                // Waiting for the other threads of the loop
+                err = -EFAULT;
+            }
+            else
             {
-                loopthread = _loop_adapt_new_loopdata_thread();
-                if (loopthread)
+                err = loop_adapt_configuration_shared_get(&ldata->configuration, bdata(ldata->loopname), loopthread->current_config_id, &loopthread->config);
+            }
+            if (err == 0 && loopthread->config)
+            {
+                if (loop_adapt_threads_in_parallel() == 0)
                 {
-                    loopthread->num_iterations = 0;
-                    loopthread->current_config_id = 0;
-                    loopthread->config = NULL;
-                    loopthread->pthread = thread->pthread;
-                    loopthread->thread = thread->thread;
-                    loopthread->state = LOOP_ADAPT_THREAD_RUN;
-                    add_imap(ldata->currentThreadConfig, thread->thread, (void*)loopthread);
+                    for (i = 0; i < loop_adapt_threads_get_count(); i++)
+                    {
+                        ThreadData_t t = loop_adapt_threads_getthread(i);
+                        loop_adapt_handle_thread_start(ldata, t);
+                    }
+                }
+                else
+                {
+                    loop_adapt_handle_thread_start(ldata, thread);
                 }
             }
-            ldata->status = LOOP_STARTED;
-
-            //if (ldata->status == LOOP_STARTED && loopthread->num_iterations < ldata->max_iterations)
-            //{
-                // if (loopthread->num_iterations < ldata->max_iterations)
-                // {
-                //    loopthread->num_iterations++;
-                //    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Need more iterations for loop '%s', string);
-                //    return 1;
-                // }
-                // else
-                // {
-                //     if (loop_adapt_threads_in_parallel() == 0)
-                //     {
-                //         for (i = 0; i < loop_adapt_threads_get_count(); i++)
-                //         {
-                //             ThreadData_t t = loop_adapt_threads_getthread(i);
-                //             loop_adapt_handle_thread_start(ldata, t);
-                //         }
-                //     }
-                //     else
-                //     {
-                //         loop_adapt_handle_thread_start(ldata, thread);
-                //     }
-                //     loopthread->num_iterations = 0;
-                // }
-            //}
-            if (loopthread->num_iterations == 0)
-            {
-                err = loop_adapt_get_new_configuration(string, loopthread->current_config_id, &loopthread->config);
-                if (err == 0 && loopthread->config)
+            else if (err == -EFAULT)
+            {
+                // All configurations are evaluated by this thread
+                if (loop_adapt_threads_in_parallel() == 0)
+                {
+                    for (i = 0; i < loop_adapt_threads_get_count(); i++)
+                    {
+                        _loop_adapt_evaluation_done(ldata, loop_adapt_threads_getthread(i));
+                    }
+                }
+                else
+                {
+                    _loop_adapt_evaluation_done(ldata, thread);
+                }
+                // Threads of synchronized loops check the completion after
+                // all of them are done, so they all take the same path
+                _loop_adapt_sync_threads(ldata, loopthread);
+                if (_loop_adapt_evaluation_complete(ldata))
                 {
+                    // Apply the best configuration and stop calling the
+                    // configuration and measurement code
                     if (loop_adapt_threads_in_parallel() == 0)
                     {
                         for (i = 0; i < loop_adapt_threads_get_count(); i++)
                         {
                             ThreadData_t t = loop_adapt_threads_getthread(i);
-                            loop_adapt_handle_thread_start(ldata, t);
+                            loop_adapt_handle_thread_tuned(ldata, t);
                         }
                     }
                     else
                     {
-                        loop_adapt_handle_thread_start(ldata, thread);
+                        loop_adapt_handle_thread_tuned(ldata, thread);
+                    }
+                    loopthread->status = LOOP_STOPPED;
+                    loopthread->state = LOOP_ADAPT_THREAD_RUN;
+                    _loop_adapt_tuned_counter(counter);
+                    _loop_adapt_sync_threads(ldata, loopthread);
+                    return 1;
+                }
+                // Other threads still evaluate configurations, the cycle
+                // runs without configuration and measurement
+                loopthread->sampled = 0;
+                loopthread->histogram = NULL;
+            }
+            else
+            {
+                loopthread->status = LOOP_STOPPED;
+                loopthread->histogram = NULL;
+            }
+            loopthread->state = LOOP_ADAPT_THREAD_RUN;
+            // No thread starts the new configuration before all applied it
+            _loop_adapt_sync_threads(ldata, loopthread);
+        }
+        // The parameters are applied at the start of the cycle, the
+        // measurement starts after the warm-up iterations
+        if (counter->num_iterations == counter->warmup && loopthread->sampled)
+        {
+            if (loopthread->status == LOOP_STARTED && loopthread->config)
+            {
+                if (loop_adapt_threads_in_parallel() == 0)
+                {
+                    for (i = 0; i < loop_adapt_threads_get_count(); i++)
+                    {
+                        ThreadData_t t = loop_adapt_threads_getthread(i);
+                        loop_adapt_handle_thread_measure(ldata, t);
                     }
                 }
                 else
                 {
-                    ldata->status = LOOP_STOPPED;
+                    loop_adapt_handle_thread_measure(ldata, thread);
                 }
-                loopthread->state = LOOP_ADAPT_THREAD_RUN;
             }
+            // Picked up by the inline fast path of the calling thread
+            counter->histogram = loopthread->histogram;
+        }
+        else if (counter->num_iterations == 0)
+        {
+            // No iteration timing during the warm-up
+            counter->histogram = NULL;
         }
     }
     return 1;
 }
 
-int loop_adapt_end_loop(char* string)
+int loop_adapt_start_loop( char* string, char* file, int linenumber )
+{
+    LoopData_t ldata = NULL;
+    if (loop_adapt_active)
+    {
+        if (_loop_adapt_get_loop(string, &ldata) < 0)
+        {
+            ERROR_PRINT(Loop string %s not registered, string);
+            return 1;
+        }
+        if (ldata)
+        {
+            return loop_adapt_start_loop_handle(ldata->handle, file, linenumber);
+        }
+    }
+    return 1;
+}
+
+int loop_adapt_end_loop_handle(int handle)
 {
-    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO,--- Stopping loop %s, string);
     int i = 0;
-    int j = 0;
-    int err = 0;
-    hwloc_topology_t tree = NULL;
     LoopData_t ldata = NULL;
     ThreadData_t thread = NULL;
     LoopThreadData_t loopthread = NULL;
+    LoopAdaptLoopCounter* counter = NULL;
     if (loop_adapt_active)
     {
-        if (get_smap_by_key(loop_adapt_global_hash, string, (void**)&tree) < 0)
+        ldata = _loop_adapt_get_loop_by_handle(handle);
+        if (!ldata)
         {
-            fprintf(stderr, "ERROR: Loop string %s not registered\n", string);
+            ERROR_PRINT(Loop handle %d not registered, handle);
             return 1;
         }
-        ldata = (LoopData_t)hwloc_topology_get_userdata(tree);
-        if (ldata)
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO,--- Stopping loop %s, bdata(ldata->loopname));
+        // Get the topology data for the current thread
+        thread = loop_adapt_threads_get();
+        if (!thread)
+        {
+            return 1;
+        }
+        counter = _loop_adapt_get_loop_counter(thread, ldata);
+        if (!counter)
         {
-            // Get the topology data for the current thread
-            thread = loop_adapt_threads_get();
-            if (get_imap_by_key(ldata->currentThreadConfig, thread->thread, (void**)&loopthread) == 0)
+            return 1;
+        }
+        loopthread = _loop_adapt_get_loopdata_thread(ldata, thread);
+        if (loopthread && loopthread->tuned)
+        {
+            // Counter of a tuned loop wrapped around
+            _loop_adapt_tuned_counter(counter);
+        }
+        else if (loopthread)
+        {
+            // The iterations are also counted if there is no configuration, so
+            // that a new configuration is checked only once per cycle.
+            if (counter->num_iterations < counter->next_check)
+            {
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Need more iterations for loop '%s', bdata(ldata->loopname));
+                counter->num_iterations++;
+            }
+            else if (counter->num_iterations < counter->max_iterations-1 &&
+                     !_loop_adapt_cycle_done(ldata, loopthread, counter))
+            {
+                // Adaptive cycle not precise enough, check again later
+                int step = (counter->num_iterations + 1 - ldata->warmup) / LOOP_ADAPT_CHECK_DIVISOR;
+                counter->next_check = counter->num_iterations + (step > 1 ? step : 1);
+                if (counter->next_check > counter->max_iterations-1)
+                {
+                    counter->next_check = counter->max_iterations-1;
+                }
+                counter->num_iterations++;
+            }
+            else if (loopthread->sampled)
             {
-                if (ldata->status == LOOP_STARTED)
+                int iterations = counter->num_iterations + 1 - ldata->warmup;
+                int weight = __atomic_load_n(&ldata->sample_interval, __ATOMIC_ACQUIRE);
+                int started = (loopthread->status == LOOP_STARTED);
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Cycle of loop '%s' ends after %d measured iterations, bdata(ldata->loopname), iterations);
+                // The measurements of all threads end at the same iteration
+                _loop_adapt_sync_threads(ldata, loopthread);
+                if (started)
                 {
-                    if (loopthread->num_iterations < ldata->max_iterations-1)
+                    if (loop_adapt_threads_in_parallel() == 0)
                     {
-                        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Need more iterations for loop '%s', string);
-                        loopthread->num_iterations++;
+                        for (i = 0; i < loop_adapt_threads_get_count(); i++)
+                        {
+                            ThreadData_t t = loop_adapt_threads_getthread(i);
+                            loop_adapt_handle_thread_stop(ldata, t, iterations, weight);
+                        }
                     }
                     else
                     {
-                        if (loop_adapt_threads_in_parallel() == 0)
-                        {
-                            for (i = 0; i < loop_adapt_threads_get_count(); i++)
-                            {
-                                ThreadData_t t = loop_adapt_threads_getthread(i);
-                                loop_adapt_handle_thread_stop(ldata, t);
-                            }
-                        }
-                        else
-                        {
-                            loop_adapt_handle_thread_stop(ldata, thread);
-                        }
-                        loopthread->num_iterations = 0;
+                        loop_adapt_handle_thread_stop(ldata, thread, iterations, weight);
                     }
                 }
+                loopthread->skip_cycles = _loop_adapt_sample_gap(ldata, loopthread, counter->max_iterations);
+                counter->next_check = _loop_adapt_first_check(ldata);
+                counter->num_iterations = 0;
+                loopthread->state = LOOP_ADAPT_THREAD_PAUSE;
+            }
+            else
+            {
+                // End of the unmeasured cycles, the next cycle is measured
+                counter->next_check = _loop_adapt_first_check(ldata);
+                counter->num_iterations = 0;
                 loopthread->state = LOOP_ADAPT_THREAD_PAUSE;
-                //loopthread->num_iterations = ldata->max_iterations+1;
             }
         }
     }
     return 1;
 }
 
+int loop_adapt_end_loop(char* string)
+{
+    LoopData_t ldata = NULL;
+    if (loop_adapt_active)
+    {
+        if (_loop_adapt_get_loop(string, &ldata) < 0)
+        {
+            ERROR_PRINT(Loop string %s not registered, string);
+            return 1;
+        }
+        if (ldata)
+        {
+            return loop_adapt_end_loop_handle(ldata->handle);
+        }
+    }
+    return 1;
+}
+
 
 
 
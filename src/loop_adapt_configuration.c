@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <error.h>
+#include <sched.h>
 
 #include <pthread.h>
 
@@ -13,10 +14,28 @@
 /*#include <map.h>*/
 #include <loop_adapt_configuration_types.h>
 #include <loop_adapt_configuration_backends.h>
+#include <loop_adapt_configuration.h>
+#include <loop_adapt_parameter_value.h>
+#include <loop_adapt_parameter.h>
 
 
 static LoopAdaptInputConfigurationFunctions* loop_adapt_configuration_funcs_input = NULL;
 static LoopAdaptOutputConfigurationFunctions* loop_adapt_configuration_funcs_output = NULL;
+/* The configurations belong to the caller, kept after finalize for
+ * loop_adapt_configuration_release */
+static int loop_adapt_configuration_caller_owned = 0;
+
+/* Prefetch service thread. The requests are pushed lock-free onto a stack and
+ * taken all at once by the service thread. The service thread only sleeps on
+ * the condition variable if the stack is empty, the requesting threads signal
+ * only if it sleeps. */
+static pthread_t loop_adapt_prefetch_thread;
+static int loop_adapt_prefetch_running = 0;
+static int loop_adapt_prefetch_stop = 0;
+static int loop_adapt_prefetch_sleeping = 0;
+static LoopAdaptConfigurationPrefetch* loop_adapt_prefetch_queue = NULL;
+static pthread_mutex_t loop_adapt_prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t loop_adapt_prefetch_cond = PTHREAD_COND_INITIALIZER;
 
 /*typedef struct {*/
 /*    int stop;*/
@@ -70,7 +89,7 @@ void loop_adapt_configuration_destroy_config(LoopAdaptConfiguration_t config)
     {
         if (config->parameters)
         {
-            for (i = 0; i < config->num_parameters; i++)
+            for (i = 0; i < config->max_parameters; i++)
             {
                 LoopAdaptConfigurationParameter* p = &config->parameters[i];
                 if (p)
@@ -84,6 +103,7 @@ void loop_adapt_configuration_destroy_config(LoopAdaptConfiguration_t config)
             free(config->parameters);
             config->parameters = NULL;
             config->num_parameters = 0;
+            config->max_parameters = 0;
         }
         memset(config, 0, sizeof(LoopAdaptConfiguration));
         free(config);
@@ -105,15 +125,24 @@ int loop_adapt_configuration_resize_config(LoopAdaptConfiguration_t *configurati
     }
     if (config && num_parameters > 0)
     {
-        if (num_parameters > config->num_parameters)
+        // The entries are only extended, so the strings and value arrays
+        // of the entries are reused for the next configurations
+        if (num_parameters > config->max_parameters)
         {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Increase size of parameters from %d to %d, config->num_parameters, num_parameters);
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Increase size of parameters from %d to %d, config->max_parameters, num_parameters);
             LoopAdaptConfigurationParameter* ptmp = realloc(config->parameters, (num_parameters)*sizeof(LoopAdaptConfigurationParameter));
             if (!ptmp)
             {
                 return -ENOMEM;
             }
+            // New parameters have no values yet
+            memset(&ptmp[config->max_parameters], 0, (num_parameters - config->max_parameters)*sizeof(LoopAdaptConfigurationParameter));
+            for (int i = config->max_parameters; i < num_parameters; i++)
+            {
+                ptmp[i].id = -1;
+            }
             config->parameters = ptmp;
+            config->max_parameters = num_parameters;
         }
         *configuration = config;
         return 0;
@@ -121,6 +150,441 @@ int loop_adapt_configuration_resize_config(LoopAdaptConfiguration_t *configurati
     return -EINVAL;
 }
 
+static void* _loop_adapt_configuration_prefetch_service(void* data)
+{
+    LoopAdaptInputConfigurationFunctions* funcs = (LoopAdaptInputConfigurationFunctions*)data;
+    while (1)
+    {
+        LoopAdaptConfigurationPrefetch* slot = __atomic_exchange_n(&loop_adapt_prefetch_queue, NULL, __ATOMIC_SEQ_CST);
+        if (!slot)
+        {
+            int stop = 0;
+            pthread_mutex_lock(&loop_adapt_prefetch_lock);
+            __atomic_store_n(&loop_adapt_prefetch_sleeping, 1, __ATOMIC_SEQ_CST);
+            while (!loop_adapt_prefetch_stop && !__atomic_load_n(&loop_adapt_prefetch_queue, __ATOMIC_SEQ_CST))
+            {
+                pthread_cond_wait(&loop_adapt_prefetch_cond, &loop_adapt_prefetch_lock);
+            }
+            __atomic_store_n(&loop_adapt_prefetch_sleeping, 0, __ATOMIC_SEQ_CST);
+            stop = loop_adapt_prefetch_stop;
+            pthread_mutex_unlock(&loop_adapt_prefetch_lock);
+            if (stop)
+            {
+                break;
+            }
+            continue;
+        }
+        while (slot)
+        {
+            LoopAdaptConfigurationPrefetch* next = slot->next;
+            int done = 0;
+            while (!done)
+            {
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Prefetch configuration %d for loop %s, slot->config_id, slot->loopname);
+                slot->err = funcs->getnew(slot->loopname, slot->config_id, &slot->config);
+                // A request which arrived in the meantime replaces the result
+                pthread_mutex_lock(&loop_adapt_prefetch_lock);
+                if (slot->pending)
+                {
+                    slot->config_id = slot->pending_id;
+                    slot->pending = 0;
+                }
+                else
+                {
+                    // The slot belongs to the requesting thread again
+                    __atomic_store_n(&slot->state, LOOP_ADAPT_PREFETCH_READY, __ATOMIC_RELEASE);
+                    done = 1;
+                }
+                pthread_mutex_unlock(&loop_adapt_prefetch_lock);
+            }
+            slot = next;
+        }
+    }
+    return NULL;
+}
+
+static int _loop_adapt_configuration_prefetch_start(LoopAdaptInputConfigurationFunctions* funcs)
+{
+    char* env = getenv("LA_CONFIG_PREFETCH");
+    if (!env || atoi(env) == 0)
+    {
+        return 0;
+    }
+    if (!funcs->async)
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Input backend does not support prefetching);
+        return 0;
+    }
+    loop_adapt_prefetch_stop = 0;
+    loop_adapt_prefetch_sleeping = 0;
+    loop_adapt_prefetch_queue = NULL;
+    int err = pthread_create(&loop_adapt_prefetch_thread, NULL, _loop_adapt_configuration_prefetch_service, funcs);
+    if (err != 0)
+    {
+        ERROR_PRINT(Cannot start configuration prefetch thread);
+        return -err;
+    }
+    __atomic_store_n(&loop_adapt_prefetch_running, 1, __ATOMIC_RELEASE);
+    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Started configuration prefetch thread);
+    return 0;
+}
+
+/* Requests still in the queue are dropped. Their slots stay requested, which
+ * is fine because no result is expected anymore. */
+static void _loop_adapt_configuration_prefetch_stop()
+{
+    if (__atomic_load_n(&loop_adapt_prefetch_running, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&loop_adapt_prefetch_running, 0, __ATOMIC_RELEASE);
+        pthread_mutex_lock(&loop_adapt_prefetch_lock);
+        loop_adapt_prefetch_stop = 1;
+        pthread_cond_signal(&loop_adapt_prefetch_cond);
+        pthread_mutex_unlock(&loop_adapt_prefetch_lock);
+        pthread_join(loop_adapt_prefetch_thread, NULL);
+        loop_adapt_prefetch_queue = NULL;
+    }
+}
+
+/* Allocate the buffers of *config with the layout of another configuration,
+ * so filling it with a similar configuration does not allocate */
+static int _loop_adapt_configuration_reserve(LoopAdaptConfiguration_t *config, LoopAdaptConfiguration_t layout)
+{
+    int i = 0;
+    int err = loop_adapt_configuration_resize_config(config, layout->max_parameters);
+    if (err != 0)
+    {
+        return err;
+    }
+    for (i = 0; i < layout->max_parameters; i++)
+    {
+        LoopAdaptConfigurationParameter* p = &(*config)->parameters[i];
+        LoopAdaptConfigurationParameter* l = &layout->parameters[i];
+        if (!p->parameter && l->parameter)
+        {
+            p->parameter = bstrcpy(l->parameter);
+            if (!p->parameter)
+            {
+                return -ENOMEM;
+            }
+        }
+        if (!p->values && l->num_values > 0)
+        {
+            p->values = malloc(l->num_values * sizeof(ParameterValue));
+            if (!p->values)
+            {
+                return -ENOMEM;
+            }
+            memset(p->values, 0, l->num_values * sizeof(ParameterValue));
+            for (int j = 0; j < l->num_values; j++)
+            {
+                p->values[j].type = LOOP_ADAPT_PARAMETER_TYPE_INVALID;
+            }
+            p->num_values = l->num_values;
+        }
+    }
+    return 0;
+}
+
+int loop_adapt_configuration_prefetch(LoopAdaptConfigurationPrefetch* slot, char* string, int config_id, LoopAdaptConfiguration_t layout)
+{
+    if ((!slot) || (!string))
+    {
+        return -EINVAL;
+    }
+    if (!__atomic_load_n(&loop_adapt_prefetch_running, __ATOMIC_ACQUIRE))
+    {
+        return -ENOTSUP;
+    }
+    if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == LOOP_ADAPT_PREFETCH_REQUESTED)
+    {
+        // The service thread fetches the newest request after the one in
+        // work. The state is checked again because it may have finished.
+        int queued = 0;
+        pthread_mutex_lock(&loop_adapt_prefetch_lock);
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == LOOP_ADAPT_PREFETCH_REQUESTED)
+        {
+            slot->pending_id = config_id;
+            slot->pending = 1;
+            queued = 1;
+        }
+        pthread_mutex_unlock(&loop_adapt_prefetch_lock);
+        if (queued)
+        {
+            return 0;
+        }
+    }
+    // The requesting thread allocates the buffer of the slot once, so the
+    // service thread does not allocate in later cycles
+    if (!slot->config && layout && layout->max_parameters > 0)
+    {
+        int err = _loop_adapt_configuration_reserve(&slot->config, layout);
+        if (err != 0)
+        {
+            return err;
+        }
+    }
+    // An unused result of an older request is dropped
+    slot->config_id = config_id;
+    slot->loopname = string;
+    slot->err = 0;
+    slot->pending = 0;
+    __atomic_store_n(&slot->state, LOOP_ADAPT_PREFETCH_REQUESTED, __ATOMIC_RELAXED);
+    LoopAdaptConfigurationPrefetch* head = __atomic_load_n(&loop_adapt_prefetch_queue, __ATOMIC_RELAXED);
+    do
+    {
+        slot->next = head;
+    } while (!__atomic_compare_exchange_n(&loop_adapt_prefetch_queue, &head, slot, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    if (__atomic_load_n(&loop_adapt_prefetch_sleeping, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&loop_adapt_prefetch_lock);
+        pthread_cond_signal(&loop_adapt_prefetch_cond);
+        pthread_mutex_unlock(&loop_adapt_prefetch_lock);
+    }
+    return 0;
+}
+
+int loop_adapt_configuration_prefetched(LoopAdaptConfigurationPrefetch* slot, int config_id, LoopAdaptConfiguration_t *config)
+{
+    if ((!slot) || (!config))
+    {
+        return -EINVAL;
+    }
+    if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != LOOP_ADAPT_PREFETCH_READY)
+    {
+        return -EAGAIN;
+    }
+    __atomic_store_n(&slot->state, LOOP_ADAPT_PREFETCH_IDLE, __ATOMIC_RELAXED);
+    if (slot->config_id != config_id)
+    {
+        return -EAGAIN;
+    }
+    if (slot->err == 0)
+    {
+        LoopAdaptConfiguration_t tmp = *config;
+        *config = slot->config;
+        slot->config = tmp;
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Use prefetched configuration %d for loop %s, config_id, slot->loopname);
+    }
+    return slot->err;
+}
+
+void loop_adapt_configuration_shared_init(LoopAdaptSharedConfiguration* share)
+{
+    memset(share, 0, sizeof(LoopAdaptSharedConfiguration));
+    pthread_mutex_init(&share->lock, NULL);
+}
+
+void loop_adapt_configuration_shared_destroy(LoopAdaptSharedConfiguration* share)
+{
+    // The service thread may still fill the buffer of the slot
+    while (__atomic_load_n(&loop_adapt_prefetch_running, __ATOMIC_ACQUIRE) &&
+           __atomic_load_n(&share->prefetch.state, __ATOMIC_ACQUIRE) == LOOP_ADAPT_PREFETCH_REQUESTED)
+    {
+        sched_yield();
+    }
+    loop_adapt_configuration_release(share->published);
+    loop_adapt_configuration_release(share->prefetch.config);
+    while (share->retired)
+    {
+        LoopAdaptConfiguration_t next = share->retired->next;
+        loop_adapt_configuration_release(share->retired);
+        share->retired = next;
+    }
+    pthread_mutex_destroy(&share->lock);
+    memset(share, 0, sizeof(LoopAdaptSharedConfiguration));
+}
+
+/* Take an unused configuration which is not referenced anymore. Must be
+ * called with the lock held. References are only taken without the lock if
+ * the configuration is still referenced, so an unreferenced configuration
+ * stays unreferenced while the lock is held. */
+static LoopAdaptConfiguration_t _loop_adapt_configuration_shared_reuse(LoopAdaptSharedConfiguration* share)
+{
+    LoopAdaptConfiguration_t config = NULL;
+    LoopAdaptConfiguration_t* prev = &share->retired;
+    for (config = share->retired; config; prev = &config->next, config = config->next)
+    {
+        if (__atomic_load_n(&config->refcount, __ATOMIC_ACQUIRE) == 0)
+        {
+            *prev = config->next;
+            config->next = NULL;
+            share->num_retired--;
+            return config;
+        }
+    }
+    return NULL;
+}
+
+/* Add a replaced configuration to the retired ones. Must be called with the
+ * lock held. Unreferenced configurations beyond the first
+ * LOOP_ADAPT_SHARED_CONFIGURATION_RETIRED ones are freed. A thread which read
+ * the published pointer before the configuration was replaced may still
+ * access it, it is counted in readers, so readers is checked before the
+ * references. Otherwise the surplus is freed at the next call. */
+static void _loop_adapt_configuration_shared_retire(LoopAdaptSharedConfiguration* share, LoopAdaptConfiguration_t config)
+{
+    int i = 0;
+    config->next = share->retired;
+    share->retired = config;
+    share->num_retired++;
+    if (share->num_retired <= LOOP_ADAPT_SHARED_CONFIGURATION_RETIRED ||
+        __atomic_load_n(&share->readers, __ATOMIC_SEQ_CST) > 0)
+    {
+        return;
+    }
+    LoopAdaptConfiguration_t* prev = &share->retired;
+    while (*prev)
+    {
+        LoopAdaptConfiguration_t c = *prev;
+        if (i >= LOOP_ADAPT_SHARED_CONFIGURATION_RETIRED && __atomic_load_n(&c->refcount, __ATOMIC_ACQUIRE) == 0)
+        {
+            *prev = c->next;
+            share->num_retired--;
+            loop_adapt_configuration_release(c);
+            continue;
+        }
+        prev = &c->next;
+        i++;
+    }
+}
+
+/* Take a reference to config if it is still referenced and belongs to
+ * config_id. A configuration without references may be refilled with
+ * another configuration at any time. */
+static inline int _loop_adapt_configuration_shared_tryget(LoopAdaptConfiguration_t config, int config_id)
+{
+    int refs = __atomic_load_n(&config->refcount, __ATOMIC_RELAXED);
+    do
+    {
+        if (refs == 0)
+        {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&config->refcount, &refs, refs + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    if (config->configuration_id != config_id)
+    {
+        __atomic_sub_fetch(&config->refcount, 1, __ATOMIC_RELEASE);
+        return 0;
+    }
+    return 1;
+}
+
+static inline void _loop_adapt_configuration_shared_put(LoopAdaptConfiguration_t config)
+{
+    if (config)
+    {
+        __atomic_sub_fetch(&config->refcount, 1, __ATOMIC_RELEASE);
+    }
+}
+
+int loop_adapt_configuration_shared_get(LoopAdaptSharedConfiguration* share, char* string, int config_id, LoopAdaptConfiguration_t *config)
+{
+    int i = 0;
+    int err = 0;
+    if ((!share) || (!string) || (!config))
+    {
+        return -EINVAL;
+    }
+    if (!loop_adapt_configuration_caller_owned)
+    {
+        return loop_adapt_get_new_configuration(string, config_id, config);
+    }
+    if (*config && (*config)->configuration_id == config_id)
+    {
+        return 0;
+    }
+    // Fast path: The configuration was already published by another thread
+    __atomic_add_fetch(&share->readers, 1, __ATOMIC_SEQ_CST);
+    LoopAdaptConfiguration_t c = __atomic_load_n(&share->published, __ATOMIC_SEQ_CST);
+    if (c && !_loop_adapt_configuration_shared_tryget(c, config_id))
+    {
+        c = NULL;
+    }
+    __atomic_sub_fetch(&share->readers, 1, __ATOMIC_SEQ_CST);
+
+    if (!c)
+    {
+        pthread_mutex_lock(&share->lock);
+        c = share->published;
+        if (!c || c->configuration_id != config_id)
+        {
+            // Threads lagging behind find their configuration in the
+            // replaced ones, they are only reused with the lock held
+            for (c = share->retired; c && c->configuration_id != config_id; c = c->next);
+        }
+        if (c)
+        {
+            __atomic_add_fetch(&c->refcount, 1, __ATOMIC_ACQUIRE);
+        }
+        else
+        {
+            c = _loop_adapt_configuration_shared_reuse(share);
+            err = loop_adapt_configuration_prefetched(&share->prefetch, config_id, &c);
+            if (err == -EAGAIN)
+            {
+                err = loop_adapt_get_new_configuration(string, config_id, &c);
+            }
+            if (err == 0 && c)
+            {
+                // The parameter IDs are resolved before the configuration
+                // becomes visible, afterwards it is only read
+                for (i = 0; i < c->num_parameters; i++)
+                {
+                    LoopAdaptConfigurationParameter* cp = &c->parameters[i];
+                    if (cp->id < 0)
+                    {
+                        cp->id = loop_adapt_parameter_id(bdata(cp->parameter));
+                    }
+                }
+                // References of the loop and the calling thread
+                c->next = NULL;
+                __atomic_store_n(&c->refcount, 2, __ATOMIC_RELEASE);
+                LoopAdaptConfiguration_t old = share->published;
+                __atomic_store_n(&share->published, c, __ATOMIC_SEQ_CST);
+                if (old)
+                {
+                    _loop_adapt_configuration_shared_put(old);
+                    _loop_adapt_configuration_shared_retire(share, old);
+                }
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Published configuration %d for loop %s, config_id, string);
+                // The next configuration is prepared while this one is used.
+                // Without prefetch the next thread fetches it itself.
+                if (loop_adapt_configuration_prefetch(&share->prefetch, string, config_id + 1, c) == -ENOMEM)
+                {
+                    ERROR_PRINT(Cannot allocate prefetch buffer for loop %s, string);
+                }
+            }
+            else
+            {
+                // Keep the buffer for the next try, the content may be
+                // incomplete
+                if (c)
+                {
+                    c->configuration_id = -1;
+                    __atomic_store_n(&c->refcount, 0, __ATOMIC_RELEASE);
+                    _loop_adapt_configuration_shared_retire(share, c);
+                }
+                c = NULL;
+            }
+        }
+        pthread_mutex_unlock(&share->lock);
+    }
+    if (c)
+    {
+        _loop_adapt_configuration_shared_put(*config);
+        *config = c;
+    }
+    return err;
+}
+
+void loop_adapt_configuration_release(LoopAdaptConfiguration_t config)
+{
+    if (config && loop_adapt_configuration_caller_owned)
+    {
+        loop_adapt_configuration_destroy_config(config);
+    }
+}
+
 int loop_adapt_configuration_initialize()
 {
     int err_input = 0, err_output = 0;
@@ -153,6 +617,11 @@ int loop_adapt_configuration_initialize()
                 ERROR_PRINT(Initialization of input backend failed)
             }
         }
+        loop_adapt_configuration_caller_owned = loop_adapt_configuration_funcs_input->async;
+        if (err_input == 0)
+        {
+            err_input = _loop_adapt_configuration_prefetch_start(loop_adapt_configuration_funcs_input);
+        }
     }
     else
     {
@@ -186,6 +655,8 @@ int loop_adapt_configuration_initialize()
 
 void loop_adapt_configuration_finalize()
 {
+    // The service thread uses the input backend
+    _loop_adapt_configuration_prefetch_stop();
     if (loop_adapt_configuration_funcs_input)
     {
         if (loop_adapt_configuration_funcs_input->finalize)
@@ -268,6 +739,64 @@ int loop_adapt_write_configuration_results(ThreadData_t thread, char* loopname,
 }
 
 
+/* Position and remaining space for formatting at pos. Without buffer, only
+ * the length is calculated */
+#define _LOOP_ADAPT_FORMAT_AT(s, len, pos) (((s) && (pos) < (len)) ? (s) + (pos) : NULL)
+#define _LOOP_ADAPT_FORMAT_LEFT(s, len, pos) (((s) && (pos) < (len)) ? (len) - (pos) : 0)
+
+static size_t _loop_adapt_configuration_format_results(char* s, size_t len, PolicyDefinition_t policy, LoopAdaptConfiguration_t config, int eval, double result)
+{
+    int i = 0, j = 0;
+    size_t pos = 0;
+    char* sep = "";
+    for (i = 0; i < config->num_parameters; i++)
+    {
+        LoopAdaptConfigurationParameter *p = &config->parameters[i];
+        for (j = 0; j < p->num_values; j++)
+        {
+            if (p->values[j].type != LOOP_ADAPT_PARAMETER_TYPE_INVALID)
+            {
+                pos += snprintf(_LOOP_ADAPT_FORMAT_AT(s, len, pos), _LOOP_ADAPT_FORMAT_LEFT(s, len, pos), "%s%s=%d:", sep, bdata(p->parameter), j);
+                pos += loop_adapt_param_value_snprintf(_LOOP_ADAPT_FORMAT_AT(s, len, pos), _LOOP_ADAPT_FORMAT_LEFT(s, len, pos), p->values[j]);
+                sep = ";";
+            }
+        }
+    }
+    if (eval)
+    {
+        if (policy->match)
+            pos += snprintf(_LOOP_ADAPT_FORMAT_AT(s, len, pos), _LOOP_ADAPT_FORMAT_LEFT(s, len, pos), "|%s:%s:%s=%f", bdata(policy->backend), bdata(policy->config), bdata(policy->match), result);
+        else
+            pos += snprintf(_LOOP_ADAPT_FORMAT_AT(s, len, pos), _LOOP_ADAPT_FORMAT_LEFT(s, len, pos), "|%s:%s=%f", bdata(policy->backend), bdata(policy->config), result);
+    }
+    return pos;
+}
+
+char* loop_adapt_configuration_format_results(ThreadData_t thread, PolicyDefinition_t policy, LoopAdaptConfiguration_t config, int num_results, ParameterValue* results)
+{
+    int eval = 0;
+    double r = 0;
+    char* s = NULL;
+    size_t len = 0;
+    if ((!thread) || (!policy) || (!config))
+    {
+        return NULL;
+    }
+    if (policy->eval && results)
+    {
+        policy->eval(num_results, results, &r);
+        eval = 1;
+    }
+    // First pass only calculates the length
+    len = _loop_adapt_configuration_format_results(NULL, 0, policy, config, eval, r) + 1;
+    s = loop_adapt_arena_alloc(&thread->arena, len);
+    if (s)
+    {
+        _loop_adapt_configuration_format_results(s, len, policy, config, eval, r);
+    }
+    return s;
+}
+
 int loop_adapt_config_parse_default_entry(bstring b, bstring* first, bstring* second, bstring* third)
 {
     int i = 0;
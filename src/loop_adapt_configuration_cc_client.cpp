@@ -257,6 +257,7 @@ extern "C" int loop_adapt_get_new_config_cc_client(char* string, int config_id,
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Param value %s, x);
             free(x);
             config->parameters[i].parameter = bstrcpy(param_names->entry[i]);
+            config->parameters[i].id = loop_adapt_parameter_id(bdata(param_names->entry[i]));
             config->parameters[i].type = type;
             config->parameters[i].num_values = loop_adapt_threads_get_count();
             config->parameters[i].values = (ParameterValue*)malloc(loop_adapt_threads_get_count()*sizeof(ParameterValue));
@@ -84,53 +84,17 @@ int loop_adapt_config_stdout_output_raw(char* loopname, char* rawstring)
 
 int loop_adapt_config_stdout_write(ThreadData_t thread, char* loopname, PolicyDefinition_t policy, LoopAdaptConfiguration_t config, int num_results, ParameterValue* results)
 {
-    int i = 0, j = 0;
     if (config && num_results > 0 && results)
     {
-        bstring line = bfromcstr("");
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Writing %d parameters and %d measurements, config->num_parameters, 1);
-        for (i = 0; i < config->num_parameters; i++)
+        char* line = loop_adapt_configuration_format_results(thread, policy, config, num_results, results);
+        if (!line)
         {
-            LoopAdaptConfigurationParameter *p = &config->parameters[i];
-            if (p)
-            {
-                for (j = 0; j < p->num_values; j++)
-                {
-                    if (p->values[j].type != LOOP_ADAPT_PARAMETER_TYPE_INVALID)
-                    {
-                        char* c = loop_adapt_param_value_str(p->values[j]);
-                        bstring x = loop_adapt_config_parse_default_entry_bdc(p->parameter, j, c);
-                        free(c);
-                        bconcat(line, x);
-                        bconchar(line, ';');
-                        bdestroy(x);
-                    }
-                }
-            }
-        }
-        btrunc(line, blength(line) - 1);
-        bconchar(line, '|');
-        if (policy->eval)
-        {
-            double r = 0;
-            policy->eval(num_results, results, &r);
-            bstring x;
-            if (policy->match)
-                x = bformat("%s:%s:%s=%f", bdata(policy->backend), bdata(policy->config), bdata(policy->match), r);
-            else
-                x = bformat("%s:%s=%f", bdata(policy->backend), bdata(policy->config), r);
-            bconcat(line, x);
-            bdestroy(x);
+            return -ENOMEM;
         }
-
-
-        btrunc(line, blength(line) - 1);
-        fprintf(loop_adapt_config_stdout_fd, "LOOP=%s;THREAD=%d:%d|%s\n", loopname, thread->thread, thread->cpu, bdata(line));
+        fprintf(loop_adapt_config_stdout_fd, "LOOP=%s;THREAD=%d:%d|%s\n", loopname, thread->thread, thread->cpu, line);
         fflush(loop_adapt_config_stdout_fd);
-        bdestroy(line);
-    }
-    else
-    {
-        printf("Maaeeeee\n");
+        return 0;
     }
+    return -EINVAL;
 }
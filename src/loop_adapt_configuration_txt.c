@@ -32,6 +32,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <error.h>
+#include <pthread.h>
 
 #include <loop_adapt_configuration_types.h>
 #include <loop_adapt_parameter_value.h>
@@ -49,13 +50,15 @@
 
 typedef struct {
     bstring filename;
-    int line_idx;
     struct bstrList* lines;
-    LoopAdaptConfiguration_t current;
 } ConfigurationFile;
 static Map_t loop_adapt_config_txt_input_hash = NULL;
+static pthread_mutex_t loop_adapt_config_txt_input_lock = PTHREAD_MUTEX_INITIALIZER;
 static char* dirname = NULL;
 
+/* Maximal length of numeric values in the configuration files */
+#define LOOP_ADAPT_CONFIG_TXT_MAX_VALUE 128
+
 
 
 static Map_t loop_adapt_config_txt_output_hash = NULL;
@@ -66,11 +69,6 @@ void _loop_adapt_free_config_txt_input(gpointer val)
     ConfigurationFile* cfile = (ConfigurationFile*) val;
     if (cfile)
     {
-        if (cfile->current)
-        {
-            loop_adapt_configuration_destroy_config(cfile->current);
-            cfile->current = NULL;
-        }
         if (cfile->lines)
         {
             bstrListDestroy(cfile->lines);
@@ -143,7 +141,6 @@ static int _loop_adapt_get_new_config_txt_resize_values(LoopAdaptConfigurationPa
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Allocating space for %d parameter values of parameter %s, num_values, bdata(parameter->parameter));
             if (parameter->values != NULL)
             {
-                printf("%p %d\n", parameter->values, num_values);
                 ParameterValue* vtmp = realloc(parameter->values, num_values * sizeof(ParameterValue));
                 if (!vtmp)
                 {
@@ -171,74 +168,75 @@ static int _loop_adapt_get_new_config_txt_resize_values(LoopAdaptConfigurationPa
     return -EINVAL;
 }
 
-static int  _loop_adapt_get_new_config_txt_read_file(char* filename)
+/* Read the configuration file of a loop. The file is read only once, if it
+ * does not exist or contains no configurations, the empty entry is kept so
+ * that the file is not checked again in each cycle */
+static int _loop_adapt_get_new_config_txt_read_file(char* loopname, char* filename)
 {
-    int err = 0;
     int i = 0;
     ConfigurationFile* config = NULL;
 
-
-    bstring content = read_file(filename);
-    struct bstrList* lines = bsplit(content, '\n');
-    bdestroy(content);
-    if (lines->qty == 0)
-    {
-        return -ENOMSG;
-    }
-
     config = malloc(sizeof(ConfigurationFile));
     if (!config)
     {
-        bstrListDestroy(lines);
+        return -ENOMEM;
     }
     config->lines = bstrListCreate();
+    config->filename = bfromcstr(filename);
 
-    for (i = 0; i < lines->qty; i++)
+    bstring content = read_file(filename);
+    struct bstrList* lines = bsplit(content, '\n');
+    bdestroy(content);
+    if (lines)
     {
-        btrimws(lines->entry[i]);
-        if (blength(lines->entry[i]) == 0 || bchar(lines->entry[i], 0) == '#')
+        for (i = 0; i < lines->qty; i++)
         {
-            continue;
+            btrimws(lines->entry[i]);
+            if (blength(lines->entry[i]) == 0 || bchar(lines->entry[i], 0) == '#')
+            {
+                continue;
+            }
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, TXT: %s, bdata(lines->entry[i]));
+            bstrListAdd(config->lines, lines->entry[i]);
         }
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, TXT: %s, bdata(lines->entry[i]));
-        bstrListAdd(config->lines, lines->entry[i]);
+        bstrListDestroy(lines);
     }
-    bstrListDestroy(lines);
 
-    if (config->lines->qty == 0)
+    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Add file %s for loop %s, filename, loopname);
+    add_smap(loop_adapt_config_txt_input_hash, loopname, config);
+    return (config->lines->qty > 0 ? 0 : -ENOMSG);
+}
+
+/* Parse a single value. Numeric values are copied to the stack for parsing,
+ * only string values allocate */
+static int _loop_adapt_get_new_config_txt_parse_value(bstring value, ParameterValueType_t type, ParameterValue* pv)
+{
+    int err = 0;
+    char buf[LOOP_ADAPT_CONFIG_TXT_MAX_VALUE];
+    if (type != LOOP_ADAPT_PARAMETER_TYPE_STR && blength(value) < LOOP_ADAPT_CONFIG_TXT_MAX_VALUE)
     {
-        free(config);
-        bstrListDestroy(config->lines);
-        return -ENOMSG;
+        memcpy(buf, bdata(value), blength(value));
+        buf[blength(value)] = '\0';
+        return loop_adapt_parse_param_value(buf, type, pv);
     }
-
-    config->line_idx = 0;
-    config->filename = bfromcstr(filename);
-    config->current = NULL;
-
-
-
-    bstring t = bfromcstr(basename(filename));
-    bstring loop = bmidstr(t, 0, blength(t)-4);
-    bdestroy(t);
-
-    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Add file %s for loop %s, filename, bdata(loop));
-    add_smap(loop_adapt_config_txt_input_hash, bdata(loop), config);
-
-    bdestroy(loop);
-
-
-
-    return 0;
+    char* c = bstr2cstr(value, '\0');
+    if (!c)
+    {
+        return -ENOMEM;
+    }
+    err = loop_adapt_parse_param_value(c, type, pv);
+    bcstrfree(c);
+    return err;
 }
 
+/* The configuration belongs to the caller. The lines are read only, so the
+ * function can also be called by the prefetch service thread. */
 int loop_adapt_get_new_config_txt(char* string, int config_id, LoopAdaptConfiguration_t* configuration)
 {
     int i = 0;
-    int j = 0;
     int err = 0;
     ConfigurationFile* cfile = 0;
-    if ((!string) || (!loop_adapt_config_txt_input_hash))
+    if ((!string) || (!configuration) || (!loop_adapt_config_txt_input_hash))
     {
         return -EINVAL;
     }
@@ -246,103 +244,122 @@ int loop_adapt_get_new_config_txt(char* string, int config_id, LoopAdaptConfigur
     err = get_smap_by_key(loop_adapt_config_txt_input_hash, string, (void*)&cfile);
     if (err != 0 && dirname)
     {
-        bstring filename = bformat("%s/%s.txt", dirname, string);
-        _loop_adapt_get_new_config_txt_read_file(bdata(filename));
-        bdestroy(filename);
+        pthread_mutex_lock(&loop_adapt_config_txt_input_lock);
         err = get_smap_by_key(loop_adapt_config_txt_input_hash, string, (void*)&cfile);
+        if (err != 0)
+        {
+            bstring filename = bformat("%s/%s.txt", dirname, string);
+            _loop_adapt_get_new_config_txt_read_file(string, bdata(filename));
+            bdestroy(filename);
+            err = get_smap_by_key(loop_adapt_config_txt_input_hash, string, (void*)&cfile);
+        }
+        pthread_mutex_unlock(&loop_adapt_config_txt_input_lock);
     }
-    if (err == 0)
+    if (err == 0 && cfile->lines->qty > 0)
     {
-        if (config_id == cfile->lines->qty)
+        if (config_id >= cfile->lines->qty)
         {
             return -EFAULT;
         }
+        // Already parsed for this cycle
+        if (*configuration && (*configuration)->configuration_id == config_id)
+        {
+            return 0;
+        }
 
+        // The line is parsed in place. The parameter names and values are
+        // copied into the buffers of the configuration, which are only
+        // extended if needed.
+        bstring line = cfile->lines->entry[config_id];
+        int end = bstrchr(line, '|');
+        if (end == BSTR_ERR)
+        {
+            end = blength(line);
+        }
         int pcount = 0;
-        int mcount = 0;
-        struct bstrList* first = bsplit(cfile->lines->entry[config_id], '|');
-        struct bstrList* params = bsplit(first->entry[0], ';');
-        bstrListDestroy(first);
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Line %d has %d parameters, config_id, params->qty);
-
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Resize configuration for %d parameters, params->qty);
-        err = loop_adapt_configuration_resize_config(configuration, params->qty);
-        LoopAdaptConfiguration_t config = *configuration;
+        int num_entries = 1;
+        for (i = 0; i < end; i++)
+        {
+            if (bchar(line, i) == ';')
+            {
+                num_entries++;
+            }
+        }
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Line %d has %d parameters, config_id, num_entries);
+
+        err = loop_adapt_configuration_resize_config(configuration, num_entries);
         if (err != 0)
         {
-            bstrListDestroy(params);
             return -ENOMEM;
         }
+        LoopAdaptConfiguration_t config = *configuration;
 
-        for (i = 0; i < params->qty; i++)
+        int start = 0;
+        while (start < end)
         {
-            bstring f, s, t;
-            loop_adapt_config_parse_default_entry(params->entry[i], &f, &s, &t);
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, '%s' '%s' '%s', bdata(f), bdata(s), bdata(t));
-            //struct bstrList* plist = bsplit(params->entry[i], '=');
-            ParameterValueType_t type = loop_adapt_parameter_type(bdata(f));
-            int scope_count = loop_adapt_parameter_scope_count(bdata(f));
+            int stop = bstrchrp(line, ';', start);
+            if (stop == BSTR_ERR || stop > end)
+            {
+                stop = end;
+            }
+            // Entry format: <param>=<id or ALL>:<value>
+            int eq = bstrchrp(line, '=', start);
+            int col = (eq != BSTR_ERR && eq < stop ? bstrchrp(line, ':', eq) : BSTR_ERR);
+            if (eq == BSTR_ERR || eq >= stop || col == BSTR_ERR || col >= stop)
+            {
+                ERROR_PRINT(Invalid entry in configuration %d for loop %s, config_id, string);
+                start = stop + 1;
+                continue;
+            }
+            LoopAdaptConfigurationParameter* p = &config->parameters[pcount];
+            struct tagbstring f, s, t;
+            bmid2tbstr(f, line, start, eq - start);
+            bmid2tbstr(s, line, eq + 1, col - eq - 1);
+            bmid2tbstr(t, line, col + 1, stop - col - 1);
+            start = stop + 1;
+            if (p->parameter)
+            {
+                bassign(p->parameter, &f);
+            }
+            else
+            {
+                p->parameter = bstrcpy(&f);
+            }
+            int id = loop_adapt_parameter_id(bdata(p->parameter));
+            ParameterValueType_t type = loop_adapt_parameter_type_id(id);
+            int scope_count = loop_adapt_parameter_scope_count_id(id);
             if (type != LOOP_ADAPT_PARAMETER_TYPE_INVALID)
             {
-                LoopAdaptConfigurationParameter* p = &config->parameters[pcount];
-                p->parameter = bstrcpy(f);
+                p->id = id;
                 err = _loop_adapt_get_new_config_txt_resize_values(p, scope_count);
-
-/*                if (p->num_values == 0 || (!p->values))*/
-/*                {*/
-/*                    p->num_values = scope_count;*/
-/*                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Allocating space for %d parameter values of parameter %s, p->num_values, bdata(p->parameter));*/
-/*                    p->values = malloc(p->num_values * sizeof(ParameterValue));*/
-/*                    for (j = 0; j < p->num_values; j++)*/
-/*                    {*/
-/*                        p->values[j].type = LOOP_ADAPT_PARAMETER_TYPE_INVALID;*/
-/*                        p->values[j].value.sval = NULL;*/
-/*                    }*/
-/*                }*/
                 if (err == 0)
                 {
-                    if (strncmp(bdata(s), "ALL", 3) == 0)
+                    if (biseqcstr(&s, "ALL"))
                     {
                         int id = 0;
                         for (id = 0; id < p->num_values; id++)
                         {
-                            ParameterValue* pv = &p->values[id];
-                            loop_adapt_parse_param_value(bdata(t), type, pv);
+                            _loop_adapt_get_new_config_txt_parse_value(&t, type, &p->values[id]);
                         }
                     }
                     else
                     {
-                        int id = batoi(s);
+                        int id = batoi(&s);
                         if (id < 0 || id >= p->num_values)
                         {
-                            ERROR_PRINT(Faulty ID %d for parameter %s, id, bdata(f));
+                            ERROR_PRINT(Faulty ID %d for parameter %s, id, bdata(p->parameter));
                             continue;
                         }
-                        ParameterValue* pv = &p->values[id];
-                        loop_adapt_parse_param_value(bdata(t), type, pv);
+                        _loop_adapt_get_new_config_txt_parse_value(&t, type, &p->values[id]);
                     }
                     p->type = type;
                     pcount++;
                 }
-
             }
-            bdestroy(t);
-            bdestroy(s);
-            bdestroy(f);
-            //bstrListDestroy(plist);
         }
         config->num_parameters = pcount;
-        bstrListDestroy(params);
         config->configuration_id = config_id;
 
-/*        if (cfile->current)*/
-/*        {*/
-/*            loop_adapt_configuration_destroy_config(cfile->current);*/
-/*            cfile->current = NULL;*/
-/*        }*/
-        cfile->current = config;
-        cfile->line_idx++;
-        *configuration = config;
         return 0;
     }
     return -ENODEV;
@@ -420,7 +437,6 @@ int loop_adapt_config_txt_output_raw(char* loopname, char* rawstring)
 
 int loop_adapt_config_txt_output_write(ThreadData_t thread, char* loopname, PolicyDefinition_t policy, LoopAdaptConfiguration_t config, int num_results, ParameterValue* results)
 {
-    int i = 0, j = 0;
     int err = 0;
     if (outputdir && config && results)
     {
@@ -430,54 +446,26 @@ int loop_adapt_config_txt_output_write(ThreadData_t thread, char* loopname, Poli
         {
             bstring fname = bformat("%s/%s.txt", outputdir, loopname);
             outputfile = fopen(bdata(fname), "w");
-            if (outputfile)
+            bdestroy(fname);
+            if (!outputfile)
             {
-                add_smap(loop_adapt_config_txt_output_hash, loopname, (void*)outputfile);
+                return -errno;
             }
+            add_smap(loop_adapt_config_txt_output_hash, loopname, (void*)outputfile);
         }
 
-        bstring line = bformat("THREAD=%d:%d|", thread->thread, thread->cpu);
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Writing %d parameters, config->num_parameters);
-        for (i = 0; i < config->num_parameters; i++)
+        char* line = loop_adapt_configuration_format_results(thread, policy, config, num_results, results);
+        if (!line)
         {
-            LoopAdaptConfigurationParameter *p = &config->parameters[i];
-            if (p)
-            {
-                for (j = 0; j < p->num_values; j++)
-                {
-                    if (p->values[j].type != LOOP_ADAPT_PARAMETER_TYPE_INVALID)
-                    {
-                        char* c = loop_adapt_param_value_str(p->values[j]);
-                        bstring x = loop_adapt_config_parse_default_entry_bdc(p->parameter, j, c);
-                        free(c);
-                        bconcat(line, x);
-                        bconchar(line, ';');
-                        bdestroy(x);
-                    }
-                }
-            }
-        }
-        btrunc(line, blength(line) - 1);
-        bconchar(line, '|');
-
-        if (policy->eval)
-        {
-            double r = 0;
-            policy->eval(num_results, results, &r);
-            bstring x;
-            if (policy->match)
-                x = bformat("%s:%s:%s=%f", bdata(policy->backend), bdata(policy->config), bdata(policy->match), r);
-            else
-                x = bformat("%s:%s=%f", bdata(policy->backend), bdata(policy->config), r);
-            bconcat(line, x);
-            bdestroy(x);
+            return -ENOMEM;
         }
 
         TODO_PRINT(Change txt write function to policy);
 
-
-        fwrite(bdata(line), sizeof(char), blength(line), outputfile);
+        fprintf(outputfile, "THREAD=%d:%d|%s\n", thread->thread, thread->cpu, line);
         fflush(outputfile);
-        bdestroy(line);
+        return 0;
     }
+    return -EINVAL;
 }
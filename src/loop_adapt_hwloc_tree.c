@@ -28,45 +28,504 @@
  * =======================================================================================
  */
 
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <error.h>
+#include <limits.h>
+#include <unistd.h>
 
 #include <hwloc.h>
+#include <bstrlib.h>
+#include <loop_adapt_scopes.h>
+#include <loop_adapt_hwloc_tree.h>
 
 static hwloc_topology_t _loop_adapt_hwloc_tree = NULL;
+/*! \brief  Filename of the topology XML cache set by the API. Overrides LA_TOPOLOGY_XML */
+static char* _loop_adapt_hwloc_xml_file = NULL;
+/*! \brief  hwloc synthetic description set by the API. Overrides LA_TOPOLOGY_SYNTHETIC */
+static char* _loop_adapt_hwloc_synthetic = NULL;
+/*! \brief  Whether the loaded topology is synthetic */
+static int _loop_adapt_hwloc_is_synthetic = 0;
+/*! \brief  Info attribute of the root object recording whether the cache contains I/O devices */
+#define LOOP_ADAPT_HWLOC_XML_IO_INFO "LoopAdaptIODevices"
 
-int loop_adapt_copy_hwloc_tree(hwloc_topology_t* copy)
+/*! \brief  Lookup table OS CPU index -> logical index of the PU (-1 if the
+ *  CPU is not in the topology) */
+static int* _loop_adapt_hwloc_cpu_to_pu = NULL;
+static int _loop_adapt_hwloc_num_cpus = 0;
+/*! \brief  Lookup table PU logical index -> logical index of the object
+ *  containing the PU for each scope. The entries for PU i start at
+ *  i * LOOP_ADAPT_NUM_SCOPES and are -1 if there is no object for a scope */
+static int* _loop_adapt_hwloc_pu_scopes = NULL;
+static int _loop_adapt_hwloc_num_pus = 0;
+
+static void _loop_adapt_hwloc_tree_free_tables()
+{
+    free(_loop_adapt_hwloc_cpu_to_pu);
+    _loop_adapt_hwloc_cpu_to_pu = NULL;
+    _loop_adapt_hwloc_num_cpus = 0;
+    free(_loop_adapt_hwloc_pu_scopes);
+    _loop_adapt_hwloc_pu_scopes = NULL;
+    _loop_adapt_hwloc_num_pus = 0;
+}
+
+/* Build the lookup tables once after loading the topology. Each object of a
+ * scope is visited once and marks the PUs in its cpuset, so building is linear
+ * in the number of PUs times the number of scopes */
+static int _loop_adapt_hwloc_tree_build_tables(hwloc_topology_t tree)
+{
+    int i = 0, j = 0, s = 0;
+    int num_pus = hwloc_get_nbobjs_by_type(tree, HWLOC_OBJ_PU);
+    int max_cpu = -1;
+    for (i = 0; i < num_pus; i++)
+    {
+        hwloc_obj_t obj = hwloc_get_obj_by_type(tree, HWLOC_OBJ_PU, i);
+        if ((int)obj->os_index > max_cpu)
+        {
+            max_cpu = obj->os_index;
+        }
+    }
+    _loop_adapt_hwloc_cpu_to_pu = malloc((max_cpu + 1) * sizeof(int));
+    _loop_adapt_hwloc_pu_scopes = malloc(num_pus * LOOP_ADAPT_NUM_SCOPES * sizeof(int));
+    if (!_loop_adapt_hwloc_cpu_to_pu || !_loop_adapt_hwloc_pu_scopes)
+    {
+        ERROR_PRINT(Cannot allocate topology lookup tables for %d PUs, num_pus);
+        _loop_adapt_hwloc_tree_free_tables();
+        return -ENOMEM;
+    }
+    _loop_adapt_hwloc_num_cpus = max_cpu + 1;
+    _loop_adapt_hwloc_num_pus = num_pus;
+    for (i = 0; i < _loop_adapt_hwloc_num_cpus; i++)
+    {
+        _loop_adapt_hwloc_cpu_to_pu[i] = -1;
+    }
+    for (i = 0; i < num_pus * LOOP_ADAPT_NUM_SCOPES; i++)
+    {
+        _loop_adapt_hwloc_pu_scopes[i] = -1;
+    }
+    for (i = 0; i < num_pus; i++)
+    {
+        hwloc_obj_t obj = hwloc_get_obj_by_type(tree, HWLOC_OBJ_PU, i);
+        _loop_adapt_hwloc_cpu_to_pu[obj->os_index] = obj->logical_index;
+        _loop_adapt_hwloc_pu_scopes[obj->logical_index * LOOP_ADAPT_NUM_SCOPES + LOOP_ADAPT_SCOPE_THREAD_OFFSET] = obj->logical_index;
+    }
+    for (s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
+    {
+        if (s == LOOP_ADAPT_SCOPE_THREAD_OFFSET)
+        {
+            continue;
+        }
+        int count = hwloc_get_nbobjs_by_type(tree, LoopAdaptScopeList[s]);
+        for (j = 0; j < count; j++)
+        {
+            hwloc_obj_t obj = hwloc_get_obj_by_type(tree, LoopAdaptScopeList[s], j);
+            unsigned cpu = 0;
+            if (!obj->cpuset)
+            {
+                continue;
+            }
+            hwloc_bitmap_foreach_begin(cpu, obj->cpuset)
+            {
+                if (cpu < (unsigned)_loop_adapt_hwloc_num_cpus && _loop_adapt_hwloc_cpu_to_pu[cpu] >= 0)
+                {
+                    int* entry = &_loop_adapt_hwloc_pu_scopes[_loop_adapt_hwloc_cpu_to_pu[cpu] * LOOP_ADAPT_NUM_SCOPES + s];
+                    // Like a search in the object list, the first object
+                    // containing the PU is used
+                    if (*entry < 0)
+                    {
+                        *entry = obj->logical_index;
+                    }
+                }
+            }
+            hwloc_bitmap_foreach_end();
+        }
+    }
+    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Topology lookup tables for %d PUs (max CPU %d), num_pus, max_cpu);
+    return 0;
+}
+
+int loop_adapt_hwloc_tree_set_xml(char* filename)
+{
+    if (_loop_adapt_hwloc_tree)
+    {
+        ERROR_PRINT(Topology already loaded. The XML cache must be set before LA_INIT);
+        return -EBUSY;
+    }
+    free(_loop_adapt_hwloc_xml_file);
+    _loop_adapt_hwloc_xml_file = NULL;
+    if (filename && strlen(filename) > 0)
+    {
+        _loop_adapt_hwloc_xml_file = strdup(filename);
+        if (!_loop_adapt_hwloc_xml_file)
+        {
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+int loop_adapt_hwloc_tree_set_synthetic(char* description)
+{
+    if (_loop_adapt_hwloc_tree)
+    {
+        ERROR_PRINT(Topology already loaded. The synthetic topology must be set before LA_INIT);
+        return -EBUSY;
+    }
+    free(_loop_adapt_hwloc_synthetic);
+    _loop_adapt_hwloc_synthetic = NULL;
+    if (description && strlen(description) > 0)
+    {
+        _loop_adapt_hwloc_synthetic = strdup(description);
+        if (!_loop_adapt_hwloc_synthetic)
+        {
+            return -ENOMEM;
+        }
+    }
+    return 0;
+}
+
+int loop_adapt_hwloc_tree_is_synthetic()
+{
+    return (_loop_adapt_hwloc_tree && _loop_adapt_hwloc_is_synthetic);
+}
+
+/* Discover only the parts of the topology loop_adapt uses. I/O devices are
+ * only required for the GPU scope, instruction caches and Misc objects are
+ * never used */
+static int _loop_adapt_hwloc_tree_with_io()
+{
+#ifdef LIKWID_NVMON
+    return 1;
+#else
+    char* env = getenv("LA_TOPOLOGY_GPU");
+    return (env && atoi(env) != 0);
+#endif
+}
+
+static void _loop_adapt_hwloc_tree_set_filters(hwloc_topology_t tree, int with_io)
+{
+    hwloc_topology_set_icache_types_filter(tree, HWLOC_TYPE_FILTER_KEEP_NONE);
+    hwloc_topology_set_type_filter(tree, HWLOC_OBJ_MISC, HWLOC_TYPE_FILTER_KEEP_NONE);
+    hwloc_topology_set_io_types_filter(tree, (with_io ? HWLOC_TYPE_FILTER_KEEP_IMPORTANT : HWLOC_TYPE_FILTER_KEEP_NONE));
+}
+
+static int _loop_adapt_hwloc_tree_hostname(char* hostname)
+{
+    if (gethostname(hostname, HOST_NAME_MAX) != 0)
+    {
+        return -errno;
+    }
+    hostname[HOST_NAME_MAX] = '\0';
+    return 0;
+}
+
+/* The file might be on a shared filesystem, so each host uses its own cache.
+ * A %h in the filename is replaced by the hostname, otherwise the hostname is
+ * appended to the filename */
+static bstring _loop_adapt_hwloc_tree_xml_name(char* filename)
+{
+    char hostname[HOST_NAME_MAX+1];
+    bstring name = NULL;
+    if (_loop_adapt_hwloc_tree_hostname(hostname) != 0)
+    {
+        return NULL;
+    }
+    name = bfromcstr(filename);
+    if (name)
+    {
+        struct tagbstring placeholder = bsStatic("%h");
+        bstring host = bfromcstr(hostname);
+        if (binstr(name, 0, &placeholder) != BSTR_ERR)
+        {
+            bfindreplace(name, &placeholder, host, 0);
+        }
+        else
+        {
+            bconchar(name, '.');
+            bconcat(name, host);
+        }
+        bdestroy(host);
+    }
+    return name;
+}
+
+/* The XML cache is only usable if it was written on this host with the same
+ * I/O discovery setting */
+static int _loop_adapt_hwloc_tree_check_xml(hwloc_topology_t tree, int with_io)
+{
+    char hostname[HOST_NAME_MAX+1];
+    hwloc_obj_t root = hwloc_get_root_obj(tree);
+    const char* xml_host = hwloc_obj_get_info_by_name(root, "HostName");
+    const char* xml_io = hwloc_obj_get_info_by_name(root, LOOP_ADAPT_HWLOC_XML_IO_INFO);
+    int err = _loop_adapt_hwloc_tree_hostname(hostname);
+    if (err < 0)
+    {
+        return err;
+    }
+    if (!xml_host || strcmp(xml_host, hostname) != 0)
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Topology XML cache of host %s not usable on host %s, (xml_host ? xml_host : "(unknown)"), hostname);
+        return -EINVAL;
+    }
+    if (!xml_io || atoi(xml_io) != with_io)
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Topology XML cache was written with other I/O discovery setting);
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int _loop_adapt_hwloc_tree_load_synthetic(char* description, int with_io)
+{
+    int err = 0;
+    hwloc_topology_t tree = NULL;
+    err = hwloc_topology_init(&tree);
+    if (err < 0)
+    {
+        return err;
+    }
+    _loop_adapt_hwloc_tree_set_filters(tree, with_io);
+    err = hwloc_topology_set_synthetic(tree, description);
+    if (err == 0)
+    {
+        err = hwloc_topology_load(tree);
+    }
+    if (err < 0)
+    {
+        hwloc_topology_destroy(tree);
+        return -EINVAL;
+    }
+    _loop_adapt_hwloc_tree = tree;
+    _loop_adapt_hwloc_is_synthetic = 1;
+    return 0;
+}
+
+static int _loop_adapt_hwloc_tree_load_xml(char* filename, int with_io)
+{
+    int err = 0;
+    hwloc_topology_t tree = NULL;
+    if (access(filename, R_OK) != 0)
+    {
+        return -errno;
+    }
+    err = hwloc_topology_init(&tree);
+    if (err < 0)
+    {
+        return err;
+    }
+    _loop_adapt_hwloc_tree_set_filters(tree, with_io);
+    // The cache describes this system, so binding to its cpusets is valid
+    hwloc_topology_set_flags(tree, HWLOC_TOPOLOGY_FLAG_IS_THISSYSTEM);
+    err = hwloc_topology_set_xml(tree, filename);
+    if (err == 0)
+    {
+        err = hwloc_topology_load(tree);
+    }
+    if (err == 0)
+    {
+        err = _loop_adapt_hwloc_tree_check_xml(tree, with_io);
+    }
+    if (err < 0)
+    {
+        hwloc_topology_destroy(tree);
+        return (err == -1 ? -EINVAL : err);
+    }
+    _loop_adapt_hwloc_tree = tree;
+    return 0;
+}
+
+/* Many processes might start at the same time and write the cache, so each
+ * process writes to a private file that is renamed afterwards. A reader never
+ * sees a partially written file. The process ID is only unique per host, so
+ * the private file also contains the hostname */
+static int _loop_adapt_hwloc_tree_write_xml(char* filename, int with_io)
+{
+    int err = 0;
+    char hostname[HOST_NAME_MAX+1];
+    bstring tmp = NULL;
+    err = _loop_adapt_hwloc_tree_hostname(hostname);
+    if (err < 0)
+    {
+        return err;
+    }
+    tmp = bformat("%s.%s.%d", filename, hostname, getpid());
+    if (!tmp)
+    {
+        return -ENOMEM;
+    }
+    hwloc_obj_add_info(hwloc_get_root_obj(_loop_adapt_hwloc_tree), LOOP_ADAPT_HWLOC_XML_IO_INFO, (with_io ? "1" : "0"));
+    if (hwloc_topology_export_xml(_loop_adapt_hwloc_tree, bdata(tmp), 0) != 0)
+    {
+        // hwloc does not set errno for all failures
+        err = -EIO;
+    }
+    else if (rename(bdata(tmp), filename) != 0)
+    {
+        err = -errno;
+    }
+    if (err < 0)
+    {
+        unlink(bdata(tmp));
+    }
+    bdestroy(tmp);
+    return err;
+}
+
+/* Build the lookup tables of the loaded topology. The topology is destroyed
+ * if it fails, so the initialization can be retried */
+static int _loop_adapt_hwloc_tree_finish_load()
+{
+    int err = _loop_adapt_hwloc_tree_build_tables(_loop_adapt_hwloc_tree);
+    if (err < 0)
+    {
+        ERROR_PRINT(Failed to build topology lookup tables);
+        hwloc_topology_destroy(_loop_adapt_hwloc_tree);
+        _loop_adapt_hwloc_tree = NULL;
+        _loop_adapt_hwloc_is_synthetic = 0;
+    }
+    return err;
+}
+
+int loop_adapt_hwloc_tree_initialize()
 {
     int err = 0;
     if (!_loop_adapt_hwloc_tree)
     {
+        int with_io = _loop_adapt_hwloc_tree_with_io();
+        char* synthetic = _loop_adapt_hwloc_synthetic;
+        char* xml_file = _loop_adapt_hwloc_xml_file;
+        bstring xml_name = NULL;
+        if (!synthetic)
+        {
+            synthetic = getenv("LA_TOPOLOGY_SYNTHETIC");
+        }
+        if (synthetic && strlen(synthetic) > 0)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Load synthetic topology tree '%s', synthetic);
+            err = _loop_adapt_hwloc_tree_load_synthetic(synthetic, with_io);
+            if (err < 0)
+            {
+                ERROR_PRINT(Invalid synthetic topology description '%s', synthetic);
+                return err;
+            }
+            return _loop_adapt_hwloc_tree_finish_load();
+        }
+        if (!xml_file)
+        {
+            xml_file = getenv("LA_TOPOLOGY_XML");
+        }
+        if (xml_file && strlen(xml_file) > 0)
+        {
+            xml_name = _loop_adapt_hwloc_tree_xml_name(xml_file);
+            if (!xml_name)
+            {
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Cannot determine topology XML cache for %s. Discover topology, xml_file);
+            }
+        }
+        if (xml_name)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Load hwloc topology tree from XML cache %s, bdata(xml_name));
+            err = _loop_adapt_hwloc_tree_load_xml(bdata(xml_name), with_io);
+            if (err == 0)
+            {
+                bdestroy(xml_name);
+                return _loop_adapt_hwloc_tree_finish_load();
+            }
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Cannot use topology XML cache %s. Discover topology, bdata(xml_name));
+            err = 0;
+        }
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize hwloc topology tree);
         err = hwloc_topology_init(&_loop_adapt_hwloc_tree);
         if (err < 0)
         {
             ERROR_PRINT(Failed to initialize hwloc topology tree);
+            _loop_adapt_hwloc_tree = NULL;
+            bdestroy(xml_name);
             return err;
         }
+        _loop_adapt_hwloc_tree_set_filters(_loop_adapt_hwloc_tree, with_io);
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Load hwloc topology tree);
         err = hwloc_topology_load(_loop_adapt_hwloc_tree);
         if (err < 0)
         {
             ERROR_PRINT(Failed to load hwloc topology tree);
+            hwloc_topology_destroy(_loop_adapt_hwloc_tree);
+            _loop_adapt_hwloc_tree = NULL;
+            bdestroy(xml_name);
             return err;
         }
+        if (xml_name)
+        {
+            err = _loop_adapt_hwloc_tree_write_xml(bdata(xml_name), with_io);
+            if (err == 0)
+            {
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Wrote topology XML cache %s, bdata(xml_name));
+            }
+            else
+            {
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Cannot write topology XML cache %s: %s, bdata(xml_name), strerror(-err));
+            }
+            bdestroy(xml_name);
+            err = 0;
+        }
+        err = _loop_adapt_hwloc_tree_finish_load();
+    }
+    return err;
+}
+
+hwloc_topology_t loop_adapt_hwloc_tree_get()
+{
+    return _loop_adapt_hwloc_tree;
+}
+
+int loop_adapt_hwloc_tree_count(int scope)
+{
+    if (_loop_adapt_hwloc_tree)
+    {
+        int count = hwloc_get_nbobjs_by_type(_loop_adapt_hwloc_tree, scope);
+        return (count > 0 ? count : 0);
     }
-    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Duplicate hwloc topology tree);
-    err = hwloc_topology_dup(copy, _loop_adapt_hwloc_tree);
+    return 0;
+}
+
+int loop_adapt_hwloc_tree_slots_init(LoopAdaptTopologySlots* slots)
+{
+    int s = 0;
+    int err = loop_adapt_hwloc_tree_initialize();
     if (err < 0)
     {
-        ERROR_PRINT(Failed to duplicate hwloc topology tree);
         return err;
     }
-    return err;
+    memset(slots, 0, sizeof(LoopAdaptTopologySlots));
+    for (s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
+    {
+        int count = loop_adapt_hwloc_tree_count(LoopAdaptScopeList[s]);
+        if (count > 0)
+        {
+            slots->slots[s] = calloc(count, sizeof(void*));
+            if (!slots->slots[s])
+            {
+                ERROR_PRINT(Cannot allocate %d slots for scope %s, count, hwloc_obj_type_string(LoopAdaptScopeList[s]));
+                loop_adapt_hwloc_tree_slots_destroy(slots);
+                return -ENOMEM;
+            }
+            slots->num_slots[s] = count;
+        }
+    }
+    return 0;
 }
 
-void loop_adapt_copydestroy_hwloc_tree(hwloc_topology_t tree)
+void loop_adapt_hwloc_tree_slots_destroy(LoopAdaptTopologySlots* slots)
 {
-    hwloc_topology_destroy(tree);
+    int s = 0;
+    for (s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
+    {
+        free(slots->slots[s]);
+        slots->slots[s] = NULL;
+        slots->num_slots[s] = 0;
+    }
 }
 
 void loop_adapt_hwloc_tree_finalize()
@@ -76,4 +535,34 @@ void loop_adapt_hwloc_tree_finalize()
         hwloc_topology_destroy(_loop_adapt_hwloc_tree);
         _loop_adapt_hwloc_tree = NULL;
     }
+    _loop_adapt_hwloc_tree_free_tables();
+    free(_loop_adapt_hwloc_xml_file);
+    _loop_adapt_hwloc_xml_file = NULL;
+    free(_loop_adapt_hwloc_synthetic);
+    _loop_adapt_hwloc_synthetic = NULL;
+    _loop_adapt_hwloc_is_synthetic = 0;
+}
+
+int loop_adapt_hwloc_tree_cpu_to_pu(int cpu)
+{
+    if (cpu >= 0 && cpu < _loop_adapt_hwloc_num_cpus)
+    {
+        return _loop_adapt_hwloc_cpu_to_pu[cpu];
+    }
+    return -ENOENT;
+}
+
+int loop_adapt_hwloc_tree_scope_offsets(int cpu, int* offsets)
+{
+    int s = 0;
+    int pu = loop_adapt_hwloc_tree_cpu_to_pu(cpu);
+    if (pu < 0 || !offsets)
+    {
+        return -ENOENT;
+    }
+    for (s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
+    {
+        offsets[s] = _loop_adapt_hwloc_pu_scopes[pu * LOOP_ADAPT_NUM_SCOPES + s];
+    }
+    return 0;
 }
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <error.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include <loop_adapt_measurement_types.h>
 #include <loop_adapt_measurement_list.h>
@@ -39,14 +40,28 @@
 #include <loop_adapt_hwloc_tree.h>
 #include <loop_adapt_lock.h>
 #include <loop_adapt_threads.h>
+#include <loop_adapt_internal.h>
 #include <map.h>
 #include <bstrlib.h>
 #include <bstrlib_helper.h>
 
 static MeasurementDefinition* loop_adapt_active_measurements = NULL;
 static int loop_adapt_num_active_measurements = 0;
+/*! \brief  Serializes the lazy initialization of the backends */
+static pthread_mutex_t loop_adapt_measurement_init_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static hwloc_topology_t loop_adapt_measurement_tree = NULL;
+/*! \brief  Measurement lists of the topology objects. Each slot holds a MeasurementList */
+static LoopAdaptTopologySlots loop_adapt_measurement_slots;
+static int loop_adapt_measurement_slots_init = 0;
+
+/* Get the slot of a thread for the scope at offset s in LoopAdaptScopeList */
+static inline void** _loop_adapt_measurement_thread_slot(ThreadData_t thread, int s)
+{
+    return loop_adapt_hwloc_tree_slot_at(&loop_adapt_measurement_slots, s, thread->scopeOffsets[s]);
+}
+
+/*! \brief Interning table: measurement name -> measurement ID (index in loop_adapt_active_measurements) */
+static Map_t loop_adapt_measurement_ids = NULL;
 
 static Measurement_t _loop_adapt_new_measurement()
 {
@@ -64,6 +79,25 @@ static Measurement_t _loop_adapt_new_measurement()
     return p;
 }
 
+/* Copy src into the string at dst. The existing buffer is reused if it is
+ * large enough */
+static void _loop_adapt_measurement_assign(bstring* dst, bstring src)
+{
+    if (!src)
+    {
+        bdestroy(*dst);
+        *dst = NULL;
+    }
+    else if (*dst)
+    {
+        bassign(*dst, src);
+    }
+    else
+    {
+        *dst = bstrcpy(src);
+    }
+}
+
 static int _loop_adapt_copy_measurement_definition(MeasurementDefinition* in, MeasurementDefinition*out)
 {
     if (in && out)
@@ -82,13 +116,73 @@ static int _loop_adapt_copy_measurement_definition(MeasurementDefinition* in, Me
         out->stop = in->stop;
         out->stopall = in->stopall;
         out->result = in->result;
+        out->configs = in->configs;
         out->finalize = in->finalize;
+        out->histogram = in->histogram;
+        out->cumulative = in->cumulative;
+        out->initialized = 0;
 
         return 0;
     }
     return -1;
 }
 
+static void _loop_adapt_measurement_destroy(gpointer mptr)
+{
+    Measurement_t m = (Measurement_t)mptr;
+    if (m)
+    {
+        m->responsible = LOOP_ADAPT_LOCK_INIT;
+        m->measure_list_idx = 0;
+        bdestroy(m->configuration);
+        bdestroy(m->metrics);
+        m->instance = 0;
+        m->state = LOOP_ADAPT_MEASUREMENT_STATE_NONE;
+        free(m);
+    }
+}
+
+static void _loop_adapt_measurement_list_destroy(MeasurementList* list)
+{
+    int i = 0;
+    for (i = 0; i < list->size; i++)
+    {
+        if (list->measurements[i])
+        {
+            _loop_adapt_measurement_destroy(list->measurements[i]);
+        }
+    }
+    free(list->measurements);
+    free(list);
+}
+
+static MeasurementList* _loop_adapt_measurement_list_new(int size)
+{
+    MeasurementList* list = malloc(sizeof(MeasurementList));
+    if (list)
+    {
+        list->measurements = malloc(size * sizeof(Measurement_t));
+        if (!list->measurements)
+        {
+            free(list);
+            return NULL;
+        }
+        memset(list->measurements, 0, size * sizeof(Measurement_t));
+        list->size = size;
+        list->count = 0;
+    }
+    return list;
+}
+
+static inline Measurement_t _loop_adapt_measurement_at(MeasurementList* list, int id)
+{
+    if (list && id >= 0 && id < list->size)
+    {
+        return list->measurements[id];
+    }
+    return NULL;
+}
+
 void loop_adapt_measurement_finalize()
 {
     int j = 0;
@@ -101,11 +195,12 @@ void loop_adapt_measurement_finalize()
             {
                 MeasurementDefinition* md = &loop_adapt_active_measurements[j];
                 DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize measurement system %s, md->name);
-                if (md->finalize)
+                if (md->finalize && md->initialized > 0)
                 {
                     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling finalize function of measurement system %s, md->name);
                     md->finalize();
                 }
+                md->initialized = 0;
                 free(md->name);
             }
             loop_adapt_num_active_measurements = 0;
@@ -114,11 +209,29 @@ void loop_adapt_measurement_finalize()
         loop_adapt_active_measurements = NULL;
     }
 
-    if (loop_adapt_measurement_tree)
+    if (loop_adapt_measurement_slots_init)
     {
+        int s = 0;
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize measurement system tree);
-        hwloc_topology_destroy(loop_adapt_measurement_tree);
-        loop_adapt_measurement_tree = NULL;
+        for (s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
+        {
+            for (j = 0; j < loop_adapt_measurement_slots.num_slots[s]; j++)
+            {
+                void** slot = loop_adapt_hwloc_tree_slot_at(&loop_adapt_measurement_slots, s, j);
+                if (slot && *slot)
+                {
+                    _loop_adapt_measurement_list_destroy((MeasurementList*)*slot);
+                    *slot = NULL;
+                }
+            }
+        }
+        loop_adapt_hwloc_tree_slots_destroy(&loop_adapt_measurement_slots);
+        loop_adapt_measurement_slots_init = 0;
+    }
+    if (loop_adapt_measurement_ids)
+    {
+        destroy_smap(loop_adapt_measurement_ids);
+        loop_adapt_measurement_ids = NULL;
     }
 }
 
@@ -133,6 +246,11 @@ int loop_adapt_measurement_initialize()
 /*        md = &loop_adapt_measurement_list[md_idx];*/
 /*    }*/
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize measurement system with %d backends, loop_adapt_measurement_list_count);
+    if (init_smap(&loop_adapt_measurement_ids, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to create measurement ID table\n");
+        return 1;
+    }
     loop_adapt_active_measurements = malloc(loop_adapt_measurement_list_count * sizeof(MeasurementDefinition));
     if (!loop_adapt_active_measurements)
     {
@@ -145,119 +263,194 @@ int loop_adapt_measurement_initialize()
         MeasurementDefinition* out = &loop_adapt_active_measurements[j];
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize measurement system %s, in->name);
         _loop_adapt_copy_measurement_definition(in, out);
-        if (out->init)
-        {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling init function of measurement system %s, in->name);
-            out->init();
-        }
+        add_smap(loop_adapt_measurement_ids, out->name, (void*)(intptr_t)j);
+        // The init function is called by loop_adapt_measurement_init_id() when
+        // the backend is used first
         loop_adapt_num_active_measurements++;
     }
-    if (!loop_adapt_measurement_tree)
+    if (!loop_adapt_measurement_slots_init)
     {
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize measurement system tree);
-        int err = loop_adapt_copy_hwloc_tree(&loop_adapt_measurement_tree);
-        if (err)
+        int err = loop_adapt_hwloc_tree_slots_init(&loop_adapt_measurement_slots);
+        if (err == 0)
         {
-            ERROR_PRINT(Failed to copy hwloc tree for measurements);
+            loop_adapt_measurement_slots_init = 1;
+        }
+        else
+        {
+            ERROR_PRINT(Failed to initialize slots of hwloc tree for measurements);
             loop_adapt_measurement_finalize();
             return err;
         }
     }
 }
 
-static void _loop_adapt_measurement_destroy(gpointer mptr)
+int loop_adapt_measurement_id(char* measurement)
 {
-    Measurement_t m = (Measurement_t)mptr;
-    if (m)
+    int i = 0;
+    void* id = NULL;
+    if (!measurement)
     {
-        m->responsible = LOOP_ADAPT_LOCK_INIT;
-        m->measure_list_idx = 0;
-        bdestroy(m->configuration);
-        bdestroy(m->metrics);
-        m->instance = 0;
-        m->state = LOOP_ADAPT_MEASUREMENT_STATE_NONE;
-        free(m);
+        return -EINVAL;
+    }
+    if (loop_adapt_measurement_ids)
+    {
+        if (get_smap_by_key(loop_adapt_measurement_ids, measurement, &id) == 0)
+        {
+            return (int)(intptr_t)id;
+        }
+        return -ENOENT;
     }
+    for (i = 0; i < loop_adapt_num_active_measurements; i++)
+    {
+        if (strcmp(measurement, loop_adapt_active_measurements[i].name) == 0)
+        {
+            return i;
+        }
+    }
+    return -ENOENT;
 }
 
-int loop_adapt_measurement_setup(ThreadData_t thread, char* measurement, bstring configuration, bstring metrics)
+int loop_adapt_measurement_init_id(int id)
 {
-    int i = 0;
-    int s = 0;
-    int md_idx = -1;
+    int state = 0;
     MeasurementDefinition* md = NULL;
-    for (i = 0; i < loop_adapt_num_active_measurements; i++)
+    if (id < 0 || id >= loop_adapt_num_active_measurements)
     {
-        if (strncmp(measurement, loop_adapt_active_measurements[i].name, strlen(loop_adapt_active_measurements[i].name)) == 0)
+        return -EINVAL;
+    }
+    md = &loop_adapt_active_measurements[id];
+    state = __atomic_load_n(&md->initialized, __ATOMIC_ACQUIRE);
+    if (state != 0)
+    {
+        return (state > 0 ? 0 : state);
+    }
+    pthread_mutex_lock(&loop_adapt_measurement_init_lock);
+    if (md->initialized == 0)
+    {
+        state = 1;
+        if (md->init)
         {
-            md = &loop_adapt_active_measurements[i];
-            md_idx = i;
-            break;
+            double start = loop_adapt_timestamp();
+            int err = md->init();
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Init of measurement system %s took %.3f ms, md->name, 1E3 * (loop_adapt_timestamp() - start));
+            if (err < 0)
+            {
+                ERROR_PRINT(Initialization of measurement system %s failed: %d, md->name, err);
+                state = err;
+            }
         }
+        __atomic_store_n(&md->initialized, state, __ATOMIC_RELEASE);
     }
-    if (!md)
+    state = md->initialized;
+    pthread_mutex_unlock(&loop_adapt_measurement_init_lock);
+    return (state > 0 ? 0 : state);
+}
+
+int loop_adapt_measurement_setup_id(ThreadData_t thread, int id, bstring configuration, bstring metrics)
+{
+    int s = 0;
+    MeasurementDefinition* md = NULL;
+    if (id < 0 || id >= loop_adapt_num_active_measurements)
     {
-        ERROR_PRINT(No measurement backend %s, measurement);
+        ERROR_PRINT(No measurement backend with ID %d, id);
         return -EINVAL;
     }
+    md = &loop_adapt_active_measurements[id];
+    if (loop_adapt_measurement_init_id(id) != 0)
+    {
+        return -ENODEV;
+    }
 
-
-    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Setup measurement system %s for thread %d (scope %s %d), md->name, thread->thread, hwloc_obj_type_string(md->scope), thread->scopeOffsets[md->scope]);
-    for (s=0;s < LOOP_ADAPT_NUM_SCOPES; s++)
+    s = loop_adapt_scope_offset(md->scope);
+    if (s < 0)
     {
-    	if (LoopAdaptScopeList[s] == md->scope)
-    		break;
+        ERROR_PRINT(Invalid scope for measurement %s, md->name);
+        return -EINVAL;
     }
-    hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_measurement_tree, md->scope, thread->scopeOffsets[s]);
-    if (obj)
+    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Setup measurement system %s for thread %d (scope %s %d), md->name, thread->thread, hwloc_obj_type_string(md->scope), thread->scopeOffsets[s]);
+    void** slot = _loop_adapt_measurement_thread_slot(thread, s);
+    if (slot)
     {
-        Map_t measurements = (Map_t)obj->userdata;
+        MeasurementList* measurements = (MeasurementList*)*slot;
         if (!measurements)
         {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize measurement map at %s %d, hwloc_obj_type_string(obj->type), obj->logical_index);
-            init_smap(&measurements, _loop_adapt_measurement_destroy);
-            obj->userdata = (void*)measurements;
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize measurement list at %s %d, hwloc_obj_type_string(md->scope), thread->scopeOffsets[s]);
+            measurements = _loop_adapt_measurement_list_new(loop_adapt_num_active_measurements);
+            if (!measurements)
+            {
+                return -ENOMEM;
+            }
+            *slot = (void*)measurements;
+        }
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Setup measurement %s at %s %d, md->name, hwloc_obj_type_string(md->scope), thread->scopeOffsets[s]);
+        Measurement_t m = measurements->measurements[id];
+        if (m)
+        {
+            // Setup in each cycle: The measurement set up first stays at the
+            // object and is reused by the responsible thread.
+            if (m->responsible == thread->objidx)
+            {
+                _loop_adapt_measurement_assign(&m->configuration, configuration);
+                _loop_adapt_measurement_assign(&m->metrics, metrics);
+                md->setup(m->instance, m->configuration, m->metrics);
+                m->state = LOOP_ADAPT_MEASUREMENT_STATE_SETUP;
+            }
+            return 0;
         }
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Setup measurement %s at %s %d, measurement, hwloc_obj_type_string(md->scope), obj->logical_index);
-        Measurement_t m = _loop_adapt_new_measurement();
+        m = _loop_adapt_new_measurement();
         if (m)
         {
-            m->measure_list_idx = md_idx;
+            m->measure_list_idx = id;
             lock_acquire(&m->responsible, thread->objidx);
             if (md->scope == LOOP_ADAPT_SCOPE_THREAD)
                 m->instance = thread->thread;
             else
-                m->instance = obj->logical_index;
+                m->instance = thread->scopeOffsets[s];
             m->configuration = bstrcpy(configuration);
             m->metrics = bstrcpy(metrics);
-            loop_adapt_active_measurements[md_idx].setup(m->instance, m->configuration, m->metrics);
+            md->setup(m->instance, m->configuration, m->metrics);
             m->state = LOOP_ADAPT_MEASUREMENT_STATE_SETUP;
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Adding measurement %s=%s:%s at %s %d (state %d) %p, measurement, bdata(m->configuration), bdata(m->metrics), hwloc_obj_type_string(obj->type), obj->logical_index, m->state, m);
-            add_smap(measurements, measurement, (void*)m);
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Adding measurement %s=%s:%s at %s %d (state %d) %p, md->name, bdata(m->configuration), bdata(m->metrics), hwloc_obj_type_string(md->scope), thread->scopeOffsets[s], m->state, m);
+            measurements->measurements[id] = m;
+            measurements->count++;
         }
     }
     return 0;
 }
 
-int loop_adapt_measurement_start(ThreadData_t thread, char* measurement)
+int loop_adapt_measurement_setup(ThreadData_t thread, char* measurement, bstring configuration, bstring metrics)
 {
-    int i = 0;
+    int id = loop_adapt_measurement_id(measurement);
+    if (id < 0)
+    {
+        ERROR_PRINT(No measurement backend %s, measurement);
+        return -EINVAL;
+    }
+    return loop_adapt_measurement_setup_id(thread, id, configuration, metrics);
+}
+
+int loop_adapt_measurement_start_id(ThreadData_t thread, int id)
+{
+    if (id < 0 || id >= loop_adapt_num_active_measurements)
+    {
+        return -EINVAL;
+    }
+    char* measurement = loop_adapt_active_measurements[id].name;
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Starting measurement %s for thread %d, measurement, thread->thread);
     for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
     {
-        if (thread->scopeOffsets[s] < 0) continue;
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_measurement_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-        if (obj)
+        void** slot = _loop_adapt_measurement_thread_slot(thread, s);
+        if (slot)
         {
-            Measurement_t m = NULL;
-            Map_t measurements = (Map_t)obj->userdata;
+            MeasurementList* measurements = (MeasurementList*)*slot;
             if (!measurements)
             {
                 continue;
             }
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Checking measurement map at %s %d for thread %d, hwloc_obj_type_string(obj->type), obj->logical_index, thread->thread);
-            int err = get_smap_by_key(measurements, measurement, (void**)&m);
-            if (err == 0)
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Checking measurement list at %s %d for thread %d, hwloc_obj_type_string(LoopAdaptScopeList[s]), thread->scopeOffsets[s], thread->thread);
+            Measurement_t m = _loop_adapt_measurement_at(measurements, id);
+            if (m)
             {
                 if (m->responsible != thread->objidx)
                 {
@@ -268,7 +461,7 @@ int loop_adapt_measurement_start(ThreadData_t thread, char* measurement)
                     m->state == LOOP_ADAPT_MEASUREMENT_STATE_SETUP)
                 {
                     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling start function for measurement %s (%d) with instance %d, measurement, m->measure_list_idx, m->instance);
-                    loop_adapt_active_measurements[m->measure_list_idx].start(m->instance);
+                    loop_adapt_active_measurements[id].start(m->instance);
                     m->state = LOOP_ADAPT_MEASUREMENT_STATE_RUNNING;
                     return 0;
                 }
@@ -282,13 +475,21 @@ int loop_adapt_measurement_start(ThreadData_t thread, char* measurement)
     return 0;
 }
 
+int loop_adapt_measurement_start(ThreadData_t thread, char* measurement)
+{
+    return loop_adapt_measurement_start_id(thread, loop_adapt_measurement_id(measurement));
+}
+
 
 int loop_adapt_measurement_start_all()
 {
     int i = 0;
     for (i = 0; i < loop_adapt_num_active_measurements; i++)
     {
-        
+        if (__atomic_load_n(&loop_adapt_active_measurements[i].initialized, __ATOMIC_ACQUIRE) <= 0)
+        {
+            continue;
+        }
         if (loop_adapt_active_measurements[i].startall)
         {
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling startall function for measurement %s, loop_adapt_active_measurements[i].name);
@@ -300,8 +501,8 @@ int loop_adapt_measurement_start_all()
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling start function for measurement %s for all threads, loop_adapt_active_measurements[i].name);
             for (j = 0; j < loop_adapt_threads_get_count(); j++)
             {
-                ThreadData_t thread = loop_adapt_threads_getthread(i);
-                loop_adapt_measurement_start(thread, loop_adapt_active_measurements[i].name);
+                ThreadData_t thread = loop_adapt_threads_getthread(j);
+                loop_adapt_measurement_start_id(thread, i);
             }
         }
     }
@@ -309,25 +510,27 @@ int loop_adapt_measurement_start_all()
 }
 
 
-int loop_adapt_measurement_stop(ThreadData_t thread, char* measurement)
+int loop_adapt_measurement_stop_id(ThreadData_t thread, int id)
 {
-    int i = 0;
+    if (id < 0 || id >= loop_adapt_num_active_measurements)
+    {
+        return -EINVAL;
+    }
+    char* measurement = loop_adapt_active_measurements[id].name;
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Stopping measurement %s for thread %d, measurement, thread->thread);
     for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
     {
-        if (thread->scopeOffsets[s] < 0) continue;
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_measurement_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-        if (obj)
+        void** slot = _loop_adapt_measurement_thread_slot(thread, s);
+        if (slot)
         {
-            Measurement_t m = NULL;
-            Map_t measurements = (Map_t)obj->userdata;
+            MeasurementList* measurements = (MeasurementList*)*slot;
             if (!measurements)
             {
                 continue;
             }
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Checking measurement map at %s %d for thread %d, hwloc_obj_type_string(obj->type), obj->logical_index, thread->thread);
-            int err = get_smap_by_key(measurements, measurement, (void**)&m);
-            if (err == 0)
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Checking measurement list at %s %d for thread %d, hwloc_obj_type_string(LoopAdaptScopeList[s]), thread->scopeOffsets[s], thread->thread);
+            Measurement_t m = _loop_adapt_measurement_at(measurements, id);
+            if (m)
             {
                 if (m->responsible != thread->objidx)
                 {
@@ -337,7 +540,7 @@ int loop_adapt_measurement_stop(ThreadData_t thread, char* measurement)
                 if (m->state == LOOP_ADAPT_MEASUREMENT_STATE_RUNNING)
                 {
                     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling stop function for measurement %s (%d) with instance %d, measurement, m->measure_list_idx, m->instance);
-                    loop_adapt_active_measurements[m->measure_list_idx].stop(m->instance);
+                    loop_adapt_active_measurements[id].stop(m->instance);
                     m->state = LOOP_ADAPT_MEASUREMENT_STATE_STOPPED;
                     return 0;
                 }
@@ -347,6 +550,11 @@ int loop_adapt_measurement_stop(ThreadData_t thread, char* measurement)
     return 0;
 }
 
+int loop_adapt_measurement_stop(ThreadData_t thread, char* measurement)
+{
+    return loop_adapt_measurement_stop_id(thread, loop_adapt_measurement_id(measurement));
+}
+
 
 
 int loop_adapt_measurement_stop_all()
@@ -354,42 +562,49 @@ int loop_adapt_measurement_stop_all()
     int i = 0;
     for (i = 0; i < loop_adapt_num_active_measurements; i++)
     {
+        if (__atomic_load_n(&loop_adapt_active_measurements[i].initialized, __ATOMIC_ACQUIRE) <= 0 ||
+            !loop_adapt_active_measurements[i].stopall)
+        {
+            continue;
+        }
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling stopall function for measurement %s, loop_adapt_active_measurements[i].name);
         loop_adapt_active_measurements[i].stopall();
     }
     return 0;
 }
 
-int loop_adapt_measurement_result(ThreadData_t thread, char* measurement, int num_values, ParameterValue* values)
+int loop_adapt_measurement_result_id(ThreadData_t thread, int id, int num_values, ParameterValue* values)
 {
-    int i = 0;
     int err = 0;
+    if (id < 0 || id >= loop_adapt_num_active_measurements)
+    {
+        return -EINVAL;
+    }
+    char* measurement = loop_adapt_active_measurements[id].name;
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Getting measurement results (thread: %d, measurement: %s), thread->thread, measurement);
     for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES ; s++)
     {
-        if (thread->scopeOffsets[s] < 0) continue;
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_measurement_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-        if (obj)
+        void** slot = _loop_adapt_measurement_thread_slot(thread, s);
+        if (slot)
         {
-            Map_t measurements = (Map_t)obj->userdata;
+            MeasurementList* measurements = (MeasurementList*)*slot;
             if (!measurements)
             {
                 DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, No measurements at obj for scope %d, s);
                 continue;
             }
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Checking measurement map at %s %d for thread %d, hwloc_obj_type_string(obj->type), obj->logical_index, thread->thread);
-            Measurement_t m = NULL;
-            err = get_smap_by_key(measurements, measurement, (void**)&m);
-            if (err == 0)
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Checking measurement list at %s %d for thread %d, hwloc_obj_type_string(LoopAdaptScopeList[s]), thread->scopeOffsets[s], thread->thread);
+            Measurement_t m = _loop_adapt_measurement_at(measurements, id);
+            if (m)
             {
                 if (m->responsible == thread->objidx)
                 {
                     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Calling getresult function for measurement %s (%d) with instance %d, measurement, m->measure_list_idx, m->instance);
-                    err = loop_adapt_active_measurements[m->measure_list_idx].result(m->instance, num_values, values);
+                    err = loop_adapt_active_measurements[id].result(m->instance, num_values, values);
                 }
                 else
                 {
-                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, NOT calling getresult function for measurement %s (%d) with instance %d);
+                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, NOT calling getresult function for measurement %s (%d) with instance %d, measurement, m->measure_list_idx, m->instance);
                 }
             }
         }
@@ -402,18 +617,51 @@ int loop_adapt_measurement_result(ThreadData_t thread, char* measurement, int nu
     return err;
 }
 
+int loop_adapt_measurement_result(ThreadData_t thread, char* measurement, int num_values, ParameterValue* values)
+{
+    return loop_adapt_measurement_result_id(thread, loop_adapt_measurement_id(measurement), num_values, values);
+}
 
-int loop_adapt_measurement_available(char* measurement)
+
+int loop_adapt_measurement_cumulative_id(int id)
 {
-    int i = 0;
-    for (i = 0; i < loop_adapt_num_active_measurements; i++)
+    if (id < 0 || id >= loop_adapt_num_active_measurements)
+    {
+        return 0;
+    }
+    return loop_adapt_active_measurements[id].cumulative;
+}
+
+LoopAdaptHistogram* loop_adapt_measurement_histogram_id(ThreadData_t thread, int id)
+{
+    if (id < 0 || id >= loop_adapt_num_active_measurements || !loop_adapt_active_measurements[id].histogram)
+    {
+        return NULL;
+    }
+    for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
     {
-        if (strncmp(measurement, loop_adapt_active_measurements[i].name, strlen(loop_adapt_active_measurements[i].name)) == 0)
+        void** slot = _loop_adapt_measurement_thread_slot(thread, s);
+        if (slot)
         {
-            return 1;
+            MeasurementList* measurements = (MeasurementList*)*slot;
+            if (!measurements)
+            {
+                continue;
+            }
+            Measurement_t m = _loop_adapt_measurement_at(measurements, id);
+            // Only the responsible thread records the iterations
+            if (m && m->responsible == thread->objidx && m->state == LOOP_ADAPT_MEASUREMENT_STATE_RUNNING)
+            {
+                return loop_adapt_active_measurements[id].histogram(m->instance);
+            }
         }
     }
-    return 0;
+    return NULL;
+}
+
+int loop_adapt_measurement_available(char* measurement)
+{
+    return (loop_adapt_measurement_id(measurement) >= 0);
 }
 
 
@@ -422,13 +670,12 @@ int loop_adapt_measurement_num_metrics(ThreadData_t thread)
     int count = 0;
     for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES ; s++)
     {
-        if (thread->scopeOffsets[s] < 0) continue;
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_measurement_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-        if (obj)
+        void** slot = _loop_adapt_measurement_thread_slot(thread, s);
+        if (slot)
         {
-            Map_t measurements = (Map_t)obj->userdata;
+            MeasurementList* measurements = (MeasurementList*)*slot;
             if (!measurements) continue;
-            count += get_smap_size(measurements);
+            count += measurements->count;
         }
     }
     return count;
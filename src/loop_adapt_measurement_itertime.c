@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <bstrlib.h>
+#include <bstrlib_helper.h>
+
+#include <error.h>
+#include <loop_adapt_parameter_value.h>
+#include <loop_adapt_padding.h>
+#include <loop_adapt_chunked_array.h>
+#include <loop_adapt_histogram.h>
+
+/* Per-iteration timing. The inline fast path of the loop macros records the
+ * duration of each iteration into the histogram of the thread. The
+ * configuration selects the statistic returned as result. All values are in
+ * ns (variance in ns^2). The instances are stored like the TIMER instances in
+ * a chunked array, the histogram of an instance is allocated at its first
+ * setup by the calling thread (usually the owning thread). */
+
+typedef enum {
+    ITERTIME_STAT_P50,
+    ITERTIME_STAT_P90,
+    ITERTIME_STAT_P99,
+    ITERTIME_STAT_MAX,
+    ITERTIME_STAT_MEAN,
+    ITERTIME_STAT_VARIANCE,
+    ITERTIME_STAT_COUNT
+} ItertimeStatistic;
+
+static char* itertime_stat_names[ITERTIME_STAT_COUNT] = {
+    "P50", "P90", "P99", "MAX", "MEAN", "VARIANCE"
+};
+
+typedef struct {
+    LoopAdaptHistogram* histogram;
+    ItertimeStatistic stat;
+    int active; /**< \brief Set up at least once */
+} __attribute__((aligned(LOOP_ADAPT_CACHELINE_SIZE))) ItertimeMeasurement;
+
+static LoopAdaptChunkedArray itertime_instances = LOOP_ADAPT_CHUNKED_ARRAY_INITIALIZER(sizeof(ItertimeMeasurement));
+static int itertime_initialized = 0;
+
+int loop_adapt_measurement_itertime_init()
+{
+    itertime_initialized = 1;
+    return 0;
+}
+
+static void _loop_adapt_itertime_free(void* entry)
+{
+    free(((ItertimeMeasurement*)entry)->histogram);
+}
+
+void loop_adapt_measurement_itertime_finalize()
+{
+    loop_adapt_chunked_array_destroy(&itertime_instances, _loop_adapt_itertime_free);
+    itertime_initialized = 0;
+}
+
+static inline ItertimeMeasurement* _loop_adapt_itertime_get(int instance)
+{
+    return loop_adapt_chunked_array_get(&itertime_instances, instance);
+}
+
+int loop_adapt_measurement_itertime_setup(int instance, bstring configuration, bstring metrics)
+{
+    int i = 0;
+    if (!itertime_initialized)
+    {
+        ERROR_PRINT(Itertime measurement module not initialized);
+        return -EINVAL;
+    }
+    if (!configuration)
+    {
+        return -EINVAL;
+    }
+    for (i = 0; i < ITERTIME_STAT_COUNT; i++)
+    {
+        if (biseqcstr(configuration, itertime_stat_names[i]) == 1)
+        {
+            break;
+        }
+    }
+    if (i == ITERTIME_STAT_COUNT)
+    {
+        ERROR_PRINT(Unknown itertime configuration %s, bdata(configuration));
+        return -EINVAL;
+    }
+    ItertimeMeasurement* m = loop_adapt_chunked_array_get_or_create(&itertime_instances, instance);
+    if (!m)
+    {
+        return -ENOMEM;
+    }
+    if (!m->histogram)
+    {
+        m->histogram = loop_adapt_padded_alloc(sizeof(LoopAdaptHistogram));
+        if (!m->histogram)
+        {
+            return -ENOMEM;
+        }
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Setup itertime histogram for instance %d, instance);
+    }
+    m->stat = (ItertimeStatistic)i;
+    loop_adapt_histogram_reset(m->histogram);
+    __atomic_store_n(&m->active, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void loop_adapt_measurement_itertime_start(int instance)
+{
+    ItertimeMeasurement* m = _loop_adapt_itertime_get(instance);
+    if (m && m->active)
+    {
+        loop_adapt_histogram_reset(m->histogram);
+    }
+}
+
+void loop_adapt_measurement_itertime_startall()
+{
+    int i = 0;
+    int size = loop_adapt_chunked_array_size(&itertime_instances);
+    for (i = 0; i < size; i++)
+    {
+        ItertimeMeasurement* m = _loop_adapt_itertime_get(i);
+        if (m && m->active)
+        {
+            loop_adapt_histogram_reset(m->histogram);
+        }
+    }
+}
+
+/* The iterations are recorded by the loop macros, nothing to stop */
+void loop_adapt_measurement_itertime_stop(int instance)
+{
+}
+
+void loop_adapt_measurement_itertime_stopall()
+{
+}
+
+int loop_adapt_measurement_itertime_result(int instance, int num_values, ParameterValue* values)
+{
+    ItertimeMeasurement* m = _loop_adapt_itertime_get(instance);
+    if (m && m->active && num_values > 0)
+    {
+        LoopAdaptHistogram* h = m->histogram;
+        ParameterValue* v = &values[0];
+        v->type = LOOP_ADAPT_PARAMETER_TYPE_DOUBLE;
+        switch (m->stat)
+        {
+            case ITERTIME_STAT_P50:
+                v->value.dval = loop_adapt_histogram_percentile(h, 0.5);
+                break;
+            case ITERTIME_STAT_P90:
+                v->value.dval = loop_adapt_histogram_percentile(h, 0.9);
+                break;
+            case ITERTIME_STAT_P99:
+                v->value.dval = loop_adapt_histogram_percentile(h, 0.99);
+                break;
+            case ITERTIME_STAT_MAX:
+                v->value.dval = (double)h->max;
+                break;
+            case ITERTIME_STAT_MEAN:
+                v->value.dval = loop_adapt_histogram_mean(h);
+                break;
+            case ITERTIME_STAT_VARIANCE:
+                v->value.dval = loop_adapt_histogram_variance(h);
+                break;
+            default:
+                v->value.dval = 0;
+                break;
+        }
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Itertime result %s for instance %d: %f (%lu iterations), itertime_stat_names[m->stat], instance, v->value.dval, h->count);
+        return 1;
+    }
+    return 0;
+}
+
+int loop_adapt_measurement_itertime_configs(struct bstrList* configs)
+{
+    int i = 0;
+    for (i = 0; i < ITERTIME_STAT_COUNT; i++)
+    {
+        bstrListAddChar(configs, itertime_stat_names[i]);
+    }
+    return ITERTIME_STAT_COUNT;
+}
+
+LoopAdaptHistogram* loop_adapt_measurement_itertime_histogram(int instance)
+{
+    ItertimeMeasurement* m = _loop_adapt_itertime_get(instance);
+    if (m && m->active)
+    {
+        return m->histogram;
+    }
+    return NULL;
+}
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <string.h>
+#include <pthread.h>
 
 #include <bstrlib.h>
 #include <bstrlib_helper.h>
@@ -17,14 +19,26 @@
 /*ParameterValue (*loop_adapt_likwid_result)(int instance);*/
 
 
+/* A resolved measurement session: The LIKWID group ID of the event set and
+ * the indices of the requested metrics in the group. Sessions are cached for
+ * each (configuration, metrics) pair, so switching between a few event sets
+ * neither adds the groups again nor resolves the metric names again. */
+typedef struct {
+    bstring group;
+    bstring metrics;
+    int gid;
+    int num_metric_ids;
+    int* metric_ids;
+} LikwidSession;
+
 static int likwid_init = 0;
 static int current_group = -1;
-static bstring current_group_str = NULL;
 /*static struct bstrList* current_metrics = NULL;*/
 static int* cpus = NULL;
 static int num_cpus = 0;
-static int* current_metric_ids = NULL;
-static int num_current_metric_ids = 0;
+static LikwidSession* current_session = NULL;
+static LikwidSession** sessions = NULL;
+static int num_sessions = 0;
 static pthread_mutex_t likwid_lock = PTHREAD_MUTEX_INITIALIZER;
 
 
@@ -56,22 +70,34 @@ int loop_adapt_measurement_likwid_init()
         else
         {
             ERROR_PRINT(Failed to initialize LIKWID);
+            return -EFAULT;
         }
-        current_group_str = bfromcstr("");
     }
+    return 0;
+}
+
+static void _loop_adapt_measurement_likwid_destroy_sessions()
+{
+    int i = 0;
+    for (i = 0; i < num_sessions; i++)
+    {
+        bdestroy(sessions[i]->group);
+        bdestroy(sessions[i]->metrics);
+        free(sessions[i]->metric_ids);
+        free(sessions[i]);
+    }
+    free(sessions);
+    sessions = NULL;
+    num_sessions = 0;
+    current_session = NULL;
 }
 
 void loop_adapt_measurement_likwid_finalize()
 {
     if (likwid_init)
     {
-        if (current_metric_ids)
-        {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Freeing LIKWID metric IDs);
-            free(current_metric_ids);
-            current_metric_ids = NULL;
-            num_current_metric_ids = 0;
-        }
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Freeing %d LIKWID sessions, num_sessions);
+        _loop_adapt_measurement_likwid_destroy_sessions();
         if (cpus)
         {
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Freeing LIKWID CPU list);
@@ -81,101 +107,149 @@ void loop_adapt_measurement_likwid_finalize()
         }
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize LIKWID);
         perfmon_finalize();
-        bdestroy(current_group_str);
-        current_group_str = NULL;
         current_group = -1;
         likwid_init = 0;
     }
 }
 
-int loop_adapt_measurement_likwid_setup(int instance, bstring configuration, bstring metrics)
+static int _loop_adapt_measurement_likwid_bstr_equal(bstring a, bstring b)
 {
-    int err = 0;
-    int i = 0;
-    int j = 0;
+    if ((!a) || (!b))
+    {
+        return (!a) && (!b);
+    }
+    return biseq(a, b) == 1;
+}
 
-    if (likwid_init)
+/* Get the first metric of the group which starts with name */
+static int _loop_adapt_measurement_likwid_metric_id(int gid, bstring name)
+{
+    int j = 0;
+    int id = -1;
+    int matches = 0;
+    for (j = 0; j < perfmon_getNumberOfMetrics(gid); j++)
     {
-        pthread_mutex_lock(&likwid_lock);
-        if (bstrncmp(configuration, current_group_str, blength(configuration)) == BSTR_OK)
-        {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Reusing current configuration %s, bdata(configuration));
-            pthread_mutex_unlock(&likwid_lock);
-            return 0;
-        }
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Adding eventset %s, bdata(configuration));
-        int gid = perfmon_addEventSet(bdata(configuration));
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Eventset %s got GID %d, bdata(configuration), gid);
-        if (gid >= 0)
+        char* mname = perfmon_getMetricName(gid, j);
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Comparing '%s' with '%s', mname, bdata(name));
+        if (mname && strncmp(mname, bdata(name), blength(name)) == 0)
         {
-            current_group = gid;
-            int active_group = perfmon_getIdOfActiveGroup();
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Active LIKWID group: %d, active_group);
-            if (active_group >= 0)
+            if (id < 0)
             {
-                err = perfmon_switchActiveGroup(gid);
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Using LIKWID metric '%s' (idx %d) for '%s', mname, j, bdata(name));
+                id = j;
             }
-            struct bstrList* metriclist = bsplit(metrics, ',');
+            matches++;
+        }
+    }
+    if (matches > 1)
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Metric string %s matches %d metrics taking just first match, bdata(name), matches);
+    }
+    return id;
+}
 
-            if (current_metric_ids)
+/* Get the cached session or resolve a new one. The event set is only added
+ * to LIKWID once per configuration. Called with the LIKWID lock held. */
+static LikwidSession* _loop_adapt_measurement_likwid_get_session(bstring configuration, bstring metrics)
+{
+    int i = 0;
+    int gid = -1;
+    for (i = 0; i < num_sessions; i++)
+    {
+        if (_loop_adapt_measurement_likwid_bstr_equal(sessions[i]->group, configuration))
+        {
+            if (_loop_adapt_measurement_likwid_bstr_equal(sessions[i]->metrics, metrics))
             {
-                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Freeing current LIKWID metric IDs);
-                free(current_metric_ids);
-                current_metric_ids = NULL;
-                num_current_metric_ids = 0;
+                return sessions[i];
             }
-            num_current_metric_ids = 0;
-            current_metric_ids = malloc(metriclist->qty * sizeof(int));
-/*            int* ids = malloc(metriclist->qty * sizeof(int));*/
-/*            memset(ids, -1, metriclist->qty * sizeof(int));*/
-
-
-            int count = 0;
-            for (i = 0; i < metriclist->qty; i++)
+            // Same event set with other metrics
+            gid = sessions[i]->gid;
+        }
+    }
+    if (gid < 0)
+    {
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Adding eventset %s, bdata(configuration));
+        gid = perfmon_addEventSet(bdata(configuration));
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Eventset %s got GID %d, bdata(configuration), gid);
+        if (gid < 0)
+        {
+            ERROR_PRINT(Failed to add LIKWID eventset %s, bdata(configuration));
+            return NULL;
+        }
+    }
+    LikwidSession** tmp = realloc(sessions, (num_sessions + 1) * sizeof(LikwidSession*));
+    if (!tmp)
+    {
+        return NULL;
+    }
+    sessions = tmp;
+    LikwidSession* session = malloc(sizeof(LikwidSession));
+    if (!session)
+    {
+        return NULL;
+    }
+    memset(session, 0, sizeof(LikwidSession));
+    session->gid = gid;
+    session->group = bstrcpy(configuration);
+    session->metrics = (metrics ? bstrcpy(metrics) : NULL);
+    if (metrics)
+    {
+        struct bstrList* metriclist = bsplit(metrics, ',');
+        if (metriclist && metriclist->qty > 0)
+        {
+            session->metric_ids = malloc(metriclist->qty * sizeof(int));
+            for (i = 0; session->metric_ids && i < metriclist->qty; i++)
             {
-                int tmp = 0;
-                for (j = 0; j < perfmon_getNumberOfMetrics(gid); j++)
-                {
-                    bstring bname = bfromcstr(perfmon_getMetricName(gid, j));
-                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Comparing '%s' with '%s', bdata(bname), bdata(metriclist->entry[i]));
-                    if (bstrncmp(bname, metriclist->entry[i], blength(metriclist->entry[i])) == BSTR_OK)
-                    {
-
-                        tmp++;
-                    }
-                    bdestroy(bname);
-                }
-                if (tmp > 1)
-                {
-                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Metric string %s matches %d metrics taking just first match, bdata(metriclist->entry[i]), tmp);
-                }
-                for (j = 0; j < perfmon_getNumberOfMetrics(gid); j++)
+                int id = _loop_adapt_measurement_likwid_metric_id(gid, metriclist->entry[i]);
+                if (id >= 0)
                 {
-                    bstring bname = bfromcstr(perfmon_getMetricName(gid, j));
-                    if (bstrncmp(bname, metriclist->entry[i], blength(metriclist->entry[i])) == BSTR_OK)
-                    {
-                        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Using LIKWID metric '%s' (idx %d) for '%s', bdata(bname), j, bdata(metriclist->entry[i]));
-                        current_metric_ids[num_current_metric_ids] = j;
-                        num_current_metric_ids++;
-                        break;
-                    }
-                    bdestroy(bname);
+                    session->metric_ids[session->num_metric_ids++] = id;
                 }
             }
-            bstrListDestroy(metriclist);
+        }
+        bstrListDestroy(metriclist);
+    }
+    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Specifying %d new LIKWID metric IDs for LIKWID group %d, session->num_metric_ids, gid);
+    sessions[num_sessions++] = session;
+    return session;
+}
 
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Specifying %d new LIKWID metric IDs for LIKWID group %d, num_current_metric_ids, gid);
+int loop_adapt_measurement_likwid_setup(int instance, bstring configuration, bstring metrics)
+{
+    int err = 0;
 
-            perfmon_setupCounters(gid);
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Start LIKWID group %d on CPU %d, gid, cpus[instance]);
-            perfmon_startCounters();
-            current_group = gid;
-            bdestroy(current_group_str);
-            current_group_str = bstrcpy(configuration);
+    if (likwid_init)
+    {
+        pthread_mutex_lock(&likwid_lock);
+        LikwidSession* session = _loop_adapt_measurement_likwid_get_session(configuration, metrics);
+        if (!session)
+        {
             pthread_mutex_unlock(&likwid_lock);
+            return -EINVAL;
+        }
+        if (session->gid == current_group)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Reusing current configuration %s, bdata(configuration));
+        }
+        else if (current_group >= 0)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Switch LIKWID group from %d to %d, current_group, session->gid);
+            err = perfmon_switchActiveGroup(session->gid);
+        }
+        else
+        {
+            perfmon_setupCounters(session->gid);
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Start LIKWID group %d on CPU %d, session->gid, cpus[instance]);
+            err = perfmon_startCounters();
+        }
+        if (err == 0)
+        {
+            current_group = session->gid;
         }
+        __atomic_store_n(&current_session, session, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&likwid_lock);
     }
-    return 0;
+    return err;
 }
 
 void loop_adapt_measurement_likwid_start(int instance)
@@ -229,15 +303,16 @@ void loop_adapt_measurement_likwid_stopall()
 int loop_adapt_measurement_likwid_result(int instance, int num_values, ParameterValue* values)
 {
     int i = 0;
-    if (likwid_init == 0)
+    LikwidSession* session = __atomic_load_n(&current_session, __ATOMIC_ACQUIRE);
+    if (likwid_init == 0 || !session)
         return 0;
-    int loop = num_values > num_current_metric_ids ? num_current_metric_ids : num_values;
+    int loop = num_values > session->num_metric_ids ? session->num_metric_ids : num_values;
     int cpu = cpus[instance];
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Getting %d results from LIKWID counters for instance %d (CPU %d), loop, instance, cpu );
     for (i = 0; i < loop; i++)
     {
-        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Get result for LIKWID group %d metric %d and thread %d, current_group, current_metric_ids[i], instance)
-        double r = perfmon_getLastMetric(current_group, current_metric_ids[i], instance);
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Get result for LIKWID group %d metric %d and thread %d, session->gid, session->metric_ids[i], instance)
+        double r = perfmon_getLastMetric(session->gid, session->metric_ids[i], instance);
         ParameterValue *v = &values[i];
         v->type = LOOP_ADAPT_PARAMETER_TYPE_DOUBLE;
         v->value.dval = r;
@@ -3,244 +3,343 @@
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define LOOP_ADAPT_TIMER_HAS_TSC
+#endif
 
 #include <bstrlib.h>
 #include <bstrlib_helper.h>
 #include <likwid.h>
 
-#include <map.h>
+#include <error.h>
 #include <loop_adapt_parameter_value.h>
+#include <loop_adapt_padding.h>
+#include <loop_adapt_chunked_array.h>
+
+/* The timers are stored in a chunked array indexed by the instance, the
+ * chunks are allocated at setup. Between setup and result, the timer
+ * functions do not lock, allocate or print. */
 
-static Map_t timers = NULL;
+/* Duration of the TSC calibration against CLOCK_MONOTONIC_RAW in ns */
+#define LOOP_ADAPT_TIMER_TSC_CALIBRATION 10000000ULL
 
 typedef enum {
     TIMER_MEASUREMENT_LIKWID,
     TIMER_MEASUREMENT_REALTIME,
     TIMER_MEASUREMENT_MONOTONIC,
+    TIMER_MEASUREMENT_MONOTONIC_RAW,
     TIMER_MEASUREMENT_PROCESS_CPUTIME,
     TIMER_MEASUREMENT_THREAD_CPUTIME,
+    TIMER_MEASUREMENT_TSC,
     TIMER_MEASUREMENT_MAX
 } TimerMeasurementStyle;
 
-
 typedef struct {
-    double walltime;
-    TimerData timer;
+    char* name;
+    TimerMeasurementStyle style;
     clockid_t clockid;
-    struct timespec clockstart;
-    struct timespec clockstop;
+} TimerMeasurementClock;
+
+static TimerMeasurementClock timer_clocks[TIMER_MEASUREMENT_MAX] = {
+    {"LIKWID", TIMER_MEASUREMENT_LIKWID, CLOCK_MONOTONIC},
+    {"REALTIME", TIMER_MEASUREMENT_REALTIME, CLOCK_REALTIME},
+    {"MONOTONIC", TIMER_MEASUREMENT_MONOTONIC, CLOCK_MONOTONIC},
+    {"MONOTONIC_RAW", TIMER_MEASUREMENT_MONOTONIC_RAW, CLOCK_MONOTONIC_RAW},
+    {"PROCESS_CPUTIME", TIMER_MEASUREMENT_PROCESS_CPUTIME, CLOCK_PROCESS_CPUTIME_ID},
+    {"THREAD_CPUTIME", TIMER_MEASUREMENT_THREAD_CPUTIME, CLOCK_THREAD_CPUTIME_ID},
+    {"TSC", TIMER_MEASUREMENT_TSC, CLOCK_MONOTONIC_RAW},
+};
+
+typedef struct {
+    uint64_t start; /**< \brief Start stamp in ticks (TSC) or ns */
+    uint64_t ticks; /**< \brief Accumulated ticks or ns since setup */
+    double walltime; /**< \brief Accumulated time of the LIKWID timer */
+    double seconds_per_tick;
     TimerMeasurementStyle style;
-} TimerMeasurement;
+    clockid_t clockid;
+    int active; /**< \brief Set up at least once */
+    TimerData timer;
+    bstring configuration; /**< \brief Configuration resolved to style and clockid */
+} __attribute__((aligned(LOOP_ADAPT_CACHELINE_SIZE))) TimerMeasurement;
 
-static void _loop_adapt_destroy_timerdata(void* ptr)
+static LoopAdaptChunkedArray timer_instances = LOOP_ADAPT_CHUNKED_ARRAY_INITIALIZER(sizeof(TimerMeasurement));
+static int timer_initialized = 0;
+static double timer_tsc_seconds_per_tick = 0;
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint64_t _loop_adapt_timer_clock_ns(clockid_t clockid)
 {
-    free(ptr);
+    struct timespec ts;
+    clock_gettime(clockid, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef LOOP_ADAPT_TIMER_HAS_TSC
+static inline uint64_t _loop_adapt_timer_tsc()
+{
+    unsigned int aux = 0;
+    return __rdtscp(&aux);
+}
+
+/* The TSC is only usable as clock if it runs with constant rate in all
+ * power states (invariant TSC) */
+static int _loop_adapt_timer_tsc_invariant()
+{
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+    {
+        return 0;
+    }
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+    {
+        return 0;
+    }
+    return (edx >> 8) & 0x1;
+}
+
+/* Calibrate the TSC rate against CLOCK_MONOTONIC_RAW. Returns 0 if the TSC
+ * cannot be used */
+static double _loop_adapt_timer_tsc_calibrate()
+{
+    if (!_loop_adapt_timer_tsc_invariant())
+    {
+        return 0;
+    }
+    uint64_t ns_start = _loop_adapt_timer_clock_ns(CLOCK_MONOTONIC_RAW);
+    uint64_t tsc_start = _loop_adapt_timer_tsc();
+    uint64_t ns_stop = ns_start;
+    while (ns_stop - ns_start < LOOP_ADAPT_TIMER_TSC_CALIBRATION)
+    {
+        ns_stop = _loop_adapt_timer_clock_ns(CLOCK_MONOTONIC_RAW);
+    }
+    uint64_t tsc_stop = _loop_adapt_timer_tsc();
+    if (tsc_stop <= tsc_start)
+    {
+        return 0;
+    }
+    return ((double)(ns_stop - ns_start) * 1E-9) / (double)(tsc_stop - tsc_start);
 }
+#endif
 
 int loop_adapt_measurement_timer_init()
 {
-    int i = 0;
     timer_init();
-    init_imap(&timers, _loop_adapt_destroy_timerdata);
-/*    for (i = 0; i < num_instances; i++)*/
-/*    {*/
-/*        TimerMeasurement* timer = NULL;*/
-/*        timer = malloc(sizeof(TimerMeasurement));*/
-/*        if (timer)*/
-/*        {*/
-/*            timer->walltime = 0;*/
-/*            timer_reset(&timer->timer);*/
-/*            add_imap(timers, instances[i], (void*)timer);*/
-/*        }*/
-/*    }*/
+    timer_initialized = 1;
+    return 0;
+}
+
+static void _loop_adapt_timer_free(void* entry)
+{
+    bdestroy(((TimerMeasurement*)entry)->configuration);
 }
 
 void loop_adapt_measurement_timer_finalize()
 {
-    destroy_imap(timers);
+    loop_adapt_chunked_array_destroy(&timer_instances, _loop_adapt_timer_free);
+    timer_initialized = 0;
 }
 
+/* Get the timer of an instance, NULL if it was never set up */
+static inline TimerMeasurement* _loop_adapt_timer_get(int instance)
+{
+    return loop_adapt_chunked_array_get(&timer_instances, instance);
+}
+
+static int _loop_adapt_measurement_timer_resolve(bstring configuration, TimerMeasurementStyle* style, clockid_t* clockid)
+{
+    int i = 0;
+    for (i = 0; i < TIMER_MEASUREMENT_MAX; i++)
+    {
+        if (biseqcstr(configuration, timer_clocks[i].name) == 1)
+        {
+            *style = timer_clocks[i].style;
+            *clockid = timer_clocks[i].clockid;
+            return 0;
+        }
+    }
+    ERROR_PRINT(Unknown timer configuration %s, bdata(configuration));
+    return -EINVAL;
+}
 
 int loop_adapt_measurement_timer_setup(int instance, bstring configuration, bstring metrics)
 {
-    int newtimer = 0;
     TimerMeasurement* timer = NULL;
-    bstring likwid = bfromcstr("LIKWID");
-    bstring realtime = bfromcstr("REALTIME");
-    bstring monotonic = bfromcstr("MONOTONIC");
-    bstring pcpu = bfromcstr("PROCESS_CPUTIME");
-    bstring tcpu = bfromcstr("THREAD_CPUTIME");
     TimerMeasurementStyle style = TIMER_MEASUREMENT_MAX;
-    clockid_t clockid;
-    if (!timers)
+    clockid_t clockid = CLOCK_MONOTONIC;
+    if (!timer_initialized)
     {
-        fprintf(stderr, "Timer measurement module not initialized\n");
+        ERROR_PRINT(Timer measurement module not initialized);
         return -EINVAL;
     }
-
-    if (bstrncmp(configuration, likwid, blength(likwid)) == BSTR_OK)
-    {
-        style = TIMER_MEASUREMENT_LIKWID;
-    }
-    else if (bstrncmp(configuration, realtime, blength(realtime)) == BSTR_OK)
-    {
-        style = TIMER_MEASUREMENT_REALTIME;
-        clockid = CLOCK_REALTIME;
-    }
-    else if (bstrncmp(configuration, monotonic, blength(monotonic)) == BSTR_OK)
+    if (!configuration)
     {
-        style = TIMER_MEASUREMENT_MONOTONIC;
-        clockid = CLOCK_MONOTONIC;
+        return -EINVAL;
     }
-    else if (bstrncmp(configuration, pcpu, blength(pcpu)) == BSTR_OK)
+    // Padded, so the timer stamps of different instances (threads) do not
+    // share cache lines
+    timer = loop_adapt_chunked_array_get_or_create(&timer_instances, instance);
+    if (!timer)
     {
-        style = TIMER_MEASUREMENT_PROCESS_CPUTIME;
-        clockid = CLOCK_PROCESS_CPUTIME_ID;
+        return -ENOMEM;
     }
-    else if (bstrncmp(configuration, tcpu, blength(tcpu)) == BSTR_OK)
+
+    if (timer->configuration && biseq(timer->configuration, configuration) == 1)
     {
-        style = TIMER_MEASUREMENT_THREAD_CPUTIME;
-        clockid = CLOCK_THREAD_CPUTIME_ID;
+        // Same configuration as in the last cycle, the clock is already resolved
+        style = timer->style;
+        clockid = timer->clockid;
     }
     else
     {
-        printf("Unknown configuration %s\n", bdata(configuration));
-        return -EINVAL;
-    }
-
-    if (get_imap_by_key(timers, instance, (void**)&timer) != 0)
-    {
-        timer = malloc(sizeof(TimerMeasurement));
-        if (!timer)
+        if (_loop_adapt_measurement_timer_resolve(configuration, &style, &clockid) != 0)
         {
-            return -ENOMEM;
+            return -EINVAL;
         }
-        memset(timer, 0, sizeof(TimerMeasurement));
-        newtimer = 1;
-    }
-    if (timer)
-    {
-        if (style == TIMER_MEASUREMENT_LIKWID)
+        if (style == TIMER_MEASUREMENT_TSC)
         {
-            fprintf(stderr, "Setup new LIKWID timer for instance %d (conf: %s)\n", instance, bdata(configuration));
-            timer_reset(&timer->timer);
+#ifdef LOOP_ADAPT_TIMER_HAS_TSC
+            pthread_mutex_lock(&timer_lock);
+            if (timer_tsc_seconds_per_tick == 0)
+            {
+                timer_tsc_seconds_per_tick = _loop_adapt_timer_tsc_calibrate();
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, TSC calibrated to %f MHz, (timer_tsc_seconds_per_tick > 0 ? 1E-6/timer_tsc_seconds_per_tick : 0));
+            }
+            pthread_mutex_unlock(&timer_lock);
+#endif
+            if (timer_tsc_seconds_per_tick <= 0)
+            {
+                ERROR_PRINT(No invariant TSC available. Using MONOTONIC_RAW);
+                style = TIMER_MEASUREMENT_MONOTONIC_RAW;
+                clockid = CLOCK_MONOTONIC_RAW;
+            }
         }
-        else
+        if (timer->configuration)
         {
-            fprintf(stderr, "Setup new SYSTEM timer for instance %d (conf: %s)\n", instance, bdata(configuration));
-            timer->clockid = clockid;
-            timer->clockstart.tv_sec = 0;
-            timer->clockstart.tv_nsec = 0;
-            timer->clockstop.tv_sec = 0;
-            timer->clockstop.tv_nsec = 0;
+            bassign(timer->configuration, configuration);
         }
-        timer->walltime = 0;
-        timer->style = style;
-
-        if (newtimer)
+        else
         {
-            add_imap(timers, instance, (void*)timer);
+            timer->configuration = bstrcpy(configuration);
         }
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Setup timer for instance %d (conf: %s), instance, bdata(configuration));
     }
-    else
+
+    if (style == TIMER_MEASUREMENT_LIKWID)
     {
-        printf("Unknown timer\n");
+        timer_reset(&timer->timer);
     }
-
-    bdestroy(likwid);
-    bdestroy(realtime);
-    bdestroy(monotonic);
-    bdestroy(pcpu);
-    bdestroy(tcpu);
+    timer->style = style;
+    timer->clockid = clockid;
+    timer->seconds_per_tick = (style == TIMER_MEASUREMENT_TSC ? timer_tsc_seconds_per_tick : 1E-9);
+    timer->start = 0;
+    timer->ticks = 0;
+    timer->walltime = 0;
+    __atomic_store_n(&timer->active, 1, __ATOMIC_RELEASE);
     return 0;
 }
 
-void loop_adapt_measurement_timer_start(int instance)
+static inline void _loop_adapt_measurement_timer_start(TimerMeasurement* timer)
 {
-    TimerMeasurement* timer = NULL;
-    if (get_imap_by_key(timers, instance, (void**)&timer) == 0)
+    switch(timer->style)
     {
-        switch(timer->style)
-        {
-            case TIMER_MEASUREMENT_LIKWID:
-                fprintf(stderr, "Starting LIKWID timer for instance %d\n", instance);
-                timer_start(&timer->timer);
-                break;
-            case TIMER_MEASUREMENT_REALTIME:
-            case TIMER_MEASUREMENT_MONOTONIC:
-            case TIMER_MEASUREMENT_PROCESS_CPUTIME:
-            case TIMER_MEASUREMENT_THREAD_CPUTIME:
-                fprintf(stderr, "Starting SYSTEM timer for instance %d\n", instance);
-                clock_gettime(timer->clockid, &timer->clockstart);
-                break;
-        }
-
+        case TIMER_MEASUREMENT_LIKWID:
+            timer_start(&timer->timer);
+            break;
+#ifdef LOOP_ADAPT_TIMER_HAS_TSC
+        case TIMER_MEASUREMENT_TSC:
+            timer->start = _loop_adapt_timer_tsc();
+            break;
+#endif
+        default:
+            timer->start = _loop_adapt_timer_clock_ns(timer->clockid);
+            break;
     }
-
 }
 
-void loop_adapt_measurement_timer_startall_cb(mpointer key, mpointer value, mpointer userdata)
+static inline void _loop_adapt_measurement_timer_stop(TimerMeasurement* timer)
 {
-    int *instance = (int*)key;
-    loop_adapt_measurement_timer_start(*instance);
+    switch(timer->style)
+    {
+        case TIMER_MEASUREMENT_LIKWID:
+            timer_stop(&timer->timer);
+            timer->walltime += timer_print(&timer->timer);
+            timer_reset(&timer->timer);
+            break;
+#ifdef LOOP_ADAPT_TIMER_HAS_TSC
+        case TIMER_MEASUREMENT_TSC:
+            timer->ticks += _loop_adapt_timer_tsc() - timer->start;
+            break;
+#endif
+        default:
+            timer->ticks += _loop_adapt_timer_clock_ns(timer->clockid) - timer->start;
+            break;
+    }
 }
 
-void loop_adapt_measurement_timer_startall()
+void loop_adapt_measurement_timer_start(int instance)
 {
-    foreach_in_imap(timers, loop_adapt_measurement_timer_startall_cb, NULL);
+    TimerMeasurement* timer = _loop_adapt_timer_get(instance);
+    if (timer && timer->active)
+    {
+        _loop_adapt_measurement_timer_start(timer);
+    }
 }
-void loop_adapt_measurement_timer_stop(int instance)
+
+void loop_adapt_measurement_timer_startall()
 {
-    TimerMeasurement* timer = NULL;
-    if (get_imap_by_key(timers, instance, (void**)&timer) == 0)
+    int i = 0;
+    int size = loop_adapt_chunked_array_size(&timer_instances);
+    for (i = 0; i < size; i++)
     {
-        switch(timer->style)
+        TimerMeasurement* timer = _loop_adapt_timer_get(i);
+        if (timer && timer->active)
         {
-            case TIMER_MEASUREMENT_LIKWID:
-                fprintf(stderr, "Stopping LIKWID timer for instance %d\n", instance);
-                timer_stop(&timer->timer);
-                timer->walltime += timer_print(&timer->timer);
-                timer_reset(&timer->timer);
-                break;
-            case TIMER_MEASUREMENT_REALTIME:
-            case TIMER_MEASUREMENT_MONOTONIC:
-            case TIMER_MEASUREMENT_PROCESS_CPUTIME:
-            case TIMER_MEASUREMENT_THREAD_CPUTIME:
-                fprintf(stderr, "Stopping SYSTEM timer for instance %d\n", instance);
-                clock_gettime(timer->clockid, &timer->clockstop);
-                timer->walltime += (double)(timer->clockstop.tv_sec-timer->clockstart.tv_sec) +
-                                   ((double)(timer->clockstop.tv_nsec-timer->clockstart.tv_nsec)*1E-9);
-                timer->clockstart.tv_sec = 0;
-                timer->clockstart.tv_nsec = 0;
-                timer->clockstop.tv_sec = 0;
-                timer->clockstop.tv_nsec = 0;
-                break;
+            _loop_adapt_measurement_timer_start(timer);
         }
-
     }
-
 }
 
-void loop_adapt_measurement_timer_stopall_cb(mpointer key, mpointer value, mpointer userdata)
+void loop_adapt_measurement_timer_stop(int instance)
 {
-    int *instance = (int*)key;
-    loop_adapt_measurement_timer_stop(*instance);
+    TimerMeasurement* timer = _loop_adapt_timer_get(instance);
+    if (timer && timer->active)
+    {
+        _loop_adapt_measurement_timer_stop(timer);
+    }
 }
 
 void loop_adapt_measurement_timer_stopall()
 {
-    foreach_in_imap(timers, loop_adapt_measurement_timer_stopall_cb, NULL);
+    int i = 0;
+    int size = loop_adapt_chunked_array_size(&timer_instances);
+    for (i = 0; i < size; i++)
+    {
+        TimerMeasurement* timer = _loop_adapt_timer_get(i);
+        if (timer && timer->active)
+        {
+            _loop_adapt_measurement_timer_stop(timer);
+        }
+    }
 }
+
 int loop_adapt_measurement_timer_result(int instance, int num_values, ParameterValue* values)
 {
-    TimerMeasurement* timer = NULL;
-    if (get_imap_by_key(timers, instance, (void**)&timer) == 0)
+    TimerMeasurement* timer = _loop_adapt_timer_get(instance);
+    if (timer && timer->active && num_values > 0)
     {
         ParameterValue* v = &values[0];
         v->type = LOOP_ADAPT_PARAMETER_TYPE_DOUBLE;
-        v->value.dval = timer->walltime;
-        loop_adapt_print_param_value(*v);
+        if (timer->style == TIMER_MEASUREMENT_LIKWID)
+            v->value.dval = timer->walltime;
+        else
+            v->value.dval = (double)timer->ticks * timer->seconds_per_tick;
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Timer result for instance %d: %f, instance, v->value.dval);
         return 1;
     }
     return 0;
@@ -249,10 +348,10 @@ int loop_adapt_measurement_timer_result(int instance, int num_values, ParameterV
 
 int loop_adapt_measurement_timer_configs(struct bstrList* configs)
 {
-    bstrListAddChar(configs, "REALTIME");
-    bstrListAddChar(configs, "MONOTONIC");
-    bstrListAddChar(configs, "PROCESS_CPUTIME");
-    bstrListAddChar(configs, "THREAD_CPUTIME");
-    bstrListAddChar(configs, "LIKWID");
-    return 5;
+    int i = 0;
+    for (i = 0; i < TIMER_MEASUREMENT_MAX; i++)
+    {
+        bstrListAddChar(configs, timer_clocks[i].name);
+    }
+    return TIMER_MEASUREMENT_MAX;
 }
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <error.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include <map.h>
 
@@ -42,13 +43,27 @@
 #include <loop_adapt_parameter.h>
 
 #include <loop_adapt_hwloc_tree.h>
+#include <loop_adapt_internal.h>
 
-/*! \brief  This is the hwloc topology tree used for registering parameters */
-static hwloc_topology_t loop_adapt_parameter_tree = NULL;
+/*! \brief  Parameter lists of the topology objects. Each slot holds a ParameterList */
+static LoopAdaptTopologySlots loop_adapt_parameter_slots;
+static int loop_adapt_parameter_slots_init = 0;
+
+/* Get the parameter list of a thread for the scope at offset s in LoopAdaptScopeList */
+static inline ParameterList* _loop_adapt_parameter_thread_list(ThreadData_t thread, int s)
+{
+    void** slot = loop_adapt_hwloc_tree_slot_at(&loop_adapt_parameter_slots, s, thread->scopeOffsets[s]);
+    return (slot ? (ParameterList*)*slot : NULL);
+}
 static int loop_adapt_parameter_debug = 0;
 
 static ParameterDefinition* loop_adapt_active_parameters = NULL;
 static int loop_adapt_num_active_parameters = 0;
+/*! \brief  Serializes the lazy initialization of the parameters */
+static pthread_mutex_t loop_adapt_parameter_init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! \brief Interning table: parameter name -> parameter ID (index in loop_adapt_active_parameters) */
+static Map_t loop_adapt_parameter_ids = NULL;
 
 static char host_name[300];
 
@@ -83,6 +98,8 @@ static int _loop_adapt_copy_parameter_definition(ParameterDefinition* in, Parame
         out->set = in->set;
         out->avail = in->avail;
         out->finalize = in->finalize;
+        out->user = in->user;
+        out->initialized = 0;
         loop_adapt_copy_param_value(in->value, &out->value);
         loop_adapt_copy_param_value_limit(in->limit, &out->limit);
         return 0;
@@ -97,7 +114,72 @@ void _loop_adapt_free_parameter(mpointer val)
     {
         loop_adapt_destroy_param_value(p->value);
         loop_adapt_destroy_param_limit(p->limit);
+        free(p);
+    }
+}
+
+static inline Parameter_t _loop_adapt_parameter_at(ParameterList* list, int id)
+{
+    if (list && id >= 0 && id < list->size)
+    {
+        return list->parameters[id];
+    }
+    return NULL;
+}
+
+static int _loop_adapt_parameter_list_resize(ParameterList* list, int size)
+{
+    int i = 0;
+    if (size > list->size)
+    {
+        Parameter_t* params = realloc(list->parameters, size * sizeof(Parameter_t));
+        if (!params)
+        {
+            return -ENOMEM;
+        }
+        for (i = list->size; i < size; i++)
+        {
+            params[i] = NULL;
+        }
+        list->parameters = params;
+        list->size = size;
+    }
+    return 0;
+}
+
+int loop_adapt_parameter_id(char* name)
+{
+    int i = 0;
+    void* id = NULL;
+    if (!name)
+    {
+        return -EINVAL;
+    }
+    if (loop_adapt_parameter_ids)
+    {
+        if (get_smap_by_key(loop_adapt_parameter_ids, name, &id) == 0)
+        {
+            return (int)(intptr_t)id;
+        }
+        return -ENOENT;
+    }
+    for (i = 0; i < loop_adapt_num_active_parameters; i++)
+    {
+        if (strcmp(loop_adapt_active_parameters[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -ENOENT;
+}
+
+char* loop_adapt_parameter_name(int id)
+{
+    if (id >= 0 && id < loop_adapt_num_active_parameters)
+    {
+        return loop_adapt_active_parameters[id].name;
     }
+    return NULL;
 }
 
 static int _loop_adapt_add_parameter_to_tree(ParameterDefinition* def, int idx_in_list, ParameterValueLimit limit)
@@ -105,35 +187,39 @@ static int _loop_adapt_add_parameter_to_tree(ParameterDefinition* def, int idx_i
     int err = 0;
     int i = 0;
     int strlength = 0;
-    for (i = 0; i < hwloc_get_nbobjs_by_type(loop_adapt_parameter_tree, def->scope); i++)
+    err = add_smap(loop_adapt_parameter_ids, def->name, (void*)(intptr_t)idx_in_list);
+    if (err < 0)
     {
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, def->scope, i);
-        if (obj)
+        fprintf(stderr, "Failed to add parameter %s to the parameter IDs\n", def->name);
+        return -1;
+    }
+    for (i = 0; i < loop_adapt_hwloc_tree_count(def->scope); i++)
+    {
+        void** slot = loop_adapt_hwloc_tree_slot(&loop_adapt_parameter_slots, def->scope, i);
+        if (slot)
         {
-            Map_t params = (Map_t)obj->userdata;
+            ParameterList* params = (ParameterList*)*slot;
             if (!params)
             {
-                //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Creating parameter map for %s %d, hwloc_obj_type_string(def->scope), i);
-                err = init_smap(&params, _loop_adapt_free_parameter);
-                if (err != 0)
+                params = malloc(sizeof(ParameterList));
+                if (!params)
                 {
-                    fprintf(stderr, "Failed to create parameter hash map for %s %d\n", hwloc_obj_type_string(def->scope), i);
+                    fprintf(stderr, "Failed to create parameter list for %s %d\n", hwloc_obj_type_string(def->scope), i);
                     return -1;
                 }
-                else
-                {;
-                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Creating parameter map for %s %d successful, hwloc_obj_type_string(def->scope), i);
-                }
+                memset(params, 0, sizeof(ParameterList));
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Creating parameter list for %s %d successful, hwloc_obj_type_string(def->scope), i);
+                *slot = (void*)params;
             }
-            else
+            if (_loop_adapt_parameter_list_resize(params, idx_in_list + 1) != 0)
             {
-                //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Parameter map for %s %d already exists, hwloc_obj_type_string(def->scope), i);
+                fprintf(stderr, "Failed to resize parameter list for %s %d\n", hwloc_obj_type_string(def->scope), i);
+                return -1;
             }
-            Parameter_t p = NULL;
-            err = get_smap_by_key(params, def->name, (void**)&p);
-            if (err == 0)
+            Parameter_t p = params->parameters[idx_in_list];
+            if (p)
             {
-                fprintf(stderr, "Failed to create parameter %s for %s %d: already in hash\n", def->name, hwloc_obj_type_string(def->scope), i);
+                fprintf(stderr, "Failed to create parameter %s for %s %d: already in list\n", def->name, hwloc_obj_type_string(def->scope), i);
                 return -1;
             }
             p = _loop_adapt_new_parameter();
@@ -152,13 +238,9 @@ static int _loop_adapt_add_parameter_to_tree(ParameterDefinition* def, int idx_i
                 }
 
                 //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Adding parameter '%s' to %s %d, def->name, hwloc_obj_type_string(def->scope), i);
-                err = add_smap(params, def->name,(void*) p);
-                if (err < 0)
-                {
-                    printf("Addition failed\n");
-                }
+                params->parameters[idx_in_list] = p;
+                params->count++;
             }
-            obj->userdata = (void*)params;
         }
     }
     return 0;
@@ -166,15 +248,25 @@ static int _loop_adapt_add_parameter_to_tree(ParameterDefinition* def, int idx_i
 
 int loop_adapt_parameter_initialize()
 {
-    if (!loop_adapt_parameter_tree)
+    if (!loop_adapt_parameter_ids)
+    {
+        int err = init_smap(&loop_adapt_parameter_ids, NULL);
+        if (err)
+        {
+            ERROR_PRINT(Failed to create parameter ID table);
+            return -1;
+        }
+    }
+    if (!loop_adapt_parameter_slots_init)
     {
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize parameter tree);
-        int err = loop_adapt_copy_hwloc_tree(&loop_adapt_parameter_tree);
+        int err = loop_adapt_hwloc_tree_slots_init(&loop_adapt_parameter_slots);
         if (err)
         {
-            ERROR_PRINT(Failed to get copy of hwloc tree for parameter tree);
+            ERROR_PRINT(Failed to initialize slots of hwloc tree for parameter tree);
             return -1;
         }
+        loop_adapt_parameter_slots_init = 1;
     }
     int pd_idx = 0;
     ParameterValueLimit limit;
@@ -202,40 +294,79 @@ int loop_adapt_parameter_initialize()
 
 
         pd = &loop_adapt_active_parameters[loop_adapt_num_active_parameters];
-        if (in->init)
+        _loop_adapt_copy_parameter_definition(in, out);
+        if (out->avail)
         {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initializing parameter %s for scope %s, in->name, hwloc_obj_type_string(in->scope));
-            int err = in->init();
+            // The limits are available after the lazy initialization in
+            // loop_adapt_parameter_init_id()
+            out->limit.type = LOOP_ADAPT_PARAMETER_LIMIT_TYPE_INVALID;
+        }
+        _loop_adapt_add_parameter_to_tree(pd, loop_adapt_num_active_parameters, pd->limit);
+        loop_adapt_num_active_parameters++;
+    }
+    gethostname(host_name, 300);
+/*    loop_adapt_parameter_names = bstrListCreate();*/
+}
+
+int loop_adapt_parameter_init_id(int id)
+{
+    int i = 0;
+    int state = 0;
+    ParameterDefinition* pd = NULL;
+    if (id < 0 || id >= loop_adapt_num_active_parameters)
+    {
+        return -EINVAL;
+    }
+    pd = &loop_adapt_active_parameters[id];
+    state = __atomic_load_n(&pd->initialized, __ATOMIC_ACQUIRE);
+    if (state != 0)
+    {
+        return (state > 0 ? 0 : state);
+    }
+    pthread_mutex_lock(&loop_adapt_parameter_init_lock);
+    if (pd->initialized == 0)
+    {
+        double start = loop_adapt_timestamp();
+        state = 1;
+        if (pd->init)
+        {
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initializing parameter %s for scope %s, pd->name, hwloc_obj_type_string(pd->scope));
+            int err = pd->init();
             if (err)
             {
-                ERROR_PRINT(Initializing parameter %s for scope %s failed: %d, in->name, hwloc_obj_type_string(in->scope), err);
+                ERROR_PRINT(Initializing parameter %s for scope %s failed: %d, pd->name, hwloc_obj_type_string(pd->scope), err);
+                state = (err < 0 ? err : -EFAULT);
             }
         }
-        // if (pd->get)
-        // {
-        //     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Get current value for parameter %s for scope %s, in->name, hwloc_obj_type_string(in->scope));
-        //     int err = pd->get(0, &pd->value);
-        //     if (err)
-        //     {
-        //         ERROR_PRINT(Getting current value for parameter %s for scope %s failed: %d, in->name, hwloc_obj_type_string(in->scope), err);
-        //     }
-        //     loop_adapt_print_param_value(pd->value);
-        // }
-        if (in->avail)
+        if (state > 0 && pd->avail)
         {
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Get limits for parameter %s for scope %s, in->name, hwloc_obj_type_string(in->scope));
-            int err = in->avail(0, &in->limit);
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Get limits for parameter %s for scope %s, pd->name, hwloc_obj_type_string(pd->scope));
+            int err = pd->avail(0, &pd->limit);
             if (err)
             {
-                ERROR_PRINT(Get limits for parameter %s for scope %s failed, in->name, hwloc_obj_type_string(in->scope));
+                ERROR_PRINT(Get limits for parameter %s for scope %s failed, pd->name, hwloc_obj_type_string(pd->scope));
+                pd->limit.type = LOOP_ADAPT_PARAMETER_LIMIT_TYPE_INVALID;
+            }
+            else
+            {
+                // Parameters at the objects got no limits at registration
+                for (i = 0; i < loop_adapt_hwloc_tree_count(pd->scope); i++)
+                {
+                    void** slot = loop_adapt_hwloc_tree_slot(&loop_adapt_parameter_slots, pd->scope, i);
+                    Parameter_t p = (slot ? _loop_adapt_parameter_at((ParameterList*)*slot, id) : NULL);
+                    if (p && p->limit.type == LOOP_ADAPT_PARAMETER_LIMIT_TYPE_INVALID)
+                    {
+                        loop_adapt_copy_param_value_limit(pd->limit, &p->limit);
+                    }
+                }
             }
         }
-        _loop_adapt_copy_parameter_definition(in, out);
-        _loop_adapt_add_parameter_to_tree(pd, loop_adapt_num_active_parameters, pd->limit);
-        loop_adapt_num_active_parameters++;
+        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Init of parameter %s took %.3f ms, pd->name, 1E3 * (loop_adapt_timestamp() - start));
+        __atomic_store_n(&pd->initialized, state, __ATOMIC_RELEASE);
     }
-    gethostname(host_name, 300);
-/*    loop_adapt_parameter_names = bstrListCreate();*/
+    state = pd->initialized;
+    pthread_mutex_unlock(&loop_adapt_parameter_init_lock);
+    return (state > 0 ? 0 : state);
 }
 
 int loop_adapt_parameter_add(char* name, LoopAdaptScope_t scope,
@@ -267,6 +398,10 @@ int loop_adapt_parameter_add(char* name, LoopAdaptScope_t scope,
     def->set = set;
     def->get = get;
     def->avail = avail;
+    def->finalize = NULL;
+    def->init = NULL;
+    def->user = 0;
+    def->initialized = 1;
     ParameterValue value;
     value.type = valuetype;
 
@@ -331,11 +466,14 @@ int loop_adapt_parameter_add_user(char* name, LoopAdaptScope_t scope, ParameterV
     def->scope = scope;
 
     def->user = 1;
+    def->init = NULL;
+    def->initialized = 1;
     loop_adapt_copy_param_value(value, &def->value);
 
     def->set = NULL;
     def->get = NULL;
     def->avail = NULL;
+    def->finalize = NULL;
     def->limit.type = LOOP_ADAPT_PARAMETER_LIMIT_TYPE_INVALID;
 
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Adding user parameter %s of type %s, def->name, loop_adapt_print_param_valuetype(def->value.type));
@@ -373,11 +511,14 @@ int loop_adapt_parameter_add_user_with_limit(char* name, LoopAdaptScope_t scope,
     def->scope = scope;
 
     def->user = 1;
+    def->init = NULL;
+    def->initialized = 1;
     loop_adapt_copy_param_value(value, &def->value);
 
     def->set = NULL;
     def->get = NULL;
     def->avail = NULL;
+    def->finalize = NULL;
     loop_adapt_copy_param_value_limit(limit, &def->limit);
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Adding user parameter %s of type %s, def->name, loop_adapt_print_param_valuetype(def->value.type));
 
@@ -387,59 +528,52 @@ int loop_adapt_parameter_add_user_with_limit(char* name, LoopAdaptScope_t scope,
     return 0;
 }
 
-ParameterValueType_t loop_adapt_parameter_type(char* name)
+ParameterValueType_t loop_adapt_parameter_type_id(int id)
 {
-    int i = 0;
-    ParameterDefinition* def = NULL;
-    for (i = 0; i < loop_adapt_num_active_parameters; i++)
+    if (id >= 0 && id < loop_adapt_num_active_parameters)
     {
-        def = &loop_adapt_active_parameters[i];
-        if (!def) break;
-        if (strncmp(def->name, name, strlen(def->name)) == 0)
-        {
-            return def->value.type;
-        }
+        return loop_adapt_active_parameters[id].value.type;
     }
     return LOOP_ADAPT_PARAMETER_TYPE_INVALID;
 }
 
-LoopAdaptScope_t loop_adapt_parameter_scope(char* name)
+ParameterValueType_t loop_adapt_parameter_type(char* name)
 {
-    int i = 0;
-    ParameterDefinition* def = NULL;
-    for (i = 0; i < loop_adapt_num_active_parameters; i++)
+    return loop_adapt_parameter_type_id(loop_adapt_parameter_id(name));
+}
+
+LoopAdaptScope_t loop_adapt_parameter_scope_id(int id)
+{
+    if (id >= 0 && id < loop_adapt_num_active_parameters)
     {
-        def = &loop_adapt_active_parameters[i];
-        if (!def) break;
-        if (strncmp(def->name, name, strlen(def->name)) == 0)
-        {
-            return def->scope;
-        }
+        return loop_adapt_active_parameters[id].scope;
     }
     return LOOP_ADAPT_SCOPE_MAX;
 }
 
-int loop_adapt_parameter_scope_count(char* name)
+LoopAdaptScope_t loop_adapt_parameter_scope(char* name)
 {
-    int i = 0;
-    ParameterDefinition* def = NULL;
-    for (i = 0; i < loop_adapt_num_active_parameters; i++)
+    return loop_adapt_parameter_scope_id(loop_adapt_parameter_id(name));
+}
+
+int loop_adapt_parameter_scope_count_id(int id)
+{
+    if (id >= 0 && id < loop_adapt_num_active_parameters)
     {
-        def = &loop_adapt_active_parameters[i];
-        if (!def) break;
-        if (strncmp(def->name, name, strlen(def->name)) == 0)
-        {
-            return hwloc_get_nbobjs_by_type(loop_adapt_parameter_tree, def->scope);
-        }
+        return loop_adapt_hwloc_tree_count(loop_adapt_active_parameters[id].scope);
     }
     return 0;
 }
 
+int loop_adapt_parameter_scope_count(char* name)
+{
+    return loop_adapt_parameter_scope_count_id(loop_adapt_parameter_id(name));
+}
+
 void loop_adapt_parameter_finalize()
 {
     int i = 0;
     int j = 0;
-    int err = 0;
     int pd_idx = 0;
 
     if (loop_adapt_num_active_parameters > 0)
@@ -448,31 +582,33 @@ void loop_adapt_parameter_finalize()
         for (i = 0; i < loop_adapt_num_active_parameters; i++)
         {
             ParameterDefinition* pd = &loop_adapt_active_parameters[i];
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Delete parameter %s for scope %s (%d objects), pd->name, hwloc_obj_type_string(pd->scope), hwloc_get_nbobjs_by_type(loop_adapt_parameter_tree, pd->scope));
-            for (j = 0; j < hwloc_get_nbobjs_by_type(loop_adapt_parameter_tree, pd->scope); j++)
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Delete parameter %s for scope %s (%d objects), pd->name, hwloc_obj_type_string(pd->scope), loop_adapt_hwloc_tree_count(pd->scope));
+            for (j = 0; j < loop_adapt_hwloc_tree_count(pd->scope); j++)
             {
-                hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, pd->scope, j);
+                void** slot = loop_adapt_hwloc_tree_slot(&loop_adapt_parameter_slots, pd->scope, j);
 
-                if (obj)
+                if (slot)
                 {
-                    Map_t params = (Map_t)obj->userdata;
+                    ParameterList* params = (ParameterList*)*slot;
                     if (!params) continue;
-                    Parameter_t p = NULL;
-                    err = get_smap_by_key(params, pd->name, (void**)&p);
-                    if (err == 0)
+                    Parameter_t p = _loop_adapt_parameter_at(params, i);
+                    if (p)
                     {
-                        //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Delete parameter %s from map at %s %d/%d, pd->name, hwloc_obj_type_string(pd->scope), obj->logical_index, j);
-                        del_smap(params, pd->name);
-                        if (get_smap_size(params) == 0)
+                        //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Delete parameter %s from list at %s %d, pd->name, hwloc_obj_type_string(pd->scope), j);
+                        _loop_adapt_free_parameter(p);
+                        params->parameters[i] = NULL;
+                        params->count--;
+                        if (params->count == 0)
                         {
-                            destroy_smap(params);
-                            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Delete map at %s %d/%d, hwloc_obj_type_string(pd->scope), obj->logical_index, j);
-                            obj->userdata = NULL;
+                            free(params->parameters);
+                            free(params);
+                            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Delete list at %s %d, hwloc_obj_type_string(pd->scope), j);
+                            *slot = NULL;
                         }
                     }
                     else
                     {
-                        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, No parameter %s in map at %s %d/%d, pd->name, hwloc_obj_type_string(pd->scope), obj->logical_index, j);
+                        DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, No parameter %s in map at %s %d, pd->name, hwloc_obj_type_string(pd->scope), j);
                     }
                 }
                 else
@@ -481,7 +617,7 @@ void loop_adapt_parameter_finalize()
                 }
             }
             free(pd->name);
-            if (pd->finalize)
+            if (pd->finalize && pd->initialized > 0)
             {
                 pd->finalize();
             }
@@ -494,11 +630,16 @@ void loop_adapt_parameter_finalize()
         loop_adapt_active_parameters = NULL;
         loop_adapt_num_active_parameters = 0;
     }
-    if (loop_adapt_parameter_tree)
+    if (loop_adapt_parameter_slots_init)
     {
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Free parameter tree);
-        hwloc_topology_destroy(loop_adapt_parameter_tree);
-        loop_adapt_parameter_tree = NULL;
+        loop_adapt_hwloc_tree_slots_destroy(&loop_adapt_parameter_slots);
+        loop_adapt_parameter_slots_init = 0;
+    }
+    if (loop_adapt_parameter_ids)
+    {
+        destroy_smap(loop_adapt_parameter_ids);
+        loop_adapt_parameter_ids = NULL;
     }
 /*    if (loop_adapt_parameter_names)*/
 /*    {*/
@@ -508,12 +649,17 @@ void loop_adapt_parameter_finalize()
 }
 
 
-int loop_adapt_parameter_set(ThreadData_t thread, char* parameter, ParameterValue value)
+int loop_adapt_parameter_set_id(ThreadData_t thread, int id, ParameterValue value)
 {
+    char* parameter = loop_adapt_parameter_name(id);
     if ((!thread) || (!parameter))
     {
         return -EINVAL;
     }
+    if (loop_adapt_parameter_init_id(id) != 0)
+    {
+        return -ENODEV;
+    }
     if (value.type < LOOP_ADAPT_PARAMETER_VALUE_TYPE_MIN || value.type >= LOOP_ADAPT_PARAMETER_TYPE_MAX)
     {
         return -EINVAL;
@@ -521,18 +667,12 @@ int loop_adapt_parameter_set(ThreadData_t thread, char* parameter, ParameterValu
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Trying to set parameter %s for thread %d, parameter, thread->thread);
     for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
     {
-        if (thread->scopeOffsets[s] < 0) continue;
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-        if (obj)
+        ParameterList* params = _loop_adapt_parameter_thread_list(thread, s);
+        if (params)
         {
-            Parameter_t p = NULL;
-            Map_t params = (Map_t)obj->userdata;
-            if (!params)
-            {
-                continue;
-            }
-            int err = get_smap_by_key(params, parameter, (void**)&p);
-            if (err == 0)
+            int err = 0;
+            Parameter_t p = _loop_adapt_parameter_at(params, id);
+            if (p)
             {
                 if (value.type == p->value.type)
                 {
@@ -568,30 +708,32 @@ int loop_adapt_parameter_set(ThreadData_t thread, char* parameter, ParameterValu
     return 0;
 }
 
-int loop_adapt_parameter_get(ThreadData_t thread, char* parameter, ParameterValue* value)
+int loop_adapt_parameter_set(ThreadData_t thread, char* parameter, ParameterValue value)
+{
+    return loop_adapt_parameter_set_id(thread, loop_adapt_parameter_id(parameter), value);
+}
+
+int loop_adapt_parameter_get_id(ThreadData_t thread, int id, ParameterValue* value)
 {
+    char* parameter = loop_adapt_parameter_name(id);
     if ((!thread) || (!parameter) || (!value))
     {
         return -EINVAL;
     }
+    if (loop_adapt_parameter_init_id(id) != 0)
+    {
+        return -ENODEV;
+    }
     for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
     {
-        if (thread->scopeOffsets[s] < 0) continue;
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-        if (obj)
+        ParameterList* params = _loop_adapt_parameter_thread_list(thread, s);
+        if (params)
         {
-            Parameter_t p = NULL;
-            Map_t params = (Map_t)obj->userdata;
-            if (!params)
-            {
-                continue;
-            }
-            int err = get_smap_by_key(params, parameter, (void**)&p);
-            if (err == 0)
+            Parameter_t p = _loop_adapt_parameter_at(params, id);
+            if (p)
             {
                 DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Getting parameter %s at %s %d, parameter, hwloc_obj_type_string(LoopAdaptScopeList[s]), thread->scopeOffsets[s]);
                 loop_adapt_copy_param_value(p->value, value);
-                loop_adapt_print_param_value(*value);
                 value->type = p->value.type;
             }
         }
@@ -599,26 +741,29 @@ int loop_adapt_parameter_get(ThreadData_t thread, char* parameter, ParameterValu
     return 0;
 }
 
-int loop_adapt_parameter_getcurrent(ThreadData_t thread, char* parameter, ParameterValue* value)
+int loop_adapt_parameter_get(ThreadData_t thread, char* parameter, ParameterValue* value)
+{
+    return loop_adapt_parameter_get_id(thread, loop_adapt_parameter_id(parameter), value);
+}
+
+int loop_adapt_parameter_getcurrent_id(ThreadData_t thread, int id, ParameterValue* value)
 {
+    char* parameter = loop_adapt_parameter_name(id);
     if ((!thread) || (!parameter) || (!value))
     {
         return -EINVAL;
     }
+    if (loop_adapt_parameter_init_id(id) != 0)
+    {
+        return -ENODEV;
+    }
     for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
     {
-        if (thread->scopeOffsets[s] < 0) continue;
-        hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-        if (obj)
+        ParameterList* params = _loop_adapt_parameter_thread_list(thread, s);
+        if (params)
         {
-            Parameter_t p = NULL;
-            Map_t params = (Map_t)obj->userdata;
-            if (!params)
-            {
-                continue;
-            }
-            int err = get_smap_by_key(params, parameter, (void**)&p);
-            if (err == 0)
+            Parameter_t p = _loop_adapt_parameter_at(params, id);
+            if (p)
             {
                 ParameterValue v;
                 parameter_get_function f = loop_adapt_active_parameters[p->param_list_idx].get;
@@ -636,6 +781,11 @@ int loop_adapt_parameter_getcurrent(ThreadData_t thread, char* parameter, Parame
     return 0;
 }
 
+int loop_adapt_parameter_getcurrent(ThreadData_t thread, char* parameter, ParameterValue* value)
+{
+    return loop_adapt_parameter_getcurrent_id(thread, loop_adapt_parameter_id(parameter), value);
+}
+
 int loop_adapt_parameter_getnames(int* count, char*** parameters)
 {
     int i = 0, j = 0;
@@ -735,6 +885,10 @@ int loop_adapt_parameter_configs(struct bstrList* configs)
     for (i = 0; i < loop_adapt_num_active_parameters; i++)
     {
         ParameterDefinition* pd = &loop_adapt_active_parameters[i];
+        if (loop_adapt_parameter_init_id(i) != 0)
+        {
+            continue;
+        }
         if (pd->limit.type == LOOP_ADAPT_PARAMETER_LIMIT_TYPE_INVALID && pd->avail)
         {
             ParameterValueLimit limit = DEC_NEW_INVALID_PARAM_LIMIT;
@@ -789,20 +943,18 @@ int loop_adapt_parameter_loop_start(ThreadData_t thread)
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Save parameter values at start);
     for (i = 0; i < loop_adapt_num_active_parameters; i++)
     {
+        // Parameters which were never used are not touched
+        if (__atomic_load_n(&loop_adapt_active_parameters[i].initialized, __ATOMIC_ACQUIRE) <= 0)
+        {
+            continue;
+        }
         for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
         {
-            if (thread->scopeOffsets[s] < 0) continue;
-            hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-            if (obj)
+            ParameterList* params = _loop_adapt_parameter_thread_list(thread, s);
+            if (params)
             {
-                Parameter_t p = NULL;
-                Map_t params = (Map_t)obj->userdata;
-                if (!params)
-                {
-                    continue;
-                }
-                int err = get_smap_by_key(params, loop_adapt_active_parameters[i].name, (void**)&p);
-                if (err == 0)
+                Parameter_t p = _loop_adapt_parameter_at(params, i);
+                if (p)
                 {
                     ParameterValue v;
                     parameter_get_function f = loop_adapt_active_parameters[p->param_list_idx].get;
@@ -829,25 +981,23 @@ int loop_adapt_parameter_loop_end(ThreadData_t thread, struct bstrList* looppara
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Restore parameter values at end);
     for (i = 0; i < loop_adapt_num_active_parameters; i++)
     {
-        bstring pname = bfromcstr(loop_adapt_active_parameters[i].name);
+        if (__atomic_load_n(&loop_adapt_active_parameters[i].initialized, __ATOMIC_ACQUIRE) <= 0)
+        {
+            continue;
+        }
+        struct tagbstring pname;
+        btfromcstr(pname, loop_adapt_active_parameters[i].name);
         for (j = 0; j < loopparams->qty; j++)
         {
-            if (bstrncmp(pname, loopparams->entry[j], blength(pname)) == BSTR_OK)
+            if (bstrncmp(&pname, loopparams->entry[j], blength(&pname)) == BSTR_OK)
             {
                 for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
                 {
-                    if (thread->scopeOffsets[s] < 0) continue;
-                    hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-                    if (obj)
+                    ParameterList* params = _loop_adapt_parameter_thread_list(thread, s);
+                    if (params)
                     {
-                        Parameter_t p = NULL;
-                        Map_t params = (Map_t)obj->userdata;
-                        if (!params)
-                        {
-                            continue;
-                        }
-                        int err = get_smap_by_key(params, loop_adapt_active_parameters[i].name, (void**)&p);
-                        if (err == 0)
+                        Parameter_t p = _loop_adapt_parameter_at(params, i);
+                        if (p)
                         {
                             parameter_set_function f = loop_adapt_active_parameters[p->param_list_idx].set;
                             if (f)
@@ -860,7 +1010,6 @@ int loop_adapt_parameter_loop_end(ThreadData_t thread, struct bstrList* looppara
                 break;
             }
         }
-        bdestroy(pname);
     }
     return 0;
 }
@@ -878,18 +1027,11 @@ int loop_adapt_parameter_loop_best(ThreadData_t thread, ParameterValue v)
     {
         for (int s = 0; s < LOOP_ADAPT_NUM_SCOPES; s++)
         {
-            if (thread->scopeOffsets[s] < 0) continue;
-            hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_parameter_tree, LoopAdaptScopeList[s], thread->scopeOffsets[s]);
-            if (obj)
+            ParameterList* params = _loop_adapt_parameter_thread_list(thread, s);
+            if (params)
             {
-                Parameter_t p = NULL;
-                Map_t params = (Map_t)obj->userdata;
-                if (!params)
-                {
-                    continue;
-                }
-                int err = get_smap_by_key(params, loop_adapt_active_parameters[i].name, (void**)&p);
-                if (err == 0)
+                Parameter_t p = _loop_adapt_parameter_at(params, i);
+                if (p)
                 {
                     loop_adapt_copy_param_value(v, &p->init);
                 }
@@ -215,9 +215,38 @@ char* loop_adapt_print_param_valuetype(ParameterValueType_t t)
     return NULL;
 }
 
+int loop_adapt_param_value_snprintf(char* s, size_t len, ParameterValue v)
+{
+    switch(v.type)
+    {
+        case LOOP_ADAPT_PARAMETER_TYPE_INT:
+            return snprintf(s, len, "%d", v.value.ival);
+        case LOOP_ADAPT_PARAMETER_TYPE_UINT:
+            return snprintf(s, len, "%u", v.value.uval);
+        case LOOP_ADAPT_PARAMETER_TYPE_LONG:
+            return snprintf(s, len, "%ld", v.value.lval);
+        case LOOP_ADAPT_PARAMETER_TYPE_ULONG:
+            return snprintf(s, len, "%lu", v.value.ulval);
+        case LOOP_ADAPT_PARAMETER_TYPE_DOUBLE:
+            return snprintf(s, len, "%f", v.value.dval);
+        case LOOP_ADAPT_PARAMETER_TYPE_FLOAT:
+            return snprintf(s, len, "%f", v.value.fval);
+        case LOOP_ADAPT_PARAMETER_TYPE_BOOL:
+            return snprintf(s, len, "%u", v.value.bval);
+        case LOOP_ADAPT_PARAMETER_TYPE_CHAR:
+            return snprintf(s, len, "%c", v.value.cval);
+        case LOOP_ADAPT_PARAMETER_TYPE_STR:
+            return snprintf(s, len, "%s", v.value.sval);
+        case LOOP_ADAPT_PARAMETER_TYPE_PTR:
+            return snprintf(s, len, "%p", v.value.pval);
+        default:
+            return snprintf(s, len, "INVALID");
+    }
+    return 0;
+}
+
 char* loop_adapt_param_value_str(ParameterValue v)
 {
-    int ret = 0;
     int slen = 51;
     if (v.type == LOOP_ADAPT_PARAMETER_TYPE_STR)
     {
@@ -226,46 +255,7 @@ char* loop_adapt_param_value_str(ParameterValue v)
     char *s = malloc(slen * sizeof(char));
     if (s)
     {
-        switch(v.type)
-        {
-            case LOOP_ADAPT_PARAMETER_TYPE_INT:
-                ret = snprintf(s, slen-1, "%d", v.value.ival);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_UINT:
-                ret = snprintf(s, slen-1, "%u", v.value.uval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_LONG:
-                ret = snprintf(s, slen-1, "%ld", v.value.lval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_ULONG:
-                ret = snprintf(s, slen-1, "%lu", v.value.ulval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_DOUBLE:
-                ret = snprintf(s, slen-1, "%f", v.value.dval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_FLOAT:
-                ret = snprintf(s, slen-1, "%f", v.value.fval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_BOOL:
-                ret = snprintf(s, slen-1, "%u", v.value.bval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_CHAR:
-                ret = snprintf(s, slen-1, "%c", v.value.cval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_STR:
-                ret = snprintf(s, slen, "%s", v.value.sval);
-                break;
-            case LOOP_ADAPT_PARAMETER_TYPE_PTR:
-                ret = snprintf(s, slen, "%p", v.value.pval);
-                break;
-            default:
-                ret = snprintf(s, slen, "INVALID");
-                break;
-        }
-        if (ret >= 0)
-        {
-            s[ret] = '\0';
-        }
+        loop_adapt_param_value_snprintf(s, slen, v);
     }
     return s;
 }
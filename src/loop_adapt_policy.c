@@ -6,6 +6,7 @@
 #include <error.h>
 #include <loop_adapt_internal.h>
 #include <loop_adapt_parameter_value_types.h>
+#include <loop_adapt_measurement.h>
 
 #include <loop_adapt_policy_list.h>
 
@@ -23,6 +24,7 @@ int _loop_adapt_copy_policy(_PolicyDefinition *in, PolicyDefinition* out)
     {
         out->name = bfromcstr(in->name);
         out->backend = bfromcstr(in->backend);
+        out->backend_id = loop_adapt_measurement_id(in->backend);
         out->config = bfromcstr(in->config);
         out->match = bfromcstr(in->match);
         out->eval = in->eval;
@@ -114,6 +116,7 @@ int loop_adapt_register_policy(char* name, char* backend, char* config, char* ma
         tmp = &loop_adapt_active_policy[loop_adapt_num_active_policy];
         tmp->name = bfromcstr(name);
         tmp->backend = bfromcstr(backend);
+        tmp->backend_id = loop_adapt_measurement_id(backend);
         tmp->config = bfromcstr(config);
         tmp->match = bfromcstr(match);
         tmp->eval = func;
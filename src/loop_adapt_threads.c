@@ -22,35 +22,126 @@
 #define gettid() syscall(SYS_gettid)
 
 static Map_t loop_adapt_threads = NULL;
+/*! \brief  List of registered threads indexed by the registration index.
+ *
+ *  The list is read without lock. Registration appends under
+ *  loop_adapt_threads_lock and publishes the new entry by incrementing count
+ *  (release). If the list is full, a larger copy is published and the old one
+ *  is kept in the prev chain until finalization, so readers never see freed
+ *  memory. */
+typedef struct ThreadList {
+    int count;
+    int size;
+    struct ThreadList* prev;
+    ThreadData_t threads[];
+} ThreadList;
+static ThreadList* loop_adapt_threads_list = NULL;
+/*! \brief  Shared topology tree (not owned by the thread storage) */
 static hwloc_topology_t loop_adapt_threads_tree = NULL;
 pthread_mutex_t loop_adapt_threads_lock = PTHREAD_MUTEX_INITIALIZER;
 /*! \brief  Taskset of the application */
 static cpu_set_t loop_adapt_threads_cpuset;
 static cpu_set_t loop_adapt_threads_cpuset_inuse;
+/*! \brief  Next PU (logical index) for a thread on a synthetic topology */
+static int loop_adapt_threads_next_pu = 0;
 /*! \brief  Taskset of the master thread of the application */
 /*static cpu_set_t loop_adapt_cpuset_master;*/
 
 static int MPIrank = -1;
 
+/*! \brief  Thread-local pointer to the ThreadData of the calling thread. It
+ *  avoids the lookup in the threads hash map with pthread_self() */
+static __thread ThreadData_t loop_adapt_threads_self = NULL;
+/*! \brief  Generation of the thread-local pointer. It is only valid if it
+ *  matches loop_adapt_threads_generation */
+static __thread int loop_adapt_threads_self_generation = 0;
+/*! \brief  Generation counter, incremented at finalization to invalidate all
+ *  thread-local pointers */
+static int loop_adapt_threads_generation = 1;
+
 
 static int (*in_parallel)(void) = NULL;
 
 static ThreadData_t _loop_adapt_new_threaddata()
 {
-    ThreadData_t tdata = malloc(sizeof(ThreadData));
+    // Called by the registering thread, so the thread data is first touched
+    // by its owner
+    ThreadData_t tdata = loop_adapt_padded_alloc(sizeof(ThreadData));
     if (!tdata)
     {
         fprintf(stderr, "ERROR: Cannot allocate new thread data\n");
         return NULL;
     }
-    memset(tdata, 0, sizeof(ThreadData));
     pthread_mutex_init(&tdata->lock, NULL);
 
+    tdata->index = -1;
     tdata->objidx = -1;
     tdata->cpu = -1;
     return tdata;
 }
 
+/* Append a thread to the published thread list. The caller has to hold
+ * loop_adapt_threads_lock */
+static int _loop_adapt_threads_list_append(ThreadData_t tdata)
+{
+    ThreadList* list = loop_adapt_threads_list;
+    if (!list || list->count == list->size)
+    {
+        int size = (list ? 2 * list->size : 16);
+        ThreadList* newlist = malloc(sizeof(ThreadList) + size * sizeof(ThreadData_t));
+        if (!newlist)
+        {
+            ERROR_PRINT(Cannot extend list of threads to %d entries, size);
+            return -ENOMEM;
+        }
+        newlist->count = 0;
+        newlist->size = size;
+        newlist->prev = list;
+        if (list)
+        {
+            memcpy(newlist->threads, list->threads, list->count * sizeof(ThreadData_t));
+            newlist->count = list->count;
+        }
+        __atomic_store_n(&loop_adapt_threads_list, newlist, __ATOMIC_RELEASE);
+        list = newlist;
+    }
+    tdata->index = list->count;
+    list->threads[list->count] = tdata;
+    __atomic_store_n(&list->count, list->count + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void _loop_adapt_threads_list_free()
+{
+    ThreadList* list = loop_adapt_threads_list;
+    __atomic_store_n(&loop_adapt_threads_list, NULL, __ATOMIC_RELEASE);
+    while (list)
+    {
+        ThreadList* prev = list->prev;
+        free(list);
+        list = prev;
+    }
+}
+
+/* Search a thread in the published thread list without lock */
+static ThreadData_t _loop_adapt_threads_lookup(pthread_t pt)
+{
+    int i = 0;
+    ThreadList* list = __atomic_load_n(&loop_adapt_threads_list, __ATOMIC_ACQUIRE);
+    if (list)
+    {
+        int count = __atomic_load_n(&list->count, __ATOMIC_ACQUIRE);
+        for (i = 0; i < count; i++)
+        {
+            if (pthread_equal(list->threads[i]->pthread, pt))
+            {
+                return list->threads[i];
+            }
+        }
+    }
+    return NULL;
+}
+
 static void _loop_adapt_destroy_threaddata(void* ptr)
 {
     if (ptr)
@@ -60,6 +151,17 @@ static void _loop_adapt_destroy_threaddata(void* ptr)
         if (threaddata)
         {
             pthread_mutex_destroy(&threaddata->lock);
+            if (threaddata->loop_counters)
+            {
+                free(threaddata->loop_counters);
+            }
+            loop_adapt_arena_destroy(&threaddata->arena);
+            while (threaddata->runtime)
+            {
+                LoopAdaptRuntimeChunk* next = threaddata->runtime->next;
+                free(threaddata->runtime);
+                threaddata->runtime = next;
+            }
 
             memset(ptr, 0, sizeof(ThreadData));
             free(ptr);
@@ -89,7 +191,8 @@ int loop_adapt_threads_initialize()
     if (!loop_adapt_threads_tree)
     {
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Initialize thread tree);
-        loop_adapt_copy_hwloc_tree(&loop_adapt_threads_tree);
+        loop_adapt_hwloc_tree_initialize();
+        loop_adapt_threads_tree = loop_adapt_hwloc_tree_get();
     }
 #ifdef MPI
     if (MPIrank < 0)
@@ -103,8 +206,7 @@ int loop_adapt_threads_initialize()
 int loop_adapt_threads_register(int threadid)
 {
     int err = 0;
-    int i = 0, j = 0;
-    int scope_count = 0;
+    int i = 0;
     int pin_thread = 1;
     int tid = gettid();
     pthread_t pt = pthread_self();
@@ -114,10 +216,16 @@ int loop_adapt_threads_register(int threadid)
         //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, No thread hash initialized);
         return -EINVAL;
     }
-    // Check if thread is already registered in thread hash
-    if (get_imap_by_key(loop_adapt_threads, (uint64_t)pt, (void**)&tdata) != 0)
+    // Check if thread is already registered. Only the thread itself registers
+    // with its pthread_self(), so the lookup does not need the lock
+    tdata = _loop_adapt_threads_lookup(pt);
+    if (!tdata)
     {
         tdata = _loop_adapt_new_threaddata();
+        if (!tdata)
+        {
+            return -ENOMEM;
+        }
         tdata->pthread = pt;
         tdata->thread = threadid;
         tdata->pid = getpid();
@@ -128,19 +236,39 @@ int loop_adapt_threads_register(int threadid)
         
         CPU_ZERO(&tdata->cpuset);
         //tdata->cpu = sched_getcpu();
-        for (i = 0; i < hwloc_get_nbobjs_by_type(loop_adapt_threads_tree, HWLOC_OBJ_PU); i++)
+        // The CPU selection has to be serialized, otherwise threads registering
+        // concurrently in a parallel region get the same CPU
+        pthread_mutex_lock(&loop_adapt_threads_lock);
+        if (loop_adapt_hwloc_tree_is_synthetic())
         {
-            if (CPU_ISSET(i, &loop_adapt_threads_cpuset) && (!CPU_ISSET(i, &loop_adapt_threads_cpuset_inuse)))
+            // The PUs of a synthetic topology do not exist, so the threads
+            // are only mapped round-robin onto them and not pinned
+            int num_pus = hwloc_get_nbobjs_by_type(loop_adapt_threads_tree, HWLOC_OBJ_PU);
+            hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_threads_tree, HWLOC_OBJ_PU, loop_adapt_threads_next_pu % num_pus);
+            loop_adapt_threads_next_pu++;
+            tdata->cpu = obj->os_index;
+            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Using synthetic CPU %d for thread %d, tdata->cpu, threadid);
+            pin_thread = 0;
+        }
+        else
+        {
+            for (i = 0; i < hwloc_get_nbobjs_by_type(loop_adapt_threads_tree, HWLOC_OBJ_PU); i++)
             {
-                CPU_SET(i, &loop_adapt_threads_cpuset_inuse);
-                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Using CPU %d for thread, i, threadid);
-                tdata->cpu = i;
-                break;
+                if (CPU_ISSET(i, &loop_adapt_threads_cpuset) && (!CPU_ISSET(i, &loop_adapt_threads_cpuset_inuse)))
+                {
+                    CPU_SET(i, &loop_adapt_threads_cpuset_inuse);
+                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Using CPU %d for thread, i, threadid);
+                    tdata->cpu = i;
+                    break;
+                }
             }
+            // The first registered thread (master) is not pinned
+            pin_thread = (get_imap_size(loop_adapt_threads) > 0);
         }
+        pthread_mutex_unlock(&loop_adapt_threads_lock);
 
         // Here we pin our threads
-        if (get_smap_size(loop_adapt_threads) > 0)
+        if (pin_thread)
         {
             //TODO_PRINT(Ensure pinning to distinct CPUs);
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Pinning thread %d to CPU %d, threadid, tdata->cpu);
@@ -162,36 +290,20 @@ int loop_adapt_threads_register(int threadid)
         // parent object in the hwloc siblings list for a type. Although the
         // hwloc tree is a tree, there are object types (like NUMA domain) which
         // are not in the direct path from hardware thread to tree root (machine type).
-        for (i = 0; i < LOOP_ADAPT_NUM_SCOPES; i++)
+        // The IDs are taken from the lookup tables built once with the topology.
+        if (loop_adapt_hwloc_tree_scope_offsets(tdata->cpu, tdata->scopeOffsets) == 0)
         {
-            tdata->scopeOffsets[i] = -1;
-        }
-        for (i = 0; i < hwloc_get_nbobjs_by_type(loop_adapt_threads_tree, HWLOC_OBJ_PU); i++)
-        {
-            hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_threads_tree, HWLOC_OBJ_PU, i);
-            if (obj->os_index == tdata->cpu)
+            tdata->objidx = tdata->scopeOffsets[LOOP_ADAPT_SCOPE_THREAD_OFFSET];
+            for (i = 0; i < LOOP_ADAPT_NUM_SCOPES; i++)
             {
-                tdata->objidx = obj->logical_index;
-                tdata->scopeOffsets[0] = obj->logical_index;
-                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, PU offset %d for thread %d, tdata->objidx, threadid);
-                break;
+                DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Scope %s offset %d for thread %d (objidx %d), hwloc_obj_type_string(LoopAdaptScopeList[i]), tdata->scopeOffsets[i], threadid, tdata->objidx);
             }
         }
-        for (i = 1; i < LOOP_ADAPT_NUM_SCOPES; i++)
+        else
         {
-            LoopAdaptScope_t scope = LoopAdaptScopeList[i];
-            
-            scope_count = hwloc_get_nbobjs_by_type(loop_adapt_threads_tree, scope);
-            DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Searching for hwloc object with type %s for thread %d in %d objects, hwloc_obj_type_string(scope), threadid, scope_count);
-            for (j = 0; j < scope_count; j++)
+            for (i = 0; i < LOOP_ADAPT_NUM_SCOPES; i++)
             {
-                hwloc_obj_t obj = hwloc_get_obj_by_type(loop_adapt_threads_tree, scope, j);
-                if (hwloc_bitmap_isset(obj->cpuset, tdata->cpu))
-                {
-                    DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Scope %s offset %d/%d for thread %d (objidx %d), hwloc_obj_type_string(scope), j, obj->logical_index, threadid, tdata->objidx);
-                    tdata->scopeOffsets[i] = obj->logical_index;
-                    break;
-                }
+                tdata->scopeOffsets[i] = -1;
             }
         }
         if (tdata->pid == tid)
@@ -203,27 +315,50 @@ int loop_adapt_threads_register(int threadid)
             DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Adding thread %d pt %lu cpu %d obj %d, threadid, (uint64_t)pt, tdata->cpu, tdata->objidx);
         }
         pthread_mutex_lock(&loop_adapt_threads_lock);
-        add_imap(loop_adapt_threads, (uint64_t)pt, (void*)tdata);
+        // Threads are never removed, so the registration index is also the
+        // index in the published thread list used by loop_adapt_threads_getthread()
+        err = _loop_adapt_threads_list_append(tdata);
+        if (err == 0)
+        {
+            add_imap(loop_adapt_threads, (uint64_t)pt, (void*)tdata);
+        }
         pthread_mutex_unlock(&loop_adapt_threads_lock);
+        if (err < 0)
+        {
+            _loop_adapt_destroy_threaddata(tdata);
+            return err;
+        }
     }
     else
     {
         //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Thread with ID %d already registered, threadid);
     }
+    loop_adapt_threads_self = tdata;
+    loop_adapt_threads_self_generation = loop_adapt_threads_generation;
     return 0;
 }
 
 ThreadData_t loop_adapt_threads_get()
 {
     ThreadData_t tdata = NULL;
+    if (loop_adapt_threads_self && loop_adapt_threads_self_generation == loop_adapt_threads_generation)
+    {
+        return loop_adapt_threads_self;
+    }
     if (loop_adapt_threads)
     {
         pthread_t pt = pthread_self();
         //DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_INFO, Getting thread %lu, (uint64_t)pt);
-        if (get_imap_by_key(loop_adapt_threads, (uint64_t)pt, (void**)&tdata) != 0)
+        tdata = _loop_adapt_threads_lookup(pt);
+        if (!tdata)
         {
             ERROR_PRINT(Failed to get data for thread %lu, (uint64_t)pt);
         }
+        else
+        {
+            loop_adapt_threads_self = tdata;
+            loop_adapt_threads_self_generation = loop_adapt_threads_generation;
+        }
     }
     return tdata;
 }
@@ -231,13 +366,14 @@ ThreadData_t loop_adapt_threads_get()
 ThreadData_t loop_adapt_threads_getthread(int id)
 {
     ThreadData_t tdata = NULL;
-    if (loop_adapt_threads)
+    ThreadList* list = __atomic_load_n(&loop_adapt_threads_list, __ATOMIC_ACQUIRE);
+    if (list && id >= 0 && id < __atomic_load_n(&list->count, __ATOMIC_ACQUIRE))
     {
-        int err = get_imap_by_idx(loop_adapt_threads, id, (void**)&tdata);
-        if (err != 0)
-        {
-            ERROR_PRINT(Failed to get data for thread id %d, id);
-        }
+        tdata = list->threads[id];
+    }
+    else
+    {
+        ERROR_PRINT(Failed to get data for thread id %d, id);
     }
     return tdata;
 }
@@ -247,10 +383,13 @@ int loop_adapt_threads_finalize()
     DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize application cpusets);
     CPU_ZERO(&loop_adapt_threads_cpuset);
     CPU_ZERO(&loop_adapt_threads_cpuset_inuse);
+    loop_adapt_threads_next_pu = 0;
     if (loop_adapt_threads)
     {
         pthread_mutex_lock(&loop_adapt_threads_lock);
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize threads hash map);
+        loop_adapt_threads_generation++;
+        _loop_adapt_threads_list_free();
         destroy_imap(loop_adapt_threads);
         loop_adapt_threads = NULL;
         pthread_mutex_unlock(&loop_adapt_threads_lock);
@@ -259,7 +398,7 @@ int loop_adapt_threads_finalize()
     {
         DEBUG_PRINT(LOOP_ADAPT_DEBUGLEVEL_DEBUG, Finalize threads tree);
         pthread_mutex_lock(&loop_adapt_threads_lock);
-        hwloc_topology_destroy(loop_adapt_threads_tree);
+        // The tree is shared, it is destroyed by loop_adapt_hwloc_tree_finalize()
         loop_adapt_threads_tree = NULL;
         pthread_mutex_unlock(&loop_adapt_threads_lock);
     }
@@ -338,16 +477,48 @@ int loop_adapt_threads_in_parallel()
 {
     if (in_parallel)
     {
-        int ret = in_parallel();
-        printf("in Parallel %d\n", ret);
-        return ret;
+        return in_parallel();
     }
     return -1;
 }
 
 int loop_adapt_threads_get_count()
 {
-    if (loop_adapt_threads)
-        return get_imap_size(loop_adapt_threads);
+    ThreadList* list = __atomic_load_n(&loop_adapt_threads_list, __ATOMIC_ACQUIRE);
+    if (list)
+        return __atomic_load_n(&list->count, __ATOMIC_ACQUIRE);
     return 0;
 }
+
+/* Per-thread runtime block: The long-living per-loop data of a thread is
+ * placed in chunks which belong to the thread. The chunks are allocated and
+ * zeroed by the calling thread, usually the thread itself at its first use of
+ * a loop, so the memory is first touched by it and placed on its NUMA node.
+ * Entries are padded to full cache lines, so no other thread writes to them.
+ * Entries are never freed individually, the chunks are freed with the
+ * thread data. The caller has to serialize the allocations for a thread. */
+#define LOOP_ADAPT_RUNTIME_CHUNK_SIZE 4096
+
+void* loop_adapt_threads_runtime_alloc(ThreadData_t thread, size_t size)
+{
+    void* ptr = NULL;
+    LoopAdaptRuntimeChunk* chunk = thread->runtime;
+    size_t header = LOOP_ADAPT_PADDED_SIZE(sizeof(LoopAdaptRuntimeChunk));
+    size = LOOP_ADAPT_PADDED_SIZE(size);
+    if (!chunk || chunk->used + size > chunk->size)
+    {
+        size_t chunksize = (size + header > LOOP_ADAPT_RUNTIME_CHUNK_SIZE ? size + header : LOOP_ADAPT_RUNTIME_CHUNK_SIZE);
+        chunk = loop_adapt_padded_alloc(chunksize);
+        if (!chunk)
+        {
+            return NULL;
+        }
+        chunk->size = LOOP_ADAPT_PADDED_SIZE(chunksize) - header;
+        chunk->used = 0;
+        chunk->next = thread->runtime;
+        thread->runtime = chunk;
+    }
+    ptr = ((char*)chunk) + header + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
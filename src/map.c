@@ -3,7 +3,7 @@
  *
  *      Filename:  map.c
  *
- *      Description:  Implementation a hashmap in C using ghash as backend
+ *      Description:  Implementation of a hashmap in C using open addressing
  *
  *      Version:   5.0
  *      Released:  10.11.2019
@@ -28,242 +28,418 @@
  * =======================================================================================
  */
 
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <stdint.h>
 
 #include <map.h>
 
-#ifdef WITH_BSTRING
-#include <bstrlib.h>
-#endif
+#ifndef LOOP_ADAPT_MAP_GHASH
+
+/* Linear probing with at most 50% filled buckets. Deleted entries are
+ * removed from the buckets by backward shifting, so no tombstones are
+ * required. The values array keeps the indices stable, freed slots are
+ * kept in a free list and reused by later add operations. The space of
+ * deleted string keys is reclaimed by compacting the key buffer when it
+ * is full. */
 
-static int* int_dup(int val)
+#define MAP_MIN_BUCKETS 16
+#define MAP_MIN_VALUES 8
+#define MAP_MIN_KEYS 256
+
+static uint32_t _map_str_hash(const char* key, size_t* len)
 {
-    int* valptr = malloc(sizeof(int));
-    if (valptr)
+    /* FNV-1a */
+    const unsigned char* p = (const unsigned char*)key;
+    uint32_t h = 2166136261U;
+    for (; *p != '\0'; p++)
     {
-        *valptr = val;
+        h ^= *p;
+        h *= 16777619U;
     }
-    return valptr;
+    *len = (size_t)(p - (const unsigned char*)key);
+    return h;
 }
 
-#ifdef WITH_BSTRING
-gboolean
-g_bstr_equal (gconstpointer v1,
-              gconstpointer v2)
+static uint32_t _map_int_hash(int64_t key)
 {
-  const_bstring string1 = v1;
-  const_bstring string2 = v2;
-
-  return bstrcmp (string1, string2) == BSTR_OK;
+    /* Finalizer of MurmurHash3 */
+    uint64_t h = (uint64_t)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
 }
 
-guint
-g_bstr_hash (gconstpointer v)
+static inline uint32_t _map_hash(int64_t ikey, const char* skey, size_t* len)
 {
-    uint32_t h = 5381;
-/*  const signed char *p;*/
-/*  if (v == NULL)*/
-/*    printf("NULL hash\n");*/
-/*  bstring b = (bstring)v;*/
-/*  char * base = bstr2cstr(b, '\0');*/
+    if (skey)
+    {
+        return _map_str_hash(skey, len);
+    }
+    return _map_int_hash(ikey);
+}
 
-/*  for (p = base; *p != '\0'; p++)*/
-/*    h = (h << 5) + h + *p;*/
-/*  bcstrfree(base);*/
-/*  return h;*/
-    const signed char *p;
-    bstring b = (bstring)v;
-    int i = 0;
-    for (; i < blength(b); ++i)
+/* Returns the bucket containing the key or -1. If empty is not NULL, it is
+ * set to the empty bucket which ended the probe sequence. */
+static int _map_find(Map_t map, int64_t ikey, const char* skey, uint32_t hash, uint32_t* empty)
+{
+    uint32_t b = hash & map->bucket_mask;
+    while (map->buckets[b].idx >= 0)
+    {
+        if (map->buckets[b].hash == hash)
+        {
+            MapValue* v = &map->values[map->buckets[b].idx];
+            if (skey ? strcmp(map->keys + v->key, skey) == 0 : v->key == ikey)
+            {
+                return (int)b;
+            }
+        }
+        b = (b + 1) & map->bucket_mask;
+    }
+    if (empty)
     {
-        p = bdataofs(b, i);
-        h = (h << 5) + h + *p;
+        *empty = b;
     }
-    return h;
+    return -1;
 }
 
-void g_bstr_destroy(void* v)
+static void _map_insert_bucket(MapBucket* buckets, uint32_t mask, uint32_t hash, int idx)
 {
-    bstring b = (bstring)v;
-    bdestroy(b);
+    uint32_t b = hash & mask;
+    while (buckets[b].idx >= 0)
+    {
+        b = (b + 1) & mask;
+    }
+    buckets[b].hash = hash;
+    buckets[b].idx = idx;
 }
-#endif
 
+static void _map_remove_bucket(Map_t map, uint32_t b)
+{
+    uint32_t mask = map->bucket_mask;
+    uint32_t next = (b + 1) & mask;
+    while (map->buckets[next].idx >= 0)
+    {
+        uint32_t home = map->buckets[next].hash & mask;
+        /* Move the entry into the hole if the hole is not before its home bucket */
+        if (((next - home) & mask) >= ((next - b) & mask))
+        {
+            map->buckets[b] = map->buckets[next];
+            b = next;
+        }
+        next = (next + 1) & mask;
+    }
+    map->buckets[b].idx = -1;
+}
 
+static MapBucket* _map_alloc_buckets(uint32_t num_buckets)
+{
+    uint32_t i = 0;
+    MapBucket* buckets = malloc(num_buckets * sizeof(MapBucket));
+    if (buckets)
+    {
+        for (i = 0; i < num_buckets; i++)
+        {
+            buckets[i].hash = 0;
+            buckets[i].idx = -1;
+        }
+    }
+    return buckets;
+}
 
-int init_map(Map_t* map, MapKeyType type, int max_size, map_value_destroy_func value_func)
+static int _map_grow_buckets(Map_t map)
 {
-    int err = 0;
-    Map* m = malloc(sizeof(Map));
-    if (m)
+    uint32_t i = 0;
+    uint32_t num_buckets = 2 * (map->bucket_mask + 1);
+    MapBucket* buckets = _map_alloc_buckets(num_buckets);
+    if (!buckets)
     {
-        switch(type)
+        return -ENOMEM;
+    }
+    for (i = 0; i <= map->bucket_mask; i++)
+    {
+        if (map->buckets[i].idx >= 0)
         {
-            case MAP_KEY_TYPE_STR:
-                m->ghash = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
-                if (m->ghash)
-                {
-                    err = 0;
-                }
-                break;
-            case MAP_KEY_TYPE_INT:
-                m->ghash = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free);
-                if (m->ghash)
-                {
-                    err = 0;
-                }
-                break;
-#ifdef WITH_BSTRING
-            case MAP_KEY_TYPE_BSTR:
-                m->ghash = g_hash_table_new_full(g_bstr_hash, g_bstr_equal, g_bstr_destroy, free);
-                if (m->ghash)
-                {
-                    err = 0;
-                }
-                break;
-#endif
-            default:
-                printf("Unknown hash type\n");
-                free(m);
-                err = -ENODEV;
-                break;
+            _map_insert_bucket(buckets, num_buckets - 1, map->buckets[i].hash, map->buckets[i].idx);
         }
     }
-    else
+    free(map->buckets);
+    map->buckets = buckets;
+    map->bucket_mask = num_buckets - 1;
+    return 0;
+}
+
+static int _map_grow_values(Map_t map)
+{
+    int capacity = (map->capacity > 0 ? 2 * map->capacity : MAP_MIN_VALUES);
+    if (map->max_size > 0 && capacity > map->max_size)
     {
-        err = -ENOMEM;
+        capacity = map->max_size;
     }
-    if (!err && m)
+    MapValue* vals = realloc(map->values, capacity * sizeof(MapValue));
+    if (!vals)
     {
-        m->num_values = 0;
-        m->size = 0;
-        m->max_size = max_size;
-        m->values = NULL;
-        m->key_type = type;
-        m->value_func = value_func;
-        *map = m;
+        return -ENOMEM;
     }
-    return err;
+    map->values = vals;
+    map->capacity = capacity;
+    return 0;
 }
 
-int init_smap(Map_t* map, map_value_destroy_func func)
+/* Copies the keys of the used entries into a new key buffer of the given
+ * size, dropping the keys of deleted entries */
+static int _map_compact_keys(Map_t map, size_t size)
 {
-    return init_map(map, MAP_KEY_TYPE_STR, 0, func);
+    int i = 0;
+    size_t len = 0;
+    char* keys = malloc(size);
+    if (!keys)
+    {
+        return -ENOMEM;
+    }
+    for (i = 0; i < map->size; i++)
+    {
+        MapValue* v = &map->values[i];
+        if (v->used)
+        {
+            size_t klen = strlen(map->keys + v->key) + 1;
+            memcpy(keys + len, map->keys + v->key, klen);
+            v->key = (int64_t)len;
+            len += klen;
+        }
+    }
+    free(map->keys);
+    map->keys = keys;
+    map->keys_len = len;
+    map->keys_size = size;
+    map->keys_dead = 0;
+    return 0;
 }
 
-int add_smap(Map_t map, char* key, void* val)
+/* Returns the offset of the copied key in the key buffer or -1 */
+static int64_t _map_add_key(Map_t map, const char* key, size_t len)
+{
+    int64_t offset = 0;
+    if (map->keys_len + len + 1 > map->keys_size)
+    {
+        size_t live = map->keys_len - map->keys_dead;
+        size_t size = (map->keys_size > 0 ? map->keys_size : MAP_MIN_KEYS);
+        while (live + len + 1 > size)
+        {
+            size *= 2;
+        }
+        if (map->keys_dead > 0)
+        {
+            if (_map_compact_keys(map, size) != 0)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            char* keys = realloc(map->keys, size);
+            if (!keys)
+            {
+                return -1;
+            }
+            map->keys = keys;
+            map->keys_size = size;
+        }
+    }
+    offset = (int64_t)map->keys_len;
+    memcpy(map->keys + map->keys_len, key, len + 1);
+    map->keys_len += len + 1;
+    return offset;
+}
+
+static int _map_add(Map_t map, int64_t ikey, const char* skey, void* val)
 {
-    MapValue *mval = NULL;
-#ifndef WITH_BSTRING
-    gpointer gval = g_hash_table_lookup(map->ghash, key);
-#else
-    bstring bkey = bfromcstr(key);
-    gpointer gval = g_hash_table_lookup(map->ghash, bkey);
-#endif
-    if (gval)
+    int idx = -1;
+    int grow = 0;
+    size_t len = 0;
+    uint32_t empty = 0;
+    uint32_t hash = _map_hash(ikey, skey, &len);
+    if (_map_find(map, ikey, skey, hash, &empty) >= 0)
     {
         return -EEXIST;
     }
-    if (map->num_values == map->size)
+    if (map->free_head < 0)
     {
         if (map->max_size > 0 && map->size == map->max_size)
         {
-/*            printf("Map is full\n");*/
             return -ENOSPC;
         }
-/*        printf("Realloc to size %d\n", (map->size+1));*/
-        MapValue *vals = realloc(map->values, (map->size+1)*sizeof(MapValue));
-        if (!vals)
+        if (map->size == map->capacity && _map_grow_values(map) != 0)
         {
-/*            printf("Failed to enlarge values\n");*/
             return -ENOMEM;
         }
-        map->values = vals;
-        map->values[map->size].key = NULL;
-        map->values[map->size].value = NULL;
-        map->values[map->size].iptr = NULL;
-        map->size++;
-/*        printf("Realloc done to size %d\n",map->size);*/
+        idx = map->size;
     }
-    if (map->num_values < map->size)
+    if (2 * (map->num_values + 1) > (int)(map->bucket_mask + 1))
     {
-        int idx = map->size-1;
-/*        printf("Startidx %d\n", idx);*/
-        while (idx >= 0 && map->values[idx].value != NULL)
+        if (_map_grow_buckets(map) != 0)
         {
-            idx--;
+            return -ENOMEM;
         }
-/*        printf("Adding value at index %d\n", idx);*/
-#ifndef WITH_BSTRING
-        map->values[idx].key = g_strdup(key);
-#else
-        map->values[idx].key = bkey;
-#endif
-        map->values[idx].value = val;
-        map->values[idx].iptr = int_dup(idx);
-/*        printf("Adding %s -> %d\n", key, idx);*/
-        g_hash_table_insert(map->ghash, map->values[idx].key, map->values[idx].iptr);
-        map->num_values++;
-        return idx;
+        grow = 1;
     }
-
-    return -1;
+    if (skey)
+    {
+        ikey = _map_add_key(map, skey, len);
+        if (ikey < 0)
+        {
+            return -ENOMEM;
+        }
+    }
+    if (idx < 0)
+    {
+        idx = map->free_head;
+        map->free_head = (int)map->values[idx].key;
+    }
+    map->values[idx].key = ikey;
+    map->values[idx].value = val;
+    map->values[idx].hash = hash;
+    map->values[idx].used = 1;
+    if (idx == map->size)
+    {
+        map->size++;
+    }
+    if (grow)
+    {
+        _map_insert_bucket(map->buckets, map->bucket_mask, hash, idx);
+    }
+    else
+    {
+        /* The probe sequence of the lookup ended at the first empty bucket */
+        map->buckets[empty].hash = hash;
+        map->buckets[empty].idx = idx;
+    }
+    map->num_values++;
+    return idx;
 }
 
-int update_smap(Map_t map, char* key, void* val, void** old)
+static int _map_get(Map_t map, int64_t ikey, const char* skey, void** val)
 {
-    MapValue *mval = NULL;
-#ifndef WITH_BSTRING
-    gpointer gval = g_hash_table_lookup(map->ghash, key);
-#else
-    bstring bkey = bfromcstr(key);
-    gpointer gval = g_hash_table_lookup(map->ghash, bkey);
-#endif
-    if (map->num_values < map->size)
-    {
-        int idx = map->size-1;
-        while (idx >= 0 && map->values[idx].value != NULL)
+    size_t len = 0;
+    int b = _map_find(map, ikey, skey, _map_hash(ikey, skey, &len), NULL);
+    if (b >= 0)
+    {
+        if (val)
         {
-            idx--;
+            *val = map->values[map->buckets[b].idx].value;
         }
-        *old = map->values[idx].value;
-        map->values[idx].value = val;
-        return idx;
+        return 0;
     }
-    return -1;
+    return -ENOENT;
 }
 
-int get_smap_by_key(Map_t map, char* key, void** val)
+static int _map_del(Map_t map, int64_t ikey, const char* skey)
 {
-#ifndef WITH_BSTRING
-    gpointer gval = g_hash_table_lookup(map->ghash, key);
-#else
-    bstring bkey = bfromcstr(key);
-    gpointer gval = g_hash_table_lookup(map->ghash, bkey);
-    bdestroy(bkey);
-#endif
-    if (gval)
+    size_t len = 0;
+    int b = _map_find(map, ikey, skey, _map_hash(ikey, skey, &len), NULL);
+    if (b >= 0)
     {
-        if (val)
+        int idx = map->buckets[b].idx;
+        MapValue* v = &map->values[idx];
+        if (map->value_func != NULL)
+        {
+            map->value_func(v->value);
+        }
+        if (skey)
         {
-            int* ival = (int*)gval;
-            MapValue *mval = &(map->values[*ival]);
-            *val = (void*)mval->value;
+            map->keys_dead += len + 1;
         }
+        v->value = NULL;
+        v->used = 0;
+        v->key = map->free_head;
+        map->free_head = idx;
+        _map_remove_bucket(map, (uint32_t)b);
+        map->num_values--;
         return 0;
     }
     return -ENOENT;
 }
 
+int init_map(Map_t* map, MapKeyType type, int max_size, map_value_destroy_func value_func)
+{
+    Map* m = NULL;
+    if (type < MAP_KEY_TYPE_STR || type >= MAX_MAP_KEY_TYPE)
+    {
+        printf("Unknown hash type\n");
+        return -ENODEV;
+    }
+    m = malloc(sizeof(Map));
+    if (!m)
+    {
+        return -ENOMEM;
+    }
+    m->buckets = _map_alloc_buckets(MAP_MIN_BUCKETS);
+    if (!m->buckets)
+    {
+        free(m);
+        return -ENOMEM;
+    }
+    m->bucket_mask = MAP_MIN_BUCKETS - 1;
+    m->num_values = 0;
+    m->size = 0;
+    m->max_size = max_size;
+    m->id = 0;
+    m->values = NULL;
+    m->capacity = 0;
+    m->free_head = -1;
+    m->keys = NULL;
+    m->keys_len = 0;
+    m->keys_size = 0;
+    m->keys_dead = 0;
+    m->key_type = type;
+    m->value_func = value_func;
+    *map = m;
+    return 0;
+}
+
+int init_smap(Map_t* map, map_value_destroy_func func)
+{
+    return init_map(map, MAP_KEY_TYPE_STR, 0, func);
+}
+
+int add_smap(Map_t map, char* key, void* val)
+{
+    return _map_add(map, 0, key, val);
+}
+
+int update_smap(Map_t map, char* key, void* val, void** old)
+{
+    size_t len = 0;
+    int b = _map_find(map, 0, key, _map_str_hash(key, &len), NULL);
+    if (b >= 0)
+    {
+        int idx = map->buckets[b].idx;
+        if (old)
+        {
+            *old = map->values[idx].value;
+        }
+        map->values[idx].value = val;
+        return idx;
+    }
+    return -ENOENT;
+}
+
+int get_smap_by_key(Map_t map, char* key, void** val)
+{
+    return _map_get(map, 0, key, val);
+}
+
 int get_map_by_idx(Map_t map, int idx, void** val)
 {
     if (idx >= 0 && idx < map->size)
     {
-        MapValue *mval = &(map->values[idx]);
-        *val = (void*)mval->value;
+        *val = map->values[idx].value;
         return 0;
     }
     return -ENOENT;
@@ -288,11 +464,23 @@ int get_smap_size(Map_t map)
     return get_map_size(map);
 }
 
+/* Calls func(key, value, user_data) for all entries in index order. The key
+ * is the string for string maps and the integer casted to a pointer for
+ * integer maps. */
 void foreach_in_map(Map_t map, map_foreach_func func, mpointer user_data)
 {
+    int i = 0;
     if (map && func)
     {
-        g_hash_table_foreach(map->ghash, func, user_data);
+        for (i = 0; i < map->size; i++)
+        {
+            MapValue* v = &map->values[i];
+            if (v->used)
+            {
+                mpointer key = (map->key_type == MAP_KEY_TYPE_INT ? (mpointer)v->key : (mpointer)(map->keys + v->key));
+                func(key, v->value, user_data);
+            }
+        }
     }
 }
 
@@ -303,135 +491,55 @@ void foreach_in_smap(Map_t map, map_foreach_func func, mpointer user_data)
 
 int del_smap(Map_t map, char* key)
 {
-#ifndef WITH_BSTRING
-    gpointer gval = g_hash_table_lookup(map->ghash, key);
-#else
-    bstring bkey = bfromcstr(key);
-    gpointer gval = g_hash_table_lookup(map->ghash, bkey);
-#endif
-    if (gval)
-    {
-        int* ival = (int*)gval;
-/*        printf("Remove %s at index %d\n", key, *ival);*/
-        map->values[*ival].key = NULL;
-        if (map->value_func != NULL)
-        {
-            map->value_func(map->values[*ival].value);
-        }
-        map->values[*ival].value = NULL;
-        map->values[*ival].iptr = NULL;
-#ifndef WITH_BSTRING
-        g_hash_table_remove(map->ghash, key);
-#else
-        g_hash_table_remove(map->ghash, bkey);
-        bdestroy(bkey);
-#endif
-        map->num_values--;
-/*        printf("num_values %d size %d\n", map->num_values, map->size);*/
-        return 0;
-    }
-    return -ENOENT;
+    return _map_del(map, 0, key);
 }
 
-void destroy_smap(Map_t map)
+static void destroy_map(Map_t map)
 {
+    int i = 0;
     if (map)
     {
-        g_hash_table_destroy(map->ghash);
-        map->ghash = NULL;
-        if (map->values)
+        if (map->values && map->value_func)
         {
-            if (map->value_func)
+            for (i = 0; i < map->size; i++)
             {
-                for (int i = 0; i < map->size; i++)
+                if (map->values[i].used && map->values[i].value != NULL)
                 {
-                    if (map->values[i].value != NULL)
-                    {
-/*                        printf("Calling free function for map value %d\n", i);*/
-                        map->value_func(map->values[i].value);
-                    }
+                    map->value_func(map->values[i].value);
                 }
             }
-            free(map->values);
-            map->values = NULL;
         }
+        free(map->values);
+        map->values = NULL;
+        free(map->buckets);
+        map->buckets = NULL;
+        free(map->keys);
+        map->keys = NULL;
         map->num_values = 0;
         map->size = 0;
         free(map);
     }
 }
 
-int init_imap(Map_t* map, map_value_destroy_func func)
+void destroy_smap(Map_t map)
 {
-    int ret = init_map(map, MAP_KEY_TYPE_INT, -1, func);
-    return ret;
+    destroy_map(map);
 }
 
+int init_imap(Map_t* map, map_value_destroy_func func)
+{
+    return init_map(map, MAP_KEY_TYPE_INT, -1, func);
+}
 
 // Not thread-safe
 int add_imap(Map_t map, int64_t key, void* val)
 {
-    MapValue *mval = NULL;
-    gpointer gval = g_hash_table_lookup(map->ghash, (gpointer)key);
-    if (gval)
-    {
-        return -EEXIST;
-    }
-    if (map->num_values == map->size)
-    {
-        if (map->max_size > 0 && map->size == map->max_size)
-        {
-/*            printf("Map is full\n");*/
-            return -ENOSPC;
-        }
-/*        printf("Realloc to size %d\n", (map->size+1)*sizeof(MapValue));*/
-        MapValue *vals = realloc(map->values, (map->size+1)*sizeof(MapValue));
-        if (!vals)
-        {
-/*            printf("Failed to enlarge values\n");*/
-            return -ENOMEM;
-        }
-        map->values = vals;
-        map->values[map->size].key = NULL;
-        map->values[map->size].value = NULL;
-        map->values[map->size].iptr = NULL;
-        map->size++;
-/*        printf("Realloc done to size %d\n",map->size);*/
-    }
-    if (map->num_values < map->size)
-    {
-        int idx = map->size-1;
-/*        printf("Startidx %d\n", idx);*/
-        while (idx >= 0 && map->values[idx].value != NULL)
-        {
-            idx--;
-        }
-/*        printf("Adding value at index %d\n", idx);*/
-        map->values[idx].key = (gpointer)key;
-        map->values[idx].value = val;
-        map->values[idx].iptr = int_dup(idx);
-/*        printf("Adding %s -> %d\n", key, idx);*/
-        g_hash_table_insert(map->ghash, map->values[idx].key, map->values[idx].iptr);
-        map->num_values++;
-        return idx;
-    }
-    return -1;
+    return _map_add(map, key, NULL, val);
 }
 
 int get_imap_by_key(Map_t map, int64_t key, void** val)
 {
-    gpointer gval = g_hash_table_lookup(map->ghash, (gpointer)key);
-    if (gval)
-    {
-        if (val)
-        {
-            int* ival = (int*)gval;
-            MapValue *mval = &(map->values[*ival]);
-            *val = (void*)mval->value;
-        }
-        return 0;
-    }
-    return -ENOENT;
+    return _map_get(map, key, NULL, val);
 }
 
 int get_imap_by_idx(Map_t map, int idx, void** val)
@@ -451,51 +559,12 @@ void foreach_in_imap(Map_t map, map_foreach_func func, mpointer user_data)
 
 int del_imap(Map_t map, int64_t key)
 {
-
-    gpointer gval = g_hash_table_lookup(map->ghash, (gpointer)key);
-    if (gval)
-    {
-        int* ival = (int*)gval;
-/*        printf("Remove %s at index %d\n", key, *ival);*/
-        map->values[*ival].key = NULL;
-        if (map->value_func != NULL)
-        {
-            map->value_func(map->values[*ival].value);
-        }
-        map->values[*ival].value = NULL;
-        map->values[*ival].iptr = NULL;
-        g_hash_table_remove(map->ghash, (gpointer)&key);
-        map->num_values--;
-/*        printf("num_values %d size %d\n", map->num_values, map->size);*/
-        return 0;
-    }
-    return -ENOENT;
+    return _map_del(map, key, NULL);
 }
 
 void destroy_imap(Map_t map)
 {
-    if (map)
-    {
-        g_hash_table_destroy(map->ghash);
-        map->ghash = NULL;
-        if (map->values)
-        {
-            if (map->value_func)
-            {
-                for (int i = 0; i < map->size; i++)
-                {
-                    if (map->values[i].value != NULL)
-                    {
-/*                        printf("Calling free function for map value %d\n", i);*/
-                        map->value_func(map->values[i].value);
-                    }
-                }
-            }
-            free(map->values);
-            map->values = NULL;
-        }
-        map->num_values = 0;
-        map->size = 0;
-        free(map);
-    }
+    destroy_map(map);
 }
+
+#endif /* LOOP_ADAPT_MAP_GHASH */
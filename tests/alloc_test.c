@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <loop_adapt.h>
+
+#include "test_config_helper.h"
+
+/* Check that measurement cycles do not allocate memory once all buffers are
+ * warm. The allocation functions of the C library are wrapped and counted
+ * while counting is enabled. */
+
+#define ALLOC_TEST_LOOP "ALLOC_TEST"
+#define ALLOC_TEST_PARAM "ALLOC_PARAM"
+#define ALLOC_TEST_CYCLE 4
+#define ALLOC_TEST_WARMUP 8
+#define ALLOC_TEST_CYCLES 64
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+static int counting = 0;
+static long allocations = 0;
+
+static inline void count_allocation()
+{
+    if (__atomic_load_n(&counting, __ATOMIC_RELAXED))
+    {
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void* malloc(size_t size)
+{
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+    count_allocation();
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    count_allocation();
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    count_allocation();
+    *ptr = __libc_memalign(alignment, size);
+    return (*ptr ? 0 : 12);
+}
+
+static void run_cycles(int cycles)
+{
+    int i = 0;
+    int value = 0;
+    LA_FOR(ALLOC_TEST_LOOP, i = 0, i < cycles * ALLOC_TEST_CYCLE, i++)
+    {
+        LA_GET_INT_PARAMETER(ALLOC_TEST_PARAM, value);
+        __asm__ __volatile__("" :: "r"(value) : "memory");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+#ifndef LOOP_ADAPT_ACTIVATE
+    printf("alloc_test requires LOOP_ADAPT_ACTIVATE\n");
+    return 1;
+#else
+    TestConfig tc;
+    // One configuration per cycle so that every cycle reads a new one
+    if (test_config_setup(&tc, "alloc_test", ALLOC_TEST_LOOP, ALLOC_TEST_PARAM, ALLOC_TEST_WARMUP + ALLOC_TEST_CYCLES + 1) != 0)
+    {
+        return 1;
+    }
+
+    LA_INIT;
+    LA_REGISTER(ALLOC_TEST_LOOP, ALLOC_TEST_CYCLE);
+    LA_NEW_INT_PARAMETER(ALLOC_TEST_PARAM, LOOP_ADAPT_SCOPE_SYSTEM, 0);
+    LA_USE_LOOP_PARAMETER(ALLOC_TEST_LOOP, ALLOC_TEST_PARAM);
+    LA_USE_LOOP_POLICY(ALLOC_TEST_LOOP, "MIN_TIME");
+
+    run_cycles(ALLOC_TEST_WARMUP);
+    __atomic_store_n(&counting, 1, __ATOMIC_RELAXED);
+    run_cycles(ALLOC_TEST_CYCLES);
+    __atomic_store_n(&counting, 0, __ATOMIC_RELAXED);
+
+    LA_FINALIZE;
+
+    test_config_cleanup(&tc);
+
+    if (allocations > 0)
+    {
+        printf("FAILED: %ld allocations in %d warm cycles\n", allocations, ALLOC_TEST_CYCLES);
+        return 1;
+    }
+    printf("OK: No allocations in %d warm cycles\n", ALLOC_TEST_CYCLES);
+    return 0;
+#endif
+}
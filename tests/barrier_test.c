@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <loop_adapt_barrier.h>
+
+/* Checks the barrier of synchronized loops. In each round all threads count
+ * their arrival, after the barrier every thread has to see the arrivals of
+ * all threads. Exactly one thread per round is the last arriving thread. The
+ * decision of the last thread about the votes of a round must reach all
+ * threads. The rounds with a delay make the waiting threads sleep in the
+ * kernel. */
+
+#define BARRIER_TEST_THREADS 4
+#define BARRIER_TEST_ROUNDS 2000
+#define BARRIER_TEST_SLOW_ROUNDS 16
+
+static LoopAdaptBarrier barrier;
+static int arrivals = 0;
+static int lasts = 0;
+static int errors = 0;
+static int votes = 0;
+static int decision = 0;
+
+/* Called by the last thread, all threads voted before */
+static int count_votes(void* arg)
+{
+    return __atomic_exchange_n(&votes, 0, __ATOMIC_ACQ_REL);
+}
+
+static void* worker(void* arg)
+{
+    int r = 0, i = 0;
+    int sense = 0;
+    int id = (int)(long)arg;
+    for (r = 0; r < BARRIER_TEST_ROUNDS; r++)
+    {
+        if (id == 0 && r < BARRIER_TEST_SLOW_ROUNDS)
+        {
+            // Give the other threads the time to go to sleep
+            for (i = 0; i < 1000; i++)
+            {
+                sched_yield();
+            }
+        }
+        __atomic_add_fetch(&arrivals, 1, __ATOMIC_RELAXED);
+        if (loop_adapt_barrier_wait(&barrier, &sense))
+        {
+            __atomic_add_fetch(&lasts, 1, __ATOMIC_RELAXED);
+        }
+        if (__atomic_load_n(&arrivals, __ATOMIC_RELAXED) < (r + 1) * BARRIER_TEST_THREADS)
+        {
+            __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+        }
+        // Nobody may count the next round before all checked this round
+        loop_adapt_barrier_wait(&barrier, &sense);
+        // All threads get the decision of the last thread, it takes all votes
+        __atomic_add_fetch(&votes, id + 1, __ATOMIC_RELAXED);
+        if (loop_adapt_barrier_decide(&barrier, &sense, count_votes, NULL, &decision) != BARRIER_TEST_THREADS * (BARRIER_TEST_THREADS + 1) / 2)
+        {
+            __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    long i = 0;
+    pthread_t threads[BARRIER_TEST_THREADS];
+    loop_adapt_barrier_init(&barrier, BARRIER_TEST_THREADS);
+    for (i = 0; i < BARRIER_TEST_THREADS; i++)
+    {
+        if (pthread_create(&threads[i], NULL, worker, (void*)i) != 0)
+        {
+            printf("Cannot create thread %ld\n", i);
+            return 1;
+        }
+    }
+    for (i = 0; i < BARRIER_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    if (errors > 0)
+    {
+        printf("FAILED: %d threads left the barrier too early or missed the decision\n", errors);
+        return 1;
+    }
+    if (lasts != BARRIER_TEST_ROUNDS)
+    {
+        printf("FAILED: %d last threads in %d rounds\n", lasts, BARRIER_TEST_ROUNDS);
+        return 1;
+    }
+    printf("OK: Barrier tests passed\n");
+    return 0;
+}
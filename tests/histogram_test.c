@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <loop_adapt_histogram.h>
+
+/* Checks the percentiles, mean and variance of the per-iteration histogram
+ * against exactly known distributions. The percentiles may deviate by the
+ * relative bucket width. */
+
+#define HIST_TOLERANCE (1.0 / LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS)
+
+static int check(char* name, double value, double expected, double tolerance)
+{
+    double diff = fabs(value - expected);
+    if (diff > tolerance * (expected > 1 ? expected : 1))
+    {
+        printf("FAILED: %s is %f expected %f\n", name, value, expected);
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    int i = 0;
+    int err = 0;
+    LoopAdaptHistogram* h = malloc(sizeof(LoopAdaptHistogram));
+    if (!h)
+    {
+        printf("Cannot allocate histogram\n");
+        return 1;
+    }
+
+    // Empty histogram
+    loop_adapt_histogram_reset(h);
+    err += check("empty p50", loop_adapt_histogram_percentile(h, 0.5), 0, 0);
+    err += check("empty variance", loop_adapt_histogram_variance(h), 0, 0);
+
+    // Small values are exact
+    for (i = 0; i < LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS; i++)
+    {
+        loop_adapt_histogram_record(h, i);
+    }
+    err += check("exact p50", loop_adapt_histogram_percentile(h, 0.5), LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS / 2 - 1, 0);
+    err += check("exact max", loop_adapt_histogram_percentile(h, 1.0), LOOP_ADAPT_HISTOGRAM_SUB_BUCKETS - 1, 0);
+
+    // Uniform 1000 ... 100999 ns
+    loop_adapt_histogram_reset(h);
+    for (i = 0; i < 100000; i++)
+    {
+        loop_adapt_histogram_record(h, 1000 + i);
+    }
+    err += check("uniform p50", loop_adapt_histogram_percentile(h, 0.5), 50999, HIST_TOLERANCE);
+    err += check("uniform p90", loop_adapt_histogram_percentile(h, 0.9), 90999, HIST_TOLERANCE);
+    err += check("uniform p99", loop_adapt_histogram_percentile(h, 0.99), 99999, HIST_TOLERANCE);
+    err += check("uniform max", (double)h->max, 100999, 0);
+    err += check("uniform mean", loop_adapt_histogram_mean(h), 50999.5, 1E-9);
+    err += check("uniform variance", loop_adapt_histogram_variance(h), (100000.0 * 100001.0) / 12.0, 1E-6);
+
+    // Large offset with small jitter, the moments are shifted by the first value
+    loop_adapt_histogram_reset(h);
+    for (i = 0; i < 1000; i++)
+    {
+        loop_adapt_histogram_record(h, 1000000000ULL + (i % 2 ? 10 : 0));
+    }
+    err += check("jitter mean", loop_adapt_histogram_mean(h), 1000000005.0, 1E-12);
+    err += check("jitter variance", loop_adapt_histogram_variance(h), 25.0 * 1000.0 / 999.0, 1E-9);
+
+    // One slow iteration out of 100 shows up only in p99 and max
+    loop_adapt_histogram_reset(h);
+    for (i = 0; i < 1000; i++)
+    {
+        loop_adapt_histogram_record(h, (i % 100 == 50 ? 2000000 : 100000));
+    }
+    err += check("tail p90", loop_adapt_histogram_percentile(h, 0.9), 100000, HIST_TOLERANCE);
+    err += check("tail p99", loop_adapt_histogram_percentile(h, 0.99), 100000, HIST_TOLERANCE);
+    err += check("tail p995", loop_adapt_histogram_percentile(h, 0.995), 2000000, HIST_TOLERANCE);
+    err += check("tail max", (double)h->max, 2000000, 0);
+
+    // Values beyond the range are counted in the last bucket
+    loop_adapt_histogram_reset(h);
+    loop_adapt_histogram_record(h, 1ULL << 50);
+    err += check("overflow max", loop_adapt_histogram_percentile(h, 0.5), (double)(1ULL << 50), 0);
+
+    free(h);
+    if (err == 0)
+    {
+        printf("OK: Histogram tests passed\n");
+    }
+    return (err > 0);
+}
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+
+#include <loop_adapt.h>
+#include <loop_adapt_configuration.h>
+
+#include "test_config_helper.h"
+
+/* Check that prefetching does not change the configurations of a loop. The
+ * configurations are fetched once with and once without the prefetch service
+ * thread and the sequences of parameter values are compared. Each run is done
+ * in a child process because LA_CONFIG_PREFETCH is read by LA_INIT. With
+ * prefetching, a request arriving while the slot is in work must not be
+ * dropped. */
+
+#define PREFETCH_TEST_LOOP "PREFETCH_TEST"
+#define PREFETCH_TEST_PARAM "PREFETCH_PARAM"
+#define PREFETCH_TEST_CONFIGS 16
+#define PREFETCH_TEST_ROUNDS 100
+
+/* Parameter value of each configuration followed by the result of the
+ * queued request check */
+#define PREFETCH_TEST_RESULTS (PREFETCH_TEST_CONFIGS + 1)
+
+/* Fetch the configurations of the loop in order, the values are written to
+ * the pipe */
+static int child(int prefetch, int fd)
+{
+    int i = 0, j = 0;
+    int results[PREFETCH_TEST_RESULTS];
+    LoopAdaptSharedConfiguration share;
+    LoopAdaptConfiguration_t config = NULL;
+
+    if (prefetch)
+    {
+        setenv("LA_CONFIG_PREFETCH", "1", 1);
+    }
+    else
+    {
+        unsetenv("LA_CONFIG_PREFETCH");
+    }
+    LA_INIT;
+    LA_NEW_INT_PARAMETER(PREFETCH_TEST_PARAM, LOOP_ADAPT_SCOPE_SYSTEM, -1);
+
+    loop_adapt_configuration_shared_init(&share);
+    for (i = 0; i < PREFETCH_TEST_CONFIGS; i++)
+    {
+        results[i] = -1;
+        if (loop_adapt_configuration_shared_get(&share, PREFETCH_TEST_LOOP, i, &config) == 0
+            && config && config->configuration_id == i && config->num_parameters > 0)
+        {
+            results[i] = config->parameters[0].values[0].value.ival;
+        }
+    }
+    loop_adapt_configuration_shared_destroy(&share);
+
+    // Request another configuration while the first one may still be in
+    // work. The newest request has to be served.
+    results[PREFETCH_TEST_CONFIGS] = 0;
+    if (prefetch)
+    {
+        LoopAdaptConfigurationPrefetch slot = { 0 };
+        results[PREFETCH_TEST_CONFIGS] = -1;
+        for (j = 0; j < PREFETCH_TEST_ROUNDS; j++)
+        {
+            LoopAdaptConfiguration_t c = NULL;
+            int id = 1 + j % (PREFETCH_TEST_CONFIGS - 1);
+            if (loop_adapt_configuration_prefetch(&slot, PREFETCH_TEST_LOOP, 0, NULL) != 0 ||
+                loop_adapt_configuration_prefetch(&slot, PREFETCH_TEST_LOOP, id, NULL) != 0)
+            {
+                break;
+            }
+            while (__atomic_load_n(&slot.state, __ATOMIC_ACQUIRE) != LOOP_ADAPT_PREFETCH_READY)
+            {
+                sched_yield();
+            }
+            if (loop_adapt_configuration_prefetched(&slot, id, &c) != 0 || !c || c->configuration_id != id)
+            {
+                loop_adapt_configuration_release(c);
+                break;
+            }
+            loop_adapt_configuration_release(c);
+        }
+        if (j == PREFETCH_TEST_ROUNDS)
+        {
+            results[PREFETCH_TEST_CONFIGS] = 0;
+        }
+        loop_adapt_configuration_release(slot.config);
+    }
+
+    LA_FINALIZE;
+    if (write(fd, results, sizeof(results)) != sizeof(results))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+static int run(int prefetch, int* results)
+{
+    int fds[2];
+    int status = 0;
+    if (pipe(fds) != 0)
+    {
+        return 1;
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return 1;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        _exit(child(prefetch, fds[1]));
+    }
+    close(fds[1]);
+    ssize_t len = read(fds[0], results, PREFETCH_TEST_RESULTS * sizeof(int));
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    if (len != PREFETCH_TEST_RESULTS * sizeof(int) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        printf("FAILED: Run %s prefetching did not finish\n", (prefetch ? "with" : "without"));
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+#ifndef LOOP_ADAPT_ACTIVATE
+    printf("prefetch_test requires LOOP_ADAPT_ACTIVATE\n");
+    return 1;
+#else
+    int i = 0;
+    int failed = 0;
+    int direct[PREFETCH_TEST_RESULTS];
+    int prefetched[PREFETCH_TEST_RESULTS];
+    TestConfig tc;
+    if (test_config_setup(&tc, "prefetch_test", PREFETCH_TEST_LOOP, PREFETCH_TEST_PARAM, PREFETCH_TEST_CONFIGS) != 0)
+    {
+        return 1;
+    }
+
+    failed = run(0, direct);
+    if (!failed)
+    {
+        failed = run(1, prefetched);
+    }
+    test_config_cleanup(&tc);
+    if (failed)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < PREFETCH_TEST_CONFIGS; i++)
+    {
+        if (direct[i] != i)
+        {
+            printf("FAILED: Configuration %d has value %d without prefetching\n", i, direct[i]);
+            failed = 1;
+        }
+        if (prefetched[i] != direct[i])
+        {
+            printf("FAILED: Configuration %d has value %d with prefetching instead of %d\n", i, prefetched[i], direct[i]);
+            failed = 1;
+        }
+    }
+    if (prefetched[PREFETCH_TEST_CONFIGS] != 0)
+    {
+        printf("FAILED: Request queued while the prefetch slot was in work was not served\n");
+        failed = 1;
+    }
+    if (failed)
+    {
+        return 1;
+    }
+    printf("OK: Same configurations with and without prefetching\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include <loop_adapt.h>
+#include <loop_adapt_configuration.h>
+
+#include "test_config_helper.h"
+
+/* Stress test of the configuration shared by the threads of a loop. The
+ * threads walk through the configurations at different speeds, so slow
+ * threads ask for configurations which were already replaced. Each thread
+ * checks that it gets the requested configuration and that it does not
+ * change while the thread references it. At the end, the number of kept
+ * configurations must be bounded, also if a reader stalls. The test is run
+ * with and without the prefetch service thread in child processes because
+ * LA_CONFIG_PREFETCH is read by LA_INIT. */
+
+#define SHARED_CONFIG_TEST_LOOP "SHARED_CONFIG_TEST"
+#define SHARED_CONFIG_TEST_PARAM "SHARED_CONFIG_PARAM"
+#define SHARED_CONFIG_TEST_THREADS 8
+#define SHARED_CONFIG_TEST_CONFIGS 32
+#define SHARED_CONFIG_TEST_ROUNDS 20000
+
+static LoopAdaptSharedConfiguration share;
+static int errors[SHARED_CONFIG_TEST_THREADS];
+
+static void* worker(void* arg)
+{
+    int id = (int)(long)arg;
+    int r = 0;
+    LoopAdaptConfiguration_t config = NULL;
+    for (r = 0; r < SHARED_CONFIG_TEST_ROUNDS; r++)
+    {
+        // Thread t switches the configuration every (t % 4) + 1 rounds
+        int config_id = (r / (id % 4 + 1)) % SHARED_CONFIG_TEST_CONFIGS;
+        int err = loop_adapt_configuration_shared_get(&share, SHARED_CONFIG_TEST_LOOP, config_id, &config);
+        if (err != 0 || !config || config->configuration_id != config_id || config->num_parameters < 1)
+        {
+            errors[id]++;
+            continue;
+        }
+        int value = config->parameters[0].values[0].value.ival;
+        if (r % 16 == 0)
+        {
+            sched_yield();
+        }
+        if (value != config_id || config->configuration_id != config_id ||
+            config->parameters[0].values[0].value.ival != value)
+        {
+            errors[id]++;
+        }
+    }
+    return NULL;
+}
+
+static int child(int prefetch)
+{
+    long i = 0;
+    int failed = 0;
+    pthread_t threads[SHARED_CONFIG_TEST_THREADS];
+    if (prefetch)
+    {
+        setenv("LA_CONFIG_PREFETCH", "1", 1);
+    }
+    else
+    {
+        unsetenv("LA_CONFIG_PREFETCH");
+    }
+    LA_INIT;
+    LA_NEW_INT_PARAMETER(SHARED_CONFIG_TEST_PARAM, LOOP_ADAPT_SCOPE_SYSTEM, -1);
+    loop_adapt_configuration_shared_init(&share);
+    // A thread stalled between reading the published configuration and
+    // taking its reference must not prevent the reuse of the replaced ones
+    __atomic_add_fetch(&share.readers, 1, __ATOMIC_SEQ_CST);
+
+    for (i = 0; i < SHARED_CONFIG_TEST_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, worker, (void*)i);
+    }
+    for (i = 0; i < SHARED_CONFIG_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    __atomic_sub_fetch(&share.readers, 1, __ATOMIC_SEQ_CST);
+
+    for (i = 0; i < SHARED_CONFIG_TEST_THREADS; i++)
+    {
+        if (errors[i] > 0)
+        {
+            printf("FAILED: Thread %ld got %d wrong configurations %s prefetching\n", i, errors[i], (prefetch ? "with" : "without"));
+            failed = 1;
+        }
+    }
+    // Each thread keeps a reference to its last configuration. Unreferenced
+    // ones are kept beyond the limit while threads read the published
+    // configuration, allow one per thread.
+    if (share.num_retired > LOOP_ADAPT_SHARED_CONFIGURATION_RETIRED + 2 * SHARED_CONFIG_TEST_THREADS)
+    {
+        printf("FAILED: %d retired configurations kept %s prefetching\n", share.num_retired, (prefetch ? "with" : "without"));
+        failed = 1;
+    }
+
+    loop_adapt_configuration_shared_destroy(&share);
+    LA_FINALIZE;
+    // The child leaves with _exit, which does not flush
+    fflush(stdout);
+    return failed;
+}
+
+static int run(int prefetch)
+{
+    int status = 0;
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        return 1;
+    }
+    if (pid == 0)
+    {
+        _exit(child(prefetch));
+    }
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        if (!WIFEXITED(status))
+        {
+            printf("FAILED: Run %s prefetching did not finish\n", (prefetch ? "with" : "without"));
+        }
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+#ifndef LOOP_ADAPT_ACTIVATE
+    printf("shared_config_test requires LOOP_ADAPT_ACTIVATE\n");
+    return 1;
+#else
+    int failed = 0;
+    TestConfig tc;
+    if (test_config_setup(&tc, "shared_config_test", SHARED_CONFIG_TEST_LOOP, SHARED_CONFIG_TEST_PARAM, SHARED_CONFIG_TEST_CONFIGS) != 0)
+    {
+        return 1;
+    }
+    failed = run(0);
+    failed |= run(1);
+    test_config_cleanup(&tc);
+    if (failed)
+    {
+        return 1;
+    }
+    printf("OK: Shared configurations are consistent with and without prefetching\n");
+    return 0;
+#endif
+}
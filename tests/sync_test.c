@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <loop_adapt.h>
+
+#include "test_config_helper.h"
+#include "test_threads_helper.h"
+
+/* Check that the threads of a synchronized loop with adaptive cycles switch
+ * the configuration at the same iterations. The iteration times of the first
+ * thread are stable, so its measurement alone is precise after the minimal
+ * number of iterations. The second thread is noisy and needs longer cycles.
+ * Each thread records the iterations at which its parameter value changes,
+ * the lists of all threads have to be equal. The parameter has thread scope,
+ * so each thread sees the configuration it applied itself. */
+
+#define SYNC_TEST_LOOP "SYNC_TEST"
+#define SYNC_TEST_PARAM "SYNC_PARAM"
+#define SYNC_TEST_THREADS 3
+#define SYNC_TEST_CONFIGS 4
+#define SYNC_TEST_MIN 8
+#define SYNC_TEST_MAX 64
+#define SYNC_TEST_CONFIDENCE 0.05
+#define SYNC_TEST_ITERATIONS ((SYNC_TEST_CONFIGS + 2) * SYNC_TEST_MAX)
+/* Sleep time per iteration in ns */
+#define SYNC_TEST_BASE 100000
+#define SYNC_TEST_NOISE 800000
+#define SYNC_TEST_MAX_CHANGES (SYNC_TEST_CONFIGS + 2)
+
+static int loop_handle = -1;
+static int changes[SYNC_TEST_THREADS][SYNC_TEST_MAX_CHANGES];
+static int num_changes[SYNC_TEST_THREADS];
+
+static void body(int id)
+{
+    int i = 0;
+    int value = -1;
+    int last = -1;
+    unsigned int seed = id + 1;
+    LA_FOR_H(loop_handle, i = 0, i < SYNC_TEST_ITERATIONS, i++)
+    {
+        LA_GET_INT_PARAMETER(SYNC_TEST_PARAM, value);
+        if (value != last)
+        {
+            if (num_changes[id] < SYNC_TEST_MAX_CHANGES)
+            {
+                changes[id][num_changes[id]] = i;
+            }
+            num_changes[id]++;
+            last = value;
+        }
+        if (id == 1)
+        {
+            test_threads_sleep_ns(SYNC_TEST_BASE + rand_r(&seed) % SYNC_TEST_NOISE);
+        }
+        else
+        {
+            test_threads_sleep_ns(SYNC_TEST_BASE);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+#ifndef LOOP_ADAPT_ACTIVATE
+    printf("sync_test requires LOOP_ADAPT_ACTIVATE\n");
+    return 1;
+#else
+    long i = 0;
+    int j = 0;
+    int failed = 0;
+    TestConfig tc;
+    if (test_config_setup(&tc, "sync_test", SYNC_TEST_LOOP, SYNC_TEST_PARAM, SYNC_TEST_CONFIGS) != 0)
+    {
+        return 1;
+    }
+
+    test_threads_init();
+    loop_handle = LA_REGISTER_ADAPTIVE(SYNC_TEST_LOOP, SYNC_TEST_MIN, SYNC_TEST_MAX, SYNC_TEST_CONFIDENCE);
+    LA_NEW_INT_PARAMETER(SYNC_TEST_PARAM, LOOP_ADAPT_SCOPE_THREAD, -1);
+    LA_USE_LOOP_PARAMETER(SYNC_TEST_LOOP, SYNC_TEST_PARAM);
+    LA_USE_LOOP_POLICY(SYNC_TEST_LOOP, "P50_TIME");
+    LA_SYNC_LOOP(SYNC_TEST_LOOP);
+
+    if (test_threads_run(SYNC_TEST_THREADS, body) != 0)
+    {
+        failed = 1;
+    }
+
+    LA_FINALIZE;
+
+    test_config_cleanup(&tc);
+
+    if (!failed && num_changes[0] < 2)
+    {
+        printf("FAILED: The configuration of thread 0 changed %d times\n", num_changes[0]);
+        failed = 1;
+    }
+    for (i = 1; i < SYNC_TEST_THREADS && !failed; i++)
+    {
+        if (num_changes[i] != num_changes[0])
+        {
+            printf("FAILED: Thread %ld changed the configuration %d times, thread 0 %d times\n", i, num_changes[i], num_changes[0]);
+            failed = 1;
+            break;
+        }
+        for (j = 0; j < num_changes[0] && j < SYNC_TEST_MAX_CHANGES; j++)
+        {
+            if (changes[i][j] != changes[0][j])
+            {
+                printf("FAILED: Thread %ld changed the configuration at iteration %d, thread 0 at iteration %d\n", i, changes[i][j], changes[0][j]);
+                failed = 1;
+                break;
+            }
+        }
+    }
+    if (failed)
+    {
+        return 1;
+    }
+    printf("OK: All threads switched the configuration at the same iterations\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef TEST_CONFIG_HELPER_H
+#define TEST_CONFIG_HELPER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Temporary configuration input of the tests using the library. The txt
+ * backend reads the configurations of a loop from <dir>/<loop>.txt and
+ * writes the results to <dir>/output/<loop>.txt. */
+
+typedef struct {
+    char dir[64];
+    char outdir[1024];
+    char loop[256];
+} TestConfig;
+
+/* Creates the temporary directory with one configuration per line setting
+ * the integer parameter to 0, 1, ..., num_configs-1 and points the txt
+ * configuration backend to it. Returns 0 on success. */
+static int test_config_setup(TestConfig* tc, const char* name, const char* loop, const char* param, int num_configs)
+{
+    int i = 0;
+    char fname[1400];
+    snprintf(tc->dir, sizeof(tc->dir), "/tmp/loop_adapt_%s.XXXXXX", name);
+    snprintf(tc->loop, sizeof(tc->loop), "%s", loop);
+    if (!mkdtemp(tc->dir))
+    {
+        printf("Cannot create temporary directory\n");
+        return 1;
+    }
+    snprintf(fname, sizeof(fname), "%s/%s.txt", tc->dir, loop);
+    FILE* fp = fopen(fname, "w");
+    if (!fp)
+    {
+        printf("Cannot write configuration file %s\n", fname);
+        rmdir(tc->dir);
+        return 1;
+    }
+    for (i = 0; i < num_configs; i++)
+    {
+        fprintf(fp, "%s=ALL:%d\n", param, i);
+    }
+    fclose(fp);
+    snprintf(tc->outdir, sizeof(tc->outdir), "%s/output", tc->dir);
+    mkdir(tc->outdir, 0755);
+    setenv("LA_CONFIG_TXT_INPUT", tc->dir, 1);
+    setenv("LA_CONFIG_TXT_OUTPUT", tc->outdir, 1);
+    setenv("LA_CONFIG_INPUT_TYPE", "0", 1);
+    setenv("LA_CONFIG_OUTPUT_TYPE", "0", 1);
+    return 0;
+}
+
+/* Removes the configuration input and output files and the directories */
+static void test_config_cleanup(TestConfig* tc)
+{
+    char fname[1400];
+    snprintf(fname, sizeof(fname), "%s/%s.txt", tc->dir, tc->loop);
+    unlink(fname);
+    snprintf(fname, sizeof(fname), "%s/%s.txt", tc->outdir, tc->loop);
+    unlink(fname);
+    rmdir(tc->outdir);
+    rmdir(tc->dir);
+}
+
+#endif
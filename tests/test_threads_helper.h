@@ -0,0 +1,102 @@
+#ifndef TEST_THREADS_HELPER_H
+#define TEST_THREADS_HELPER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <loop_adapt.h>
+
+/* Thread team of the tests running a loop with several threads. The main
+ * thread is registered as thread 0 by LA_INIT and runs the body itself, the
+ * other threads are registered by the helper. All threads join the loop
+ * before the first cycle. */
+
+/* Maximal number of threads, one per PU of the synthetic topology */
+#define TEST_THREADS_MAX 4
+
+/* Body of a thread, it runs the loop of the test */
+typedef void (*test_threads_body)(int id);
+
+typedef struct {
+    int id;
+    test_threads_body body;
+} TestThread;
+
+static pthread_barrier_t test_threads_registered;
+
+/* Sleeps instead of busy waiting, this keeps the iteration times
+ * independent of the number of CPUs */
+static void test_threads_sleep_ns(long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000L;
+    ts.tv_nsec = ns % 1000000000L;
+    nanosleep(&ts, NULL);
+}
+
+/* All threads of the team are inside the parallel region */
+static int test_threads_in_parallel()
+{
+    return 1;
+}
+
+static void* test_threads_worker(void* arg)
+{
+    TestThread* t = (TestThread*)arg;
+    if (t->id > 0)
+    {
+        LA_REGISTER_THREAD(t->id);
+    }
+    pthread_barrier_wait(&test_threads_registered);
+    t->body(t->id);
+    return NULL;
+}
+
+/* Initializes loop_adapt for a team of threads. The synthetic topology gives
+ * each thread its own hardware thread and measurement instance, also on
+ * machines with fewer CPUs. */
+static void test_threads_init()
+{
+    LA_TOPOLOGY_SYNTHETIC("pack:1 core:4 pu:1");
+    LA_INIT;
+    LA_REGISTER_INPARALLEL_FUNC(test_threads_in_parallel);
+}
+
+/* Runs body with num_threads threads and returns when all threads are done.
+ * Returns 0 on success. */
+static int test_threads_run(int num_threads, test_threads_body body)
+{
+    int i = 0;
+    pthread_t threads[TEST_THREADS_MAX];
+    TestThread team[TEST_THREADS_MAX];
+    if (num_threads < 1 || num_threads > TEST_THREADS_MAX)
+    {
+        printf("Invalid number of threads %d\n", num_threads);
+        return 1;
+    }
+    pthread_barrier_init(&test_threads_registered, NULL, num_threads);
+    for (i = 0; i < num_threads; i++)
+    {
+        team[i].id = i;
+        team[i].body = body;
+    }
+    for (i = 1; i < num_threads; i++)
+    {
+        if (pthread_create(&threads[i], NULL, test_threads_worker, &team[i]) != 0)
+        {
+            printf("Cannot create thread %d\n", i);
+            exit(1);
+        }
+    }
+    test_threads_worker(&team[0]);
+    for (i = 1; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_barrier_destroy(&test_threads_registered);
+    return 0;
+}
+
+#endif /* TEST_THREADS_HELPER_H */
@@ -3,14 +3,43 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 
-int loop_adapt_verbosity = 0;
+#include <error.h>
+LoopAdaptDebugLevel loop_adapt_verbosity = 0;
 #include <loop_adapt_threads.h>
 
 
+#define NUM_TEST_THREADS 32
+
+static int failed = 0;
+
+/* Register concurrently and check that the thread list returns the own entry */
+static void* register_thread(void* arg)
+{
+    int id = (int)(long)arg;
+    int i = 0;
+    loop_adapt_threads_register(id);
+    ThreadData_t t = loop_adapt_threads_get();
+    if (!t || t->thread != id || loop_adapt_threads_getthread(t->index) != t)
+    {
+        __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    for (i = 0; i < loop_adapt_threads_get_count(); i++)
+    {
+        if (!loop_adapt_threads_getthread(i))
+        {
+            __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
 
 int main(int argc, char* argv[])
 {
+    int i = 0;
+    pthread_t threads[NUM_TEST_THREADS];
     loop_adapt_threads_initialize();
 
     loop_adapt_threads_finalize();
@@ -23,6 +52,20 @@ int main(int argc, char* argv[])
         printf("Failed to get thread data\n");
     }
     loop_adapt_threads_register(0);
+
+    for (i = 1; i < NUM_TEST_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, register_thread, (void*)(long)i);
+    }
+    for (i = 1; i < NUM_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    if (failed || loop_adapt_threads_get_count() != NUM_TEST_THREADS)
+    {
+        printf("Failed concurrent thread registration (%d threads)\n", loop_adapt_threads_get_count());
+        return 1;
+    }
     loop_adapt_threads_finalize();
     return 0;
 }
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <loop_adapt.h>
+
+#include "test_config_helper.h"
+
+/* Check that the best configuration is applied after all configurations of a
+ * loop are evaluated. The duration of an iteration grows with the distance of
+ * the parameter value to TUNED_TEST_BEST, so the MIN_TIME policy has to pick
+ * it. The parameter must keep the value for all following iterations. */
+
+#define TUNED_TEST_LOOP "TUNED_TEST"
+#define TUNED_TEST_PARAM "TUNED_PARAM"
+#define TUNED_TEST_CYCLE 4
+#define TUNED_TEST_CONFIGS 5
+#define TUNED_TEST_BEST 2
+#define TUNED_TEST_TUNED_CYCLES 16
+/* Busy time per iteration and distance to the best value in ns */
+#define TUNED_TEST_PENALTY 200000
+
+static void busy_wait(long ns)
+{
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec) < ns);
+}
+
+int main(int argc, char* argv[])
+{
+#ifndef LOOP_ADAPT_ACTIVATE
+    printf("tuned_test requires LOOP_ADAPT_ACTIVATE\n");
+    return 1;
+#else
+    int i = 0;
+    int value = 0;
+    int wrong = 0;
+    TestConfig tc;
+    if (test_config_setup(&tc, "tuned_test", TUNED_TEST_LOOP, TUNED_TEST_PARAM, TUNED_TEST_CONFIGS) != 0)
+    {
+        return 1;
+    }
+
+    LA_INIT;
+    LA_REGISTER(TUNED_TEST_LOOP, TUNED_TEST_CYCLE);
+    LA_NEW_INT_PARAMETER(TUNED_TEST_PARAM, LOOP_ADAPT_SCOPE_SYSTEM, -1);
+    LA_USE_LOOP_PARAMETER(TUNED_TEST_LOOP, TUNED_TEST_PARAM);
+    LA_USE_LOOP_POLICY(TUNED_TEST_LOOP, "MIN_TIME");
+
+    LA_FOR(TUNED_TEST_LOOP, i = 0, i < (TUNED_TEST_CONFIGS + TUNED_TEST_TUNED_CYCLES) * TUNED_TEST_CYCLE, i++)
+    {
+        LA_GET_INT_PARAMETER(TUNED_TEST_PARAM, value);
+        busy_wait((long)abs(value - TUNED_TEST_BEST) * TUNED_TEST_PENALTY + 1000);
+        if (i >= TUNED_TEST_CONFIGS * TUNED_TEST_CYCLE && value != TUNED_TEST_BEST)
+        {
+            wrong++;
+        }
+    }
+
+    LA_FINALIZE;
+
+    test_config_cleanup(&tc);
+
+    if (wrong > 0)
+    {
+        printf("FAILED: %d tuned iterations without the best configuration\n", wrong);
+        return 1;
+    }
+    printf("OK: Best configuration applied after tuning\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <loop_adapt.h>
+
+#include "test_config_helper.h"
+#include "test_threads_helper.h"
+
+/* Check that all threads of a loop apply the same best configuration. The
+ * duration of an iteration of thread t grows with the distance of the
+ * parameter value to t, so each thread alone would pick a different value.
+ * The P50_TIME policy refers to the slowest thread, which is fastest with
+ * TUNED_THREADS_TEST_BEST. The parameter has thread scope, so a thread
+ * applying its own best value is noticed. The loop is synchronized, so all
+ * threads use the same configuration in each cycle. */
+
+#define TUNED_THREADS_TEST_LOOP "TUNED_THREADS_TEST"
+#define TUNED_THREADS_TEST_PARAM "TUNED_THREADS_PARAM"
+#define TUNED_THREADS_TEST_THREADS 3
+#define TUNED_THREADS_TEST_CYCLE 8
+#define TUNED_THREADS_TEST_CONFIGS 5
+#define TUNED_THREADS_TEST_BEST 1
+#define TUNED_THREADS_TEST_TUNED_CYCLES 8
+/* Sleep time per iteration and distance to the value of the thread in ns */
+#define TUNED_THREADS_TEST_PENALTY 200000
+
+static int loop_handle = -1;
+static int wrong[TUNED_THREADS_TEST_THREADS];
+static int last[TUNED_THREADS_TEST_THREADS];
+
+static void body(int id)
+{
+    int i = 0;
+    int value = 0;
+    LA_FOR_H(loop_handle, i = 0, i < (TUNED_THREADS_TEST_CONFIGS + TUNED_THREADS_TEST_TUNED_CYCLES) * TUNED_THREADS_TEST_CYCLE, i++)
+    {
+        LA_GET_INT_PARAMETER(TUNED_THREADS_TEST_PARAM, value);
+        test_threads_sleep_ns((long)abs(value - id) * TUNED_THREADS_TEST_PENALTY + 1000);
+        if (i >= TUNED_THREADS_TEST_CONFIGS * TUNED_THREADS_TEST_CYCLE && value != TUNED_THREADS_TEST_BEST)
+        {
+            wrong[id]++;
+            last[id] = value;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+#ifndef LOOP_ADAPT_ACTIVATE
+    printf("tuned_threads_test requires LOOP_ADAPT_ACTIVATE\n");
+    return 1;
+#else
+    long i = 0;
+    int failed = 0;
+    TestConfig tc;
+    if (test_config_setup(&tc, "tuned_threads_test", TUNED_THREADS_TEST_LOOP, TUNED_THREADS_TEST_PARAM, TUNED_THREADS_TEST_CONFIGS) != 0)
+    {
+        return 1;
+    }
+
+    test_threads_init();
+    loop_handle = LA_REGISTER(TUNED_THREADS_TEST_LOOP, TUNED_THREADS_TEST_CYCLE);
+    LA_NEW_INT_PARAMETER(TUNED_THREADS_TEST_PARAM, LOOP_ADAPT_SCOPE_THREAD, -1);
+    LA_USE_LOOP_PARAMETER(TUNED_THREADS_TEST_LOOP, TUNED_THREADS_TEST_PARAM);
+    LA_USE_LOOP_POLICY(TUNED_THREADS_TEST_LOOP, "P50_TIME");
+    LA_SYNC_LOOP(TUNED_THREADS_TEST_LOOP);
+
+    if (test_threads_run(TUNED_THREADS_TEST_THREADS, body) != 0)
+    {
+        failed = 1;
+    }
+
+    LA_FINALIZE;
+
+    test_config_cleanup(&tc);
+
+    for (i = 0; i < TUNED_THREADS_TEST_THREADS; i++)
+    {
+        if (wrong[i] > 0)
+        {
+            printf("FAILED: Thread %ld has %d tuned iterations with value %d instead of %d\n", i, wrong[i], last[i], TUNED_THREADS_TEST_BEST);
+            failed = 1;
+        }
+    }
+    if (failed)
+    {
+        return 1;
+    }
+    printf("OK: All threads applied the best configuration of the slowest thread\n");
+    return 0;
+#endif
+}